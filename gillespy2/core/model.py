@@ -807,6 +807,9 @@ class Model(SortableObject):
         control+c or pressing stop on a jupyter notebook. To resume a simulation, pass your previously ran results
         into the run method, and set t = to the time you wish the resuming simulation to end (run(resume=results, t=x)).
         Pause/Resume is only supported for SINGLE TRAJECTORY simulations. T MUST BE SET OR UNEXPECTED BEHAVIOR MAY OCCUR.
+        Results of the SSACSolver and TauLeapingCSolver run with a timeout, resumed from earlier results, or run with
+        resumable=True hold a checkpoint, from which every trajectory is resumed with the random numbers it would have
+        drawn had it not stopped, without recompiling the simulation.
         """
 
         if not show_labels:
@@ -819,15 +822,25 @@ class Model(SortableObject):
         if solver is None:
             solver = self.get_best_solver()
 
+        # Solvers which checkpoint their trajectories return the checkpoint when run resumable, which is only worth
+        # saving by default when a timeout may pause the run or it continues earlier results
+        if getattr(solver, 'checkpoints', False) and (timeout or solver_args.get('resume') is not None):
+            solver_args.setdefault('resumable', True)
+
         try:
-            solver_results, rc = solver.run(model=self, t=t, increment=self.tspan[-1] - self.tspan[-2],
-                                            timeout=timeout, **solver_args)
+            solver_output = solver.run(model=self, t=t, increment=self.tspan[-1] - self.tspan[-2],
+                                       timeout=timeout, **solver_args)
+            # Solvers run with profile=True may also return the engine's profile, and C++ solvers a checkpoint
+            solver_results, rc = solver_output[:2]
+            profile = solver_output[2] if len(solver_output) > 2 else None
+            checkpoint = solver_output[3] if len(solver_output) > 3 else None
         except Exception as e:
             # If user has specified the SSACSolver, but they don't actually have a g++ compiler,
             # This will throw an error and throw log. IF a user specifies cpp_support == True and don't have a compiler
             # They would bypass this log.warning and just recieve an error
             if cpp_support is False and not isinstance(solver, str):
-                if solver.name == 'SSACSolver' or solver.name == 'VariableSSACSolver':
+                if solver.name in ('SSACSolver', 'VariableSSACSolver', 'TauLeapingCSolver', 'ODECSolver',
+                                   'TauHybridCSolver', 'GPUSSASolver'):
                     from gillespy2.core import log
                     log.warning("Please install/configure 'g++' and 'make' on your"
                                 " system, to ensure that GillesPy2 C solvers will"
@@ -848,7 +861,7 @@ class Model(SortableObject):
                 temp = Trajectory(data=solver_results[i], model=self, solver_name=solver.name, rc=rc)
                 results_list.append(temp)
 
-            results = Results(results_list)
+            results = Results(results_list, profile=profile, checkpoint=checkpoint)
             if show_labels == False:
                 results = results.to_array()
             return results
@@ -859,7 +872,7 @@ class Model(SortableObject):
                 temp = Trajectory(data=solver_results[i], model=self, solver_name=solver.name, rc=rc)
                 results_list.append(temp)
 
-            results = Results(results_list)
+            results = Results(results_list, profile=profile, checkpoint=checkpoint)
             if show_labels == False:
                 results = results.to_array()
             return results
@@ -122,10 +122,16 @@ class Results(UserList):
 
     :param data: A list of trajectory objects
     :type data: UserList
+    :param profile: Profile of the simulation engine, for C++ solvers run with profile=True
+    :type profile: dict
+    :param checkpoint: Where each trajectory of a C++ solver's simulation stopped, resumed by run(resume=results)
+    :type checkpoint: bytes
     """
 
-    def __init__(self, data):
+    def __init__(self, data, profile=None, checkpoint=None):
         self.data = data
+        self.profile = profile
+        self.checkpoint = checkpoint
 
     def __getattribute__(self, key):
         if key == 'model' or key == 'solver_name' or key == 'rc' or key == 'status':
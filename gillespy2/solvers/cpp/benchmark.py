@@ -0,0 +1,117 @@
+"""
+Benchmarks of the C++ simulation engines. Each model is compiled once, then every engine is run at each thread
+count with the simulation's -benchmark option, which reports the engine's own run time and work in place of the
+results, so neither compiling nor parsing output is timed.
+
+From the source tree, run ``make benchmark`` in c_base, or ``python -m gillespy2.solvers.cpp.benchmark --help``.
+"""
+import argparse #for command line options
+import os #for the number of processors
+import subprocess #for running the compiled simulations
+from gillespy2.solvers.cpp.ssa_c_solver import SSACSolver
+from gillespy2.solvers.cpp import example_models
+
+# Engines of the compiled simulation, values of its -algorithm option
+ALGORITHMS = ('direct', 'next_reaction', 'composition_rejection', 'batch_direct', 'tau_leaping')
+
+
+def benchmark_models(number_species=1000):
+    """
+    :param number_species: Number of species in the sparse network model
+    :return: List of the models benchmarked by default, from small networks to a large sparse one
+    """
+    return [example_models.Dimerization(), example_models.MichaelisMenten(),
+            example_models.SparseNetwork(number_species=number_species)]
+
+
+def _parse_benchmark(output):
+    """
+    Parses the "name value" lines written by a simulation run with -benchmark.
+    :param output: Standard output of the simulation
+    :return: Dictionary of each reported value
+    """
+    report = {}
+    for line in output.decode('utf-8').splitlines():
+        name, value = line.split()
+        report[name] = float(value) if name == 'seconds' else int(value)
+    return report
+
+
+def run_benchmark(solver, algorithm='direct', number_of_threads=1, number_of_trajectories=8, seed=1):
+    """
+    Simulates a compiled model over its timespan with one engine and reports the engine's throughput.
+
+    :param solver: SSACSolver constructed with the model to simulate
+    :param algorithm: Engine to simulate with, one of ALGORITHMS
+    :type algorithm: str
+    :param number_of_threads: Number of threads trajectories are simulated on
+    :type number_of_threads: int
+    :param number_of_trajectories: Number of trajectories to simulate
+    :type number_of_trajectories: int
+    :param seed: The random seed for the simulation
+    :type seed: int
+    :return: Dictionary of the simulation's report: 'events', reactions fired or leaps taken for tau-leaping,
+    'propensity_evaluations', 'seconds' the engine ran for and 'peak_resident_kb' of the process, with the derived
+    'events_per_second', 'ns_per_event' of thread time and 'evaluations_per_event'
+    """
+    tspan = solver.model.tspan
+    args = [os.path.join(solver.output_directory, 'UserSimulation'), '-trajectories', str(number_of_trajectories),
+            '-timesteps', str(len(tspan)), '-end', str(tspan[-1]), '-threads', str(number_of_threads),
+            '-seed', str(seed), '-algorithm', algorithm, '-benchmark']
+    report = _parse_benchmark(subprocess.run(args, stdout=subprocess.PIPE, check=True).stdout)
+    events = max(report['events'], 1)
+    threads_used = min(number_of_threads, number_of_trajectories)
+    report['events_per_second'] = report['events'] / report['seconds'] if report['seconds'] > 0 else 0
+    report['ns_per_event'] = 1e9 * report['seconds'] * threads_used / events
+    report['evaluations_per_event'] = report['propensity_evaluations'] / events
+    return report
+
+
+def benchmark(models=None, algorithms=ALGORITHMS, threads=None, number_of_trajectories=8, seed=1, output=print):
+    """
+    Benchmarks every engine at every thread count on each model, writing one line of results per run.
+
+    :param models: Models to benchmark, defaults to benchmark_models()
+    :param algorithms: Engines to benchmark
+    :param threads: Thread counts to benchmark, defaults to 1 and the number of processors
+    :param number_of_trajectories: Number of trajectories simulated by each run
+    :param seed: The random seed of each run
+    :param output: Called with each line of the results table
+    :return: List of (model name, algorithm, threads, report) for each run, report as returned by run_benchmark
+    """
+    if models is None:
+        models = benchmark_models()
+    if threads is None:
+        threads = sorted({1, os.cpu_count() or 1})
+    results = []
+    output('{:<24} {:<22} {:>7} {:>12} {:>14} {:>10} {:>11} {:>12}'.format(
+        'model', 'algorithm', 'threads', 'events', 'events/s', 'ns/event', 'evals/event', 'peak RSS kB'))
+    for model in models:
+        solver = SSACSolver(model)
+        for algorithm in algorithms:
+            for number_of_threads in threads:
+                report = run_benchmark(solver, algorithm, number_of_threads, number_of_trajectories, seed)
+                results.append((model.name, algorithm, number_of_threads, report))
+                output('{:<24} {:<22} {:>7} {:>12} {:>14.0f} {:>10.1f} {:>11.2f} {:>12}'.format(
+                    model.name, algorithm, number_of_threads, report['events'], report['events_per_second'],
+                    report['ns_per_event'], report['evaluations_per_event'], report['peak_resident_kb']))
+    return results
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description='Benchmark the C++ simulation engines.')
+    parser.add_argument('--algorithms', default=','.join(ALGORITHMS),
+                        help='comma separated engines to benchmark (default: all)')
+    parser.add_argument('--threads', default=None,
+                        help='comma separated thread counts (default: 1 and the number of processors)')
+    parser.add_argument('--trajectories', type=int, default=8, help='trajectories simulated by each run')
+    parser.add_argument('--species', type=int, default=1000, help='species in the sparse network model')
+    parser.add_argument('--seed', type=int, default=1, help='random seed of each run')
+    options = parser.parse_args(argv)
+    models = benchmark_models(options.species)
+    threads = None if options.threads is None else [int(count) for count in options.threads.split(',')]
+    benchmark(models, options.algorithms.split(','), threads, options.trajectories, options.seed)
+
+
+if __name__ == '__main__':
+    main()
@@ -3,9 +3,17 @@
 #include <iostream>
 #include <sstream>
 #include <time.h>
+#include <chrono>
 #include <math.h>
 #include "model.h"
 #include "ssa.h"
+#include "tau_leaping.h"
+#include "ode.h"
+#include "hybrid.h"
+#include "events.h"
+#include "batch.h"
+#include "gpu.h"
+#include "generic.h"
 using namespace Gillespy;
 
 //Default values, replaced with command line args
@@ -14,53 +22,319 @@ unsigned int number_timesteps = 0;
 int random_seed = 0;
 double end_time = 0;
 bool seed_time = true;
+unsigned int number_threads = 1;
+unsigned int first_trajectory = 0; //number of the first trajectory within an ensemble split between simulations, see simulation_rng
+bool binary_output = false;
+std :: string output_file = "";
+bool shared_memory = false;
+std :: string algorithm = "direct";
+double tau_tol = 0.03;
+double ode_rtol = 1e-6; //relative and absolute error tolerances of the ode and hybrid engines
+double ode_atol = 1e-9;
+HybridSettings hybrid_settings; //species' modes and switching thresholds of the hybrid engine, from -modes, -switch_tol and -switch_min
+bool summarize = false; //output ensemble statistics instead of trajectories
+std :: vector<double> quantiles; //probabilities of the quantiles output with -statistics
+bool benchmark = false; //output the engine's work and run time instead of results
+bool profile = false; //output binary results with the engines' profile, to stdout
+bool record_changes = false; //output binary results as the populations changed at each timestep, to stdout
+bool stream = false; //output each trajectory as soon as it finishes, to stdout, see TrajectoryStream
+bool progress = false; //report each trajectory streamed on stderr
+std :: vector<unsigned int> observed_species; //species output with -observe, in order, every species if empty
+std :: string timeline_file = ""; //binary file of the sorted times to output, replacing the uniform timeline of -timesteps and -end
+unsigned int record_every = 0; //output the state after every record_every-th event instead of at the timeline, to stdout
+std :: string checkpoint_file = ""; //file each trajectory's checkpoint is written to once the simulation stops, see TrajectoryCheckpoint
+std :: string resume_file = ""; //checkpoint file of the trajectories to resume, saved by a simulation run with -checkpoint
 
 //Default constants
 __DEFINE_CONSTANTS__
 
-class PropensityFunction : public IPropensityFunction{
+//Function definitions
+__DEFINE_FUNCTIONS__
+
+//Final, so engines instantiated with this type call evaluate directly and can inline it
+class PropensityFunction final : public IPropensityFunction{
 public:
-  double evaluate(unsigned int reaction_number, unsigned int* S){
+  double evaluate(unsigned int reaction_number, unsigned int* S) override{
+    return propensity(reaction_number, S);
+  }
+
+  //Static, so the gpu_direct kernel evaluates it on the device
+  GILLESPY_DEVICE static double propensity(unsigned int reaction_number, const unsigned int* S){
     switch(reaction_number){
 __DEFINE_PROPENSITY__
 
+    default: //Error, or a reaction of a generic simulation's model
+__DEFINE_GENERIC_PROPENSITY__
+      return -1;
+    }
+  }
+
+  //Propensities of a reaction for every lane of a batch of trajectories, written into propensities[lane]
+  void evaluate_batch(unsigned int reaction_number, BatchState S, double* propensities){
+    switch(reaction_number){
+__DEFINE_BATCH_PROPENSITY__
+
+    default:
+__DEFINE_GENERIC_BATCH_PROPENSITY__
+      break;
+    }
+  }
+};
+
+//Deterministic rates of the reactions over real valued populations, for the ode engine
+class ODEFunction final{
+public:
+  double evaluate(unsigned int reaction_number, const double* S){
+    switch(reaction_number){
+__DEFINE_ODE_PROPENSITY__
+
     default: //Error
       return -1;
     }
   }
+
+  //Writes the partial derivative of a reaction's rate by each species of model.rate_species into P, in order
+  void partials(unsigned int reaction_number, double* S, double* P){
+    switch(reaction_number){
+__DEFINE_ODE_JACOBIAN__
+    }
+  }
+
+  //Species changed by each rate rule, in order
+__DEFINE_RATE_RULE_SPECIES__
+
+  //Rate of change of rate_rule_species[rule] by its rate rule
+  double rate_rule(unsigned int rule, const double* S){
+    switch(rule){
+__DEFINE_RATE_RULES__
+
+    default: //Error
+      return 0;
+    }
+  }
+
+  //Writes the partial derivatives of a rate rule by the species it reads into P, indexed by species
+  void rate_rule_partials(unsigned int rule, double* S, double* P){
+    switch(rule){
+__DEFINE_RATE_RULE_JACOBIAN__
+    }
+  }
+
+private:
+  //Central difference of a rate by a species, for rates the code generator can not differentiate
+  double difference(unsigned int reaction_number, double* S, unsigned int species){
+    double population = S[species];
+    double step = 1e-7 * std :: max(1.0, std :: fabs(population));
+    S[species] = population + step;
+    double upper = evaluate(reaction_number, S);
+    S[species] = population - step;
+    double lower = evaluate(reaction_number, S);
+    S[species] = population;
+    return (upper - lower) / (2 * step);
+  }
+
+  //Central difference of a rate rule by a species
+  double rate_rule_difference(unsigned int rule, double* S, unsigned int species){
+    double population = S[species];
+    double step = 1e-7 * std :: max(1.0, std :: fabs(population));
+    S[species] = population + step;
+    double upper = rate_rule(rule, S);
+    S[species] = population - step;
+    double lower = rate_rule(rule, S);
+    S[species] = population;
+    return (upper - lower) / (2 * step);
+  }
+};
+
+//Assignment rules and events of the model, for the engines of events.h, over populations read as doubles at time t
+class ModelEvents final{
+public:
+__DEFINE_EVENT_CONSTANTS__
+
+  //Sets the parameters assigned by rules and events to their initial values
+  void reset(){
+__DEFINE_EVENT_RESET__
+  }
+
+  template<typename State>
+  bool assign_rules(State* S, double t){
+    bool changed = false;
+__DEFINE_ASSIGNMENT_RULES__
+    return changed;
+  }
+
+  EventSettings settings(unsigned int event_number){
+    switch(event_number){
+__DEFINE_EVENT_SETTINGS__
+    default: //Error
+      return {};
+    }
+  }
+
+  template<typename State>
+  bool trigger(unsigned int event_number, const State* S, double t){
+    switch(event_number){
+__DEFINE_EVENT_TRIGGERS__
+    default: //Error
+      return false;
+    }
+  }
+
+  template<typename State>
+  double delay(unsigned int event_number, const State* S, double t){
+    switch(event_number){
+__DEFINE_EVENT_DELAYS__
+    default: //Error
+      return 0;
+    }
+  }
+
+  template<typename State>
+  double priority(unsigned int event_number, const State* S, double t){
+    switch(event_number){
+__DEFINE_EVENT_PRIORITIES__
+    default: //Error
+      return 0;
+    }
+  }
+
+  //Evaluates an event's assignments into V, in order
+  template<typename State>
+  void values(unsigned int event_number, const State* S, double t, double* V){
+    switch(event_number){
+__DEFINE_EVENT_VALUES__
+    }
+  }
+
+  //Carries out an event's assignments of the values V, returns whether a value changed
+  template<typename State>
+  bool assign(unsigned int event_number, const double* V, State* S){
+    bool changed = false;
+    switch(event_number){
+__DEFINE_EVENT_ASSIGNMENTS__
+    }
+    return changed;
+  }
 };
 
 int main(int argc, char* argv[]){
-  std :: vector<std :: string> species_names(s_names, s_names + sizeof(s_names)/sizeof(std :: string));
-  std :: vector<unsigned int> species_populations(populations, populations + sizeof(populations)/sizeof(populations[0]));
-  std :: vector<std :: string> reaction_names(r_names, r_names + sizeof(r_names)/sizeof(std :: string));
+__DEFINE_GENERIC_MODEL__
+  std :: vector<std :: string> species_names(std :: begin(s_names), std :: end(s_names));
+  std :: vector<unsigned int> species_populations(std :: begin(populations), std :: end(populations));
+  std :: vector<std :: string> reaction_names(std :: begin(r_names), std :: end(r_names));
   
   Model model(species_names, species_populations, reaction_names);
 
   //Begin reaction species changes
 __DEFINE_REACTIONS_
+__DEFINE_GENERIC_REACTIONS__
   //End reaction species changes
-  model.update_affected_reactions();
+  model.build();
  
   //Parse command line arguments
  std :: string arg;
- for(int i = 1; i < argc - 1; i++){
+ for(int i = 1; i < argc; i++){
    arg = argv[i];
-   if(argc > i+1 && arg.size() > 1 && arg[0] == '-'){
-     std :: stringstream arg_stream(argv[i+1]);
+   if(arg.size() > 1 && arg[0] == '-'){
+     std :: stringstream arg_stream(argc > i+1 ? argv[i+1] : "");
      switch(arg[1]){
+     case 'a':
+       if(arg == "-atol"){
+	 arg_stream >> ode_atol;
+       }else{
+	 arg_stream >> algorithm;
+       }
+       break;
+     case 'b':
+       if(arg[2] == 'e'){
+	 benchmark = true;
+       }else{
+	 binary_output = true;
+       }
+       break;
+     case 'c':
+       if(arg == "-checkpoint"){
+	 arg_stream >> checkpoint_file;
+       }else{
+	 record_changes = true;
+	 binary_output = true;
+       }
+       break;
+     case 'f':
+       arg_stream >> first_trajectory;
+       break;
+     case 'o':
+       if(arg[2] == 'b'){
+	 for(std :: string species; std :: getline(arg_stream, species, ',');){
+	   observed_species.push_back(std :: stoul(species));
+	 }
+       }else{
+	 arg_stream >> output_file;
+       }
+       break;
+     case 'm':
+       //-model names the description a generic simulation loaded before the model was built
+       if(arg != "-model"){
+	 for(std :: string mode; std :: getline(arg_stream, mode, ',');){
+	   hybrid_settings.modes.push_back(std :: stoul(mode));
+	 }
+       }
+       break;
      case 's':
-       arg_stream >> random_seed;
-       seed_time = false;
+       if(arg == "-switch_tol" || arg == "-switch_min"){
+	 std :: vector<double>& thresholds = arg == "-switch_tol" ? hybrid_settings.switch_tol : hybrid_settings.switch_min;
+	 for(std :: string threshold; std :: getline(arg_stream, threshold, ',');){
+	   thresholds.push_back(std :: stod(threshold));
+	 }
+       }else if(arg[2] == 'h'){
+	 arg_stream >> output_file;
+	 shared_memory = true;
+       }else if(arg == "-stream"){
+	 stream = true;
+       }else if(arg[2] == 't'){
+	 summarize = true;
+       }else{
+	 arg_stream >> random_seed;
+	 seed_time = false;
+       }
+       break;
+     case 'q':
+       for(std :: string probability; std :: getline(arg_stream, probability, ',');){
+	 quantiles.push_back(std :: stod(probability));
+       }
        break;
      case 'e':
        arg_stream >> end_time;
        break;
+     case 'r':
+       if(arg == "-resume"){
+	 arg_stream >> resume_file;
+       }else if(arg == "-rtol"){
+	 arg_stream >> ode_rtol;
+       }else{
+	 arg_stream >> record_every;
+	 binary_output = true;
+       }
+       break;
+     case 'p':
+       if(arg == "-progress"){
+	 progress = true;
+       }else{
+	 profile = true;
+	 binary_output = true;
+       }
+       break;
      case 't':
-       if(arg[2] == 'r'){
+       if(arg == "-timeline"){
+	 arg_stream >> timeline_file;
+       }else if(arg[2] == 'r'){
 	 arg_stream >> number_trajectories;
        }else if(arg[2] == 'i'){
 	 arg_stream >> number_timesteps;
+       }else if(arg[2] == 'h'){
+	 arg_stream >> number_threads;
+       }else if(arg[2] == 'a'){
+	 arg_stream >> tau_tol;
        }
        break;
      }
@@ -70,11 +344,159 @@ __DEFINE_REACTIONS_
  if(seed_time){
    random_seed = time(NULL);
  }
+ for(unsigned int species : observed_species){
+   if(species >= model.number_species){
+     std :: cerr << "Observed species " << species << " is not one of the model's " << model.number_species << " species" << std :: endl;
+     return 1;
+   }
+ }
+ unsigned int number_observed = observed_species.empty() ? model.number_species : observed_species.size();
+ std :: vector<double> timeline;
+ if(!timeline_file.empty()){
+   if(!read_timeline(timeline_file, timeline)){
+     return 1;
+   }
+   number_timesteps = timeline.size();
+   end_time = timeline.back();
+ }
+  //The ode and hybrid engines record real valued populations, which are output to stdout
+  bool continuous = algorithm == "ode" || algorithm == "hybrid";
+  //Results written in place to a file or shared memory segment instead of stdout
+  std :: unique_ptr<MappedFile> results_file;
+  std :: unique_ptr<TrajectoryStatistics> statistics;
+  if(summarize){
+    record_every = 0;
+    statistics.reset(new TrajectoryStatistics(number_timesteps, number_observed, !quantiles.empty()));
+  }else if(!output_file.empty() && !profile && !record_changes && !record_every && !continuous && !stream){
+    results_file.reset(new MappedFile(output_file, shared_memory, Simulation :: binary_output_size(number_trajectories, number_timesteps, number_observed)));
+    if(!results_file -> data){
+      return 1;
+    }
+  }
   IPropensityFunction *propFun = new PropensityFunction();
-  Simulation simulation(&model, number_trajectories, number_timesteps, end_time, propFun, random_seed, simulation.current_time);
-  ssa_direct(&simulation);
+  SimulationOptions options;
+  options.number_threads = number_threads;
+  options.results_storage = results_file ? results_file -> data : nullptr;
+  options.statistics = statistics.get();
+  options.record_changes = record_changes && !summarize && !record_every;
+  options.observed_species = observed_species;
+  options.record_every = record_every;
+  options.continuous = continuous;
+  Simulation simulation(&model, number_trajectories, number_timesteps, end_time, propFun, random_seed, options);
+  simulation.first_trajectory = first_trajectory;
+  if(!timeline.empty()){
+    simulation.set_timeline(timeline);
+  }
+  //Real valued populations are output at every timestep, and integrated from the start
+  if(continuous && (statistics || simulation.record_changes || simulation.record_every || !checkpoint_file.empty() || !resume_file.empty())){
+    std :: cerr << "The " << algorithm << " algorithm only outputs trajectories at every timestep, and can not be checkpointed" << std :: endl;
+    delete propFun;
+    return 1;
+  }
+  //Rules and events are carried out by the direct and hybrid engines, rate rules integrated by the ode and hybrid engines
+  ODEFunction ode_function;
+  if((ModelEvents :: active && algorithm != "direct" && algorithm != "hybrid") || (!ode_function.rate_rule_species.empty() && !continuous)){
+    std :: cerr << "The " << algorithm << " algorithm does not simulate the model's rules or events" << std :: endl;
+    delete propFun;
+    return 1;
+  }
+  if(ModelEvents :: active && (!checkpoint_file.empty() || !resume_file.empty())){
+    std :: cerr << "Simulations of rules and events can not be checkpointed" << std :: endl;
+    delete propFun;
+    return 1;
+  }
+  //The GPU engine stores every timestep, or statistics, of trajectories it simulates from the start
+  if(algorithm == "gpu_direct" && (simulation.record_changes || simulation.record_every || profile || !checkpoint_file.empty() || !resume_file.empty())){
+    std :: cerr << "The gpu_direct algorithm does not output changes, events or profiles, and can not be checkpointed" << std :: endl;
+    delete propFun;
+    return 1;
+  }
+  //Streamed trajectories are written whole as each finishes, by the engines simulating one trajectory or batch at a time
+  std :: unique_ptr<TrajectoryStream> trajectory_stream;
+  if(stream){
+    if(statistics || simulation.record_changes || simulation.record_every || profile || continuous || algorithm == "gpu_direct" || !checkpoint_file.empty() || !resume_file.empty()){
+      std :: cerr << "Only trajectories output at every timestep, without a profile or checkpoint, can be streamed, and not by the " << algorithm << " algorithm" << std :: endl;
+      delete propFun;
+      return 1;
+    }
+    trajectory_stream.reset(new TrajectoryStream(std :: cout, progress));
+    simulation.stream = trajectory_stream.get();
+    trajectory_stream -> start(simulation);
+  }
+  if(!checkpoint_file.empty()){
+    simulation.enable_checkpoints();
+  }
+  //Resumed trajectories only hold the timesteps after their checkpoints, which are merged with the results that saved it
+  if(!resume_file.empty()){
+    if(statistics || simulation.record_changes || simulation.record_every){
+      std :: cerr << "Only trajectories output at every timestep can be resumed" << std :: endl;
+      delete propFun;
+      return 1;
+    }
+    if(!simulation.read_checkpoint(resume_file)){
+      delete propFun;
+      return 1;
+    }
+  }
+  if(profile){
+    simulation.enable_profile();
+  }
+  auto start = std :: chrono :: steady_clock :: now();
+  if(algorithm == "direct" && ModelEvents :: active){
+    ssa_events<PropensityFunction, ModelEvents>(&simulation);
+  }else if(algorithm == "direct"){
+    ssa_direct<PropensityFunction>(&simulation);
+  }else if(algorithm == "batch_direct"){
+    ssa_batch_direct<PropensityFunction>(&simulation);
+#ifdef __CUDACC__
+  }else if(algorithm == "gpu_direct"){
+    if(!gpu_direct<PropensityFunction>(&simulation)){
+      delete propFun;
+      return 1;
+    }
+#endif
+  }else if(algorithm == "next_reaction"){
+    ssa_next_reaction<PropensityFunction>(&simulation);
+  }else if(algorithm == "composition_rejection"){
+    ssa_composition_rejection<PropensityFunction>(&simulation);
+  }else if(algorithm == "tau_leaping"){
+    tau_leaper<PropensityFunction>(&simulation, tau_tol);
+  }else if(algorithm == "ode"){
+    ode_solver<ODEFunction>(&simulation, &ode_function, ode_rtol, ode_atol);
+  }else if(algorithm == "hybrid"){
+    hybrid_settings.rtol = ode_rtol;
+    hybrid_settings.atol = ode_atol;
+    hybrid_solver<PropensityFunction, ODEFunction, ModelEvents>(&simulation, hybrid_settings);
+  }else{
+    std :: cerr << "Unknown algorithm " << algorithm << std :: endl;
+    delete propFun;
+    return 1;
+  }
+  std :: chrono :: duration<double> seconds = std :: chrono :: steady_clock :: now() - start;
+  if(!checkpoint_file.empty() && !simulation.write_checkpoint(checkpoint_file)){
+    delete propFun;
+    return 1;
+  }
   //std :: cout << simulation << std :: endl;
-  simulation.output_results_buffer(std :: cout);
+  if(trajectory_stream){
+    trajectory_stream -> finish(simulation);
+  }else if(benchmark){
+    simulation.output_benchmark(std :: cout, seconds.count());
+  }else if(statistics){
+    simulation.output_statistics_binary(std :: cout, quantiles);
+  }else if(simulation.continuous){
+    simulation.output_concentrations_binary(std :: cout);
+  }else if(results_file){
+    simulation.output_results_mapped();
+  }else if(simulation.record_every){
+    simulation.output_events_binary(std :: cout);
+  }else if(simulation.record_changes){
+    simulation.output_changes_binary(std :: cout);
+  }else if(binary_output){
+    simulation.output_results_binary(std :: cout);
+  }else{
+    simulation.output_results_buffer(std :: cout);
+  }
   delete propFun;
   return 0;
 }
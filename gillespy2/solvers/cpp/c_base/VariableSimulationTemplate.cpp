@@ -2,6 +2,8 @@
 #include <vector>
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <random>
 #include <time.h>
 #include <math.h>
 #include "model.h"
@@ -14,12 +16,37 @@ unsigned int number_timesteps = 0;
 int random_seed = 0;
 double end_time = 0;
 bool seed_time = true;
+unsigned int time_seeded_runs = 0; //runs seeded without -seed, mixed into their seeds so serve mode requests within one second differ
+unsigned int number_threads = 1;
+bool binary_output = false;
+std :: string output_file = "";
+bool shared_memory = false;
+std :: string algorithm = "direct";
+bool serve = false; //simulate requests read from stdin, see serve_requests
+std :: string batch_file = ""; //parameter sweep points, see read_batch
+std :: string perturbed_values = ""; //species populations and parameters of a coupled perturbed process, see read_perturbed
+Arena arena; //storage of results not written in place, kept between serve mode requests so it is only reallocated to grow
 
 //Default constants
 __DEFINE_VARIABLES__
 
-class PropensityFunction : public IPropensityFunction{
+//Values of the model's parameters, each parameter sweep point has its own
+struct Parameters{
+__DEFINE_PARAMETERS__
+
+  //Reads every parameter, in the order given to -parameters
+  void read(std :: istream& arg_stream){
+__DEFINE_PARAMETER_UPDATES__
+  }
+};
+
+//Default parameters, replaced with -parameters
+Parameters parameters;
+
+class PropensityFunction : public IPropensityFunction, public Parameters{
 public:
+  PropensityFunction(const Parameters& parameters) : Parameters(parameters) {}
+
   double evaluate(unsigned int reaction_number, unsigned int* S){
     switch(reaction_number){
 __DEFINE_PROPENSITY__
@@ -30,39 +57,230 @@ __DEFINE_PROPENSITY__
   }
 };
 
+//Reads the points of a parameter sweep, one per line holding the species populations followed by
+//the parameter values, in the orders of -initial_values and -parameters. Returns false on malformed rows.
+bool read_batch(const std :: string& path, unsigned int number_species, std :: vector<unsigned int>& point_populations, std :: vector<std :: unique_ptr<PropensityFunction>>& point_functions){
+  std :: ifstream batch(path);
+  if(!batch){
+    std :: cerr << "Could not open batch file " << path << std :: endl;
+    return false;
+  }
+  std :: string line;
+  for(unsigned int row = 1; std :: getline(batch, line); row++){
+    if(line.find_first_not_of(" \t\r") == std :: string :: npos){
+      continue;
+    }
+    std :: stringstream arg_stream(line);
+    for(unsigned int i = 0; i < number_species; i++){
+      unsigned int population;
+      arg_stream >> population;
+      point_populations.push_back(population);
+    }
+    Parameters point_parameters = parameters;
+    point_parameters.read(arg_stream);
+    std :: string extra;
+    if(arg_stream.fail() || arg_stream >> extra){
+      std :: cerr << "Batch file " << path << " row " << row << " does not hold " << number_species << " populations and every parameter" << std :: endl;
+      return false;
+    }
+    point_functions.emplace_back(new PropensityFunction(point_parameters));
+  }
+  return true;
+}
+
+//Reads the populations and parameters of the process a -perturbed run differences against the base, laid out as a row of
+//a batch file. Returns false if they are malformed.
+bool read_perturbed(unsigned int number_species, std :: vector<unsigned int>& perturbed_populations, Parameters& perturbed_parameters){
+  std :: stringstream arg_stream(perturbed_values);
+  perturbed_populations.resize(number_species);
+  for(unsigned int i = 0; i < number_species; i++){
+    arg_stream >> perturbed_populations[i];
+  }
+  perturbed_parameters.read(arg_stream);
+  std :: string extra;
+  if(arg_stream.fail() || arg_stream >> extra){
+    std :: cerr << "-perturbed does not hold " << number_species << " populations and every parameter" << std :: endl;
+    return false;
+  }
+  return true;
+}
+
+//Parses one option, value is the argument following it on the command line, or the rest of its line in a serve mode request
+void parse_option(const std :: string& arg, const std :: string& value){
+  if(arg.size() > 1 && arg[0] == '-'){
+    std :: stringstream arg_stream(value);
+    switch(arg[1]){
+    case 'a':
+      arg_stream >> algorithm;
+      break;
+    case 'b':
+      if(arg[2] == 'a'){
+	arg_stream >> batch_file;
+      }else{
+	binary_output = true;
+      }
+      break;
+    case 'i':
+      for(unsigned int j = 0; j < sizeof(populations)/sizeof(populations[0]); j++){
+	arg_stream >> populations[j];
+      }
+      break;
+    case 'p':
+      if(arg == "-perturbed"){
+	perturbed_values = value;
+      }else{
+	parameters.read(arg_stream);
+      }
+      break;
+    case 'o':
+      arg_stream >> output_file;
+      break;
+    case 's':
+      if(arg[2] == 'h'){
+	arg_stream >> output_file;
+	shared_memory = true;
+      }else if(arg == "-serve"){
+	serve = true;
+      }else{
+	arg_stream >> random_seed;
+	seed_time = false;
+      }
+      break;
+    case 'e':
+      arg_stream >> end_time;
+      break;
+    case 't':
+      if(arg[2] == 'r'){
+	arg_stream >> number_trajectories;
+      }else if(arg[2] == 'i'){
+	arg_stream >> number_timesteps;
+      }else if(arg[2] == 'h'){
+	arg_stream >> number_threads;
+      }
+      break;
+    }
+  }
+}
+
+//Options each serve mode request starts from, species populations and parameters keep their last values
+void reset_request_options(){
+  number_trajectories = 0;
+  number_timesteps = 0;
+  end_time = 0;
+  seed_time = true;
+  number_threads = 1;
+  output_file = "";
+  shared_memory = false;
+  algorithm = "direct";
+  batch_file = "";
+  perturbed_values = "";
+}
+
+//Simulates the model with the current options and writes the results, returns the exit code
+//A parameter sweep simulates number_trajectories trajectories of every point, its results hold the trajectories of each point in turn
+//With -perturbed each trajectory couples the base process to the perturbed one, see CoupledDirectMethod, and holds their difference
+int run_simulation(Model& model){
+  if(seed_time){
+    std :: random_device device;
+    std :: seed_seq seed_sequence{(unsigned int) time(NULL), (unsigned int) device(), time_seeded_runs++};
+    uint32_t seed_value;
+    seed_sequence.generate(&seed_value, &seed_value + 1);
+    random_seed = seed_value;
+  }
+  PropensityFunction propensity_function(parameters);
+  std :: vector<unsigned int> point_populations;
+  std :: vector<std :: unique_ptr<PropensityFunction>> point_functions;
+  if(!batch_file.empty() && !read_batch(batch_file, model.number_species, point_populations, point_functions)){
+    return 1;
+  }
+  std :: vector<unsigned int> perturbed_populations;
+  Parameters perturbed_parameters = parameters;
+  if(!perturbed_values.empty() && !read_perturbed(model.number_species, perturbed_populations, perturbed_parameters)){
+    return 1;
+  }
+  PropensityFunction perturbed_function(perturbed_parameters);
+  unsigned int total_trajectories = number_trajectories * (point_functions.empty() ? 1 : point_functions.size());
+  //Results written in place to a file or shared memory segment instead of stdout
+  std :: unique_ptr<MappedFile> results_file;
+  if(!output_file.empty()){
+    results_file.reset(new MappedFile(output_file, shared_memory, Simulation :: binary_output_size(total_trajectories, number_timesteps, model.number_species)));
+    if(!results_file -> data){
+      return 1;
+    }
+  }
+  SimulationOptions options;
+  options.number_threads = number_threads;
+  options.results_storage = results_file ? results_file -> data : nullptr;
+  options.arena = &arena;
+  Simulation simulation(&model, total_trajectories, number_timesteps, end_time, &propensity_function, random_seed, options);
+  for(unsigned int point = 0; point < point_functions.size(); point++){
+    simulation.add_point(&point_populations[point * model.number_species], point_functions[point].get());
+  }
+  if(!perturbed_values.empty()){
+    ssa_coupled_difference<IPropensityFunction>(&simulation, &perturbed_function, perturbed_populations.data());
+  }else if(algorithm == "direct"){
+    ssa_direct(&simulation);
+  }else if(algorithm == "next_reaction"){
+    ssa_next_reaction(&simulation);
+  }else if(algorithm == "composition_rejection"){
+    ssa_composition_rejection(&simulation);
+  }else{
+    std :: cerr << "Unknown algorithm " << algorithm << std :: endl;
+    return 1;
+  }
+  //std :: cout << simulation << std :: endl;
+  if(results_file){
+    simulation.output_results_mapped();
+    if(serve){
+      //Let the client know the results are ready to be mapped
+      std :: cout.write(reinterpret_cast<const char*>(simulation.output_header), sizeof(OutputHeader));
+      std :: cout.flush();
+    }
+  }else if(binary_output){
+    simulation.output_results_binary(std :: cout);
+  }else{
+    simulation.output_results_buffer(std :: cout);
+  }
+  return 0;
+}
+
+//Keeps the model resident and simulates it once per request read from stdin, until stdin closes or "quit" is read.
+//A request holds one option per line, written "-option value" as on the command line, and ends with a "run" line.
+//Each response is binary output on stdout, only its header if the results are written in place to a file.
+//A request which can not be run is answered with a header holding a nonzero status and no results.
+int serve_requests(Model& model){
+  //An interrupt stops the current request, not the server
+  signal(SIGINT, signalHandler);
+  reset_request_options();
+  std :: string line;
+  while(std :: getline(std :: cin, line)){
+    if(line == "quit"){
+      break;
+    }else if(line == "run"){
+      for(unsigned int i = 0; i < model.number_species; i++){
+	model.species[i].initial_population = populations[i];
+      }
+      binary_output = true;
+      interrupted = false;
+      if(run_simulation(model) != 0){
+	OutputHeader error_header = {{'G', 'P', 'Y', '2'}, sizeof(OutputHeader), 0, 0, model.number_species, 1, end_time, 0};
+	std :: cout.write(reinterpret_cast<const char*>(&error_header), sizeof(OutputHeader));
+	std :: cout.flush();
+      }
+      reset_request_options();
+    }else{
+      size_t split = line.find(' ');
+      parse_option(line.substr(0, split), split == std :: string :: npos ? "" : line.substr(split + 1));
+    }
+  }
+  return 0;
+}
+
 int main(int argc, char* argv[]){
- //Parse command line arguments
- std :: string arg;
- for(int i = 1; i < argc - 1; i++){
-   arg = argv[i];
-   if(argc > i+1 && arg.size() > 1 && arg[0] == '-'){
-     std :: stringstream arg_stream(argv[i+1]);
-     switch(arg[1]){
-     case 'i':
-       for(int j = 0; j < int(sizeof(populations)); j++){
-       arg_stream >> populations[j];
-       }
-       break;
-     case 'p':
-__DEFINE_PARAMETER_UPDATES__
-       break;
-     case 's':
-       arg_stream >> random_seed;
-       seed_time = false;
-       break;
-     case 'e':
-       arg_stream >> end_time;
-       break;
-     case 't':
-       if(arg[2] == 'r'){
-	 arg_stream >> number_trajectories;
-       }else if(arg[2] == 'i'){
-	 arg_stream >> number_timesteps;
-       }
-       break;
-     }
-   }
- }
+  //Parse command line arguments
+  for(int i = 1; i < argc; i++){
+    parse_option(argv[i], argc > i+1 ? argv[i+1] : "");
+  }
 
   std :: vector<std :: string> species_names(s_names, s_names + sizeof(s_names)/sizeof(std :: string));
   std :: vector<unsigned int> species_populations(populations, populations + sizeof(populations)/sizeof(populations[0]));
@@ -73,16 +291,10 @@ __DEFINE_PARAMETER_UPDATES__
   //Begin reaction species changes
 __DEFINE_REACTIONS_
   //End reaction species changes
-  model.update_affected_reactions();
- 
- if(seed_time){
-   random_seed = time(NULL);
- }
-  IPropensityFunction *propFun = new PropensityFunction();
-  Simulation simulation(&model, number_trajectories, number_timesteps, end_time, propFun, random_seed,simulation.current_time);
-  ssa_direct(&simulation);
-  //std :: cout << simulation << std :: endl;
-  simulation.output_results_buffer(std :: cout);
-  delete propFun;
-  return 0;
+  model.build();
+
+  if(serve){
+    return serve_requests(model);
+  }
+  return run_simulation(model);
 }
@@ -0,0 +1,290 @@
+#ifndef GILLESPY_BATCH
+#define GILLESPY_BATCH
+#include "model.h"
+#include "ssa.h"
+#include <algorithm>
+#include <memory>
+#include <utility>//Included for the batches handed out to threads
+#include <vector>
+
+//Number of trajectories the batch engine advances together, one per lane of the generated propensity kernels. The kernels
+//are loops over the lanes which the compiler vectorizes for the instruction set it targets, so a build for wider vector
+//units, with -march or -mavx2 in CFLAGS, may set a matching width with -DGILLESPY_BATCH_WIDTH.
+#ifndef GILLESPY_BATCH_WIDTH
+#define GILLESPY_BATCH_WIDTH 8
+#endif
+
+namespace Gillespy{
+  static const unsigned int batch_width = GILLESPY_BATCH_WIDTH;
+
+  //Populations of a batch of trajectories, indexed [species][lane]
+  typedef const unsigned int (*BatchState)[batch_width];
+
+  //Simulates every trajectory of a simulation in batches of up to batch_width trajectories, on up to simulation -> number_threads threads
+  //Each thread constructs its own BatchSimulator(simulation) to hold its scratch buffers, BatchSimulator :: simulate(first_trajectory,
+  //number_lanes, trajectories) fills the trajectories first_trajectory .. first_trajectory + number_lanes, and returns the time
+  //the first of them stopped at, trajectory 0's is kept as simulation -> current_time. Results are recorded as simulate_trajectories records them, with one scratch trajectory per lane.
+  template<typename BatchSimulator>
+  void simulate_batches(Simulation* simulation){
+    signal(SIGINT, signalHandler) ;
+
+    if(simulation){
+      //Batches never span trajectories of different points, so a batch shares one propensity function
+      std :: vector<std :: pair<unsigned int, unsigned int>> batches;
+      for(unsigned int trajectory_number = 0; trajectory_number < simulation -> number_trajectories; trajectory_number++){
+	if(batches.empty() || batches.back().second == batch_width || simulation -> trajectory_propensity_function(trajectory_number) != simulation -> trajectory_propensity_function(batches.back().first)){
+	  batches.emplace_back(trajectory_number, 0);
+	}
+	batches.back().second++;
+      }
+      unsigned int number_threads = std :: max(1u, std :: min(simulation -> number_threads, (unsigned int) batches.size()));
+      unsigned int number_observed = simulation -> number_observed;
+      std :: vector<TrajectoryStatistics> thread_statistics;
+      if(simulation -> statistics){
+	thread_statistics.assign(number_threads, *(simulation -> statistics));
+      }
+      //Batches are handed out one at a time, each writes only its own trajectories' slices of trajectories_1D
+      std :: atomic<unsigned int> next_batch(0);
+      std :: mutex counters_mutex;
+      auto simulate_thread = [&](unsigned int thread_number){
+	BatchSimulator simulator(simulation);
+	std :: vector<unsigned int> scratch_populations;
+	unsigned int scratch_size = 0;
+	if(simulation -> statistics){
+	  scratch_size = simulation -> number_timesteps * number_observed;
+	}else if(simulation -> record_changes || simulation -> record_every){
+	  scratch_size = number_observed;
+	}
+	scratch_populations.resize((size_t) scratch_size * batch_width);
+	Trajectory trajectories[batch_width];
+	for(unsigned int batch = next_batch++; batch < batches.size(); batch = next_batch++){
+	  if(interrupted){
+	    break ;
+	  }
+	  unsigned int first_trajectory = batches[batch].first;
+	  unsigned int number_lanes = batches[batch].second;
+	  for(unsigned int lane = 0; lane < number_lanes; lane++){
+	    if(simulation -> trajectories_1D){
+	      trajectories[lane] = simulation -> trajectory(first_trajectory + lane);
+	    }else{
+	      trajectories[lane] = {scratch_populations.data() + (size_t) lane * scratch_size, simulation -> statistics ? number_observed : 0};
+	    }
+	  }
+	  double stop_time = simulator.simulate(first_trajectory, number_lanes, trajectories);
+	  for(unsigned int lane = 0; lane < number_lanes; lane++){
+	    if(simulation -> profile){
+	      simulation -> trajectory_events[first_trajectory + lane] = simulator.lane_events[lane];
+	    }
+	    if(simulation -> stream && !interrupted){
+	      simulation -> stream -> write(*simulation, first_trajectory + lane, trajectories[lane][0]);
+	    }
+	    //Trajectories cut short by an interrupt are left out of the statistics
+	    if(simulation -> statistics && !interrupted){
+	      thread_statistics[thread_number].add(trajectories[lane][0]);
+	    }
+	  }
+	  if(first_trajectory == 0){
+	    simulation -> current_time = stop_time;
+	  }
+	}
+	std :: lock_guard<std :: mutex> lock(counters_mutex);
+	simulation -> counters.add(simulator.counters);
+      };
+      if(number_threads == 1){
+	simulate_thread(0);
+      }else{
+	std :: vector<std :: thread> threads;
+	for(unsigned int i = 0; i < number_threads; i++){
+	  threads.emplace_back(simulate_thread, i);
+	}
+	for(std :: thread& thread : threads){
+	  thread.join();
+	}
+      }
+      for(TrajectoryStatistics& statistics : thread_statistics){
+	simulation -> statistics -> merge(statistics);
+      }
+    }//end if simulation pointer not null
+  }
+
+  //Direct method advancing a batch of trajectories in lockstep. Every step, the propensities each lane's last reaction changed are
+  //recalculated for the whole batch by PropensityFunction :: evaluate_batch over the populations laid out by lane, then each lane
+  //draws its step from its own generator. Lanes that finished, or whose reaction did not change a propensity, are masked: their
+  //propensities are recalculated from unchanged populations and left as they were. Each lane draws the random numbers of the
+  //DirectMethod in the same order, so its trajectory is the one the direct method simulates.
+  template<typename PropensityFunction>
+  class BatchDirectMethod{
+  public:
+    EngineCounters counters;
+    //Reactions fired in each lane of the last batch
+    unsigned long long lane_events[batch_width];
+
+    BatchDirectMethod(Simulation* simulation) :
+      simulation(simulation),
+      profiler(counters, (simulation -> model) -> number_reactions),
+      state(new unsigned int[(simulation -> model) -> number_species][batch_width]),
+      propensity_values(new double[(simulation -> model) -> number_reactions][batch_width]),
+      lane_state(new unsigned int[(simulation -> model) -> number_species]),
+      changed((simulation -> model) -> number_reactions)
+    {
+      lanes.reserve(batch_width);
+      changed_reactions.reserve((simulation -> model) -> number_reactions);
+    }
+
+    double simulate(unsigned int first_trajectory, unsigned int number_lanes, Trajectory* trajectories){
+      Model* model = simulation -> model;
+      propensity_function = static_cast<PropensityFunction*>(simulation -> trajectory_propensity_function(first_trajectory));
+      unsigned int number_active = 0;
+      lanes.clear();
+      for(unsigned int lane = 0; lane < batch_width; lane++){
+	lane_events[lane] = 0;
+	if(lane >= number_lanes){
+	  //Unused lanes hold the first lane's populations so their propensities stay finite
+	  for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	    state[species_number][lane] = state[species_number][0];
+	  }
+	  continue;
+	}
+	lanes.emplace_back(simulation_rng(simulation, first_trajectory + lane));
+	Lane& current = lanes[lane];
+	start_trajectory(simulation, first_trajectory + lane, trajectories[lane], lane_state.get(), current.time, current.entry_count, current.rng);
+	current.step_rng = current.rng;
+	for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	  state[species_number][lane] = lane_state[species_number];
+	}
+	current.active = current.time < simulation -> end_time;
+	number_active += current.active;
+      }
+      //calculate initial propensities
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	propensity_function -> evaluate_batch(reaction_number, state.get(), propensity_values[reaction_number]);
+      }
+      counters.propensity_evaluations += (unsigned long long) model -> number_reactions * number_lanes;
+      while(number_active > 0){
+	if(interrupted){
+	  for(unsigned int lane = 0; lane < number_lanes; lane++){
+	    if(lanes[lane].active){
+	      save_checkpoint(simulation, first_trajectory + lane, lanes[lane].time, lanes[lane].entry_count, gather(lane), lanes[lane].rng);
+	    }
+	  }
+	  break;
+	}
+	profiler.start();
+	//Sum propensities, lane by lane in the order the direct method sums them
+	double propensity_sum[batch_width] = {};
+	for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	  for(unsigned int lane = 0; lane < batch_width; lane++){
+	    propensity_sum[lane] += propensity_values[reaction_number][lane];
+	  }
+	}
+	profiler.lap(&EngineCounters :: selection_seconds);
+	for(unsigned int lane = 0; lane < number_lanes; lane++){
+	  if(lanes[lane].active){
+	    step(first_trajectory + lane, lane, propensity_sum[lane], trajectories[lane]);
+	    number_active -= !lanes[lane].active;
+	  }
+	}
+	//Recalculate the propensities changed in any lane
+	for(unsigned int reaction_number : changed_reactions){
+	  propensity_function -> evaluate_batch(reaction_number, state.get(), propensity_values[reaction_number]);
+	  changed[reaction_number] = false;
+	}
+	counters.propensity_evaluations += (unsigned long long) changed_reactions.size() * number_lanes;
+	changed_reactions.clear();
+	profiler.lap(&EngineCounters :: update_seconds);
+      }
+      return lanes[0].time;
+    }
+
+  private:
+    //Where a lane's trajectory is
+    struct Lane{
+      Lane(const TrajectoryRng& rng) : rng(rng), step_rng(rng) {}
+      bool active;
+      double time;
+      unsigned int entry_count;
+      TrajectoryRng rng;
+      //Generator at the start of the step, kept to checkpoint the step that passes the end time
+      TrajectoryRng step_rng;
+    };
+
+    Simulation* simulation;
+    EngineProfiler profiler;
+    PropensityFunction* propensity_function;
+    std :: vector<Lane> lanes;
+    std :: unique_ptr<unsigned int[][batch_width]> state;
+    std :: unique_ptr<double[][batch_width]> propensity_values;
+    //A lane's populations, copied out for recording and checkpoints
+    std :: unique_ptr<unsigned int[]> lane_state;
+    //Reactions whose propensities changed in any lane this step
+    std :: vector<bool> changed;
+    std :: vector<unsigned int> changed_reactions;
+
+    unsigned int* gather(unsigned int lane){
+      for(unsigned int species_number = 0; species_number < (simulation -> model) -> number_species; species_number++){
+	lane_state[species_number] = state[species_number][lane];
+      }
+      return lane_state.get();
+    }
+
+    //Takes one step of the direct method in a lane
+    void step(unsigned int trajectory_number, unsigned int lane, double propensity_sum, Trajectory trajectory){
+      Model* model = simulation -> model;
+      Lane& current = lanes[lane];
+      //No more reactions
+      if(propensity_sum <= 0){
+	gather(lane);
+	save_checkpoint(simulation, trajectory_number, current.time, current.entry_count, lane_state.get(), current.rng);
+	fill_trajectory(simulation, trajectory_number, trajectory, current.entry_count, lane_state.get());
+	current.active = false;
+	return;
+      }
+      if(simulation -> save_checkpoints){
+	current.step_rng = current.rng;
+      }
+      double step_time = current.time;
+      double cumulative_sum = current.rng.uniform() * propensity_sum;
+      current.time += current.rng.exponential() / propensity_sum;
+      if(current.time >= simulation -> end_time){
+	save_checkpoint(simulation, trajectory_number, step_time, current.entry_count, gather(lane), current.step_rng);
+      }
+      //Copy current state to passed timesteps, the state is only gathered for the steps that pass one
+      if(current.entry_count < simulation -> number_timesteps && simulation -> timeline[current.entry_count] <= current.time){
+	current.entry_count = record_state(simulation, trajectory_number, trajectory, current.entry_count, current.time, gather(lane));
+      }
+      for(unsigned int potential_reaction = 0; potential_reaction < model -> number_reactions; potential_reaction++){
+	cumulative_sum -= propensity_values[potential_reaction][lane];
+	//This reaction fired
+	if(cumulative_sum <= 0 && propensity_values[potential_reaction][lane] > 0){
+	  const SpeciesCount* end = model -> species_changes.end(potential_reaction);
+	  for(const SpeciesCount* change = model -> species_changes.begin(potential_reaction); change != end; change++){
+	    state[change -> species][lane] += change -> count;
+	  }
+	  unsigned int fan_out = model -> affected_offsets[potential_reaction + 1] - model -> affected_offsets[potential_reaction];
+	  counters.events++;
+	  lane_events[lane]++;
+	  profiler.fired(potential_reaction, 1, fan_out);
+	  if(simulation -> record_every){
+	    record_event(simulation, trajectory_number, current.time, gather(lane));
+	  }
+	  for(unsigned int i = model -> affected_offsets[potential_reaction]; i < model -> affected_offsets[potential_reaction + 1]; i++){
+	    unsigned int affected_reaction = model -> affected_reactions[i];
+	    if(!changed[affected_reaction]){
+	      changed[affected_reaction] = true;
+	      changed_reactions.push_back(affected_reaction);
+	    }
+	  }
+	  break;
+	}
+      }
+      current.active = current.time < simulation -> end_time;
+    }
+  };
+
+  //Direct method over batches of batch_width trajectories, PropensityFunction :: evaluate_batch evaluates a reaction for every lane
+  template<typename PropensityFunction>
+  void ssa_batch_direct(Simulation* simulation){
+    simulate_batches<BatchDirectMethod<PropensityFunction>>(simulation);
+  }//end ssa_batch_direct
+}
+#endif
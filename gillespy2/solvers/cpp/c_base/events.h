@@ -0,0 +1,276 @@
+#ifndef GILLESPY_EVENTS
+#define GILLESPY_EVENTS
+#include "model.h"
+#include "ssa.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+//Assignment rules and events of a model, as the TauHybridSolver simulates them. The generated ModelEvents evaluates them
+//over populations read as doubles and the time t:
+//  number_events, active, whether the model has any rules or events, and target_readers, the reactions whose
+//  propensities read a species or parameter they assign
+//  reset() sets the parameters they assign, which are thread_local, back to their initial values
+//  assign_rules(S, t) carries out every assignment rule in order, returning whether a value changed
+//  settings(event), trigger(event, S, t), delay(event, S, t) and priority(event, S, t)
+//  values(event, S, t, V) evaluates an event's assignments into V, assign(event, V, S) carries them out
+//Engines call EventHandler :: update after every step, so a trigger fires at the first step it is true at.
+namespace Gillespy{
+
+  //An event's settings, those of Event and EventTrigger
+  struct EventSettings{
+    bool initial_value; //value of the trigger before time 0, an event whose trigger starts false fires at time 0 if it is true
+    bool persistent; //delayed assignments are carried out even if the trigger turns false before they are due
+    bool use_values_from_trigger_time; //delayed assignments are evaluated when triggered, else when carried out
+    bool delayed;
+    unsigned int number_assignments;
+  };
+
+  //Sets a population to the nearest count, returns whether it changed
+  inline bool assign_value(unsigned int& target, double value){
+    unsigned int population = value > 0 ? (unsigned int) std :: lround(value) : 0;
+    bool changed = population != target;
+    target = population;
+    return changed;
+  }
+
+  //Sets a parameter or a real valued population, returns whether it changed
+  inline bool assign_value(double& target, double value){
+    bool changed = value != target;
+    target = value;
+    return changed;
+  }
+
+  //Trigger values and delayed assignments of the events of the trajectory a thread simulates
+  template<typename ModelEvents>
+  class EventHandler{
+  public:
+    ModelEvents events;
+
+    EventHandler() :
+      trigger_values(ModelEvents :: number_events),
+      settings(ModelEvents :: number_events)
+    {
+      for(unsigned int event_number = 0; event_number < ModelEvents :: number_events; event_number++){
+	settings[event_number] = events.settings(event_number);
+      }
+    }
+
+    //Starts a trajectory at time 0 from populations S, returns whether its rules or events changed them
+    template<typename State>
+    bool start(State* S){
+      events.reset();
+      pending.clear();
+      for(unsigned int event_number = 0; event_number < ModelEvents :: number_events; event_number++){
+	trigger_values[event_number] = settings[event_number].initial_value;
+      }
+      return update(0, S);
+    }
+
+    //Time the next delayed assignments are due at, infinite if there are none
+    double next_time() const{
+      return pending.empty() ? std :: numeric_limits<double> :: infinity() : pending.front().time;
+    }
+
+    //Carries out the assignment rules, then the delayed assignments due by time and the events whose triggers turned true,
+    //until no more triggers turn true. Assignments carried out together are all evaluated first, and carried out by
+    //descending priority. Returns whether a population or parameter changed.
+    template<typename State>
+    bool update(double time, State* S){
+      bool changed = events.assign_rules(S, time);
+      //Events triggering each other at the same time are carried out in passes, bounded in case they never settle
+      for(unsigned int pass = 0; pass < max_passes; pass++){
+	ready.clear();
+	while(!pending.empty() && pending.front().time <= time){
+	  std :: pop_heap(pending.begin(), pending.end(), later);
+	  ready.push_back(std :: move(pending.back()));
+	  pending.pop_back();
+	}
+	for(unsigned int event_number = 0; event_number < ModelEvents :: number_events; event_number++){
+	  bool value = events.trigger(event_number, S, time);
+	  if(value && !trigger_values[event_number]){
+	    Assignment assignment = {time, event_number, sequence++, false, 0, {}};
+	    if(!settings[event_number].delayed){
+	      ready.push_back(std :: move(assignment));
+	    }else{
+	      assignment.time += events.delay(event_number, S, time);
+	      if(settings[event_number].use_values_from_trigger_time){
+		evaluate(assignment, S, time);
+	      }
+	      pending.push_back(std :: move(assignment));
+	      std :: push_heap(pending.begin(), pending.end(), later);
+	    }
+	  }else if(!value && trigger_values[event_number] && !settings[event_number].persistent){
+	    cancel(event_number);
+	  }
+	  trigger_values[event_number] = value;
+	}
+	if(ready.empty()){
+	  break;
+	}
+	for(Assignment& assignment : ready){
+	  if(!assignment.evaluated){
+	    evaluate(assignment, S, time);
+	  }
+	  assignment.priority = events.priority(assignment.event_number, S, time);
+	}
+	std :: stable_sort(ready.begin(), ready.end(), [](const Assignment& first, const Assignment& second){
+	  return first.priority > second.priority;
+	});
+	for(const Assignment& assignment : ready){
+	  changed = events.assign(assignment.event_number, assignment.values.data(), S) || changed;
+	}
+	changed = events.assign_rules(S, time) || changed;
+      }
+      return changed;
+    }
+
+  private:
+    static const unsigned int max_passes = 1000;
+
+    //An event's assignments, due at time
+    struct Assignment{
+      double time;
+      unsigned int event_number;
+      unsigned long long sequence; //order triggered in, ordering assignments due at the same time
+      bool evaluated;
+      double priority;
+      std :: vector<double> values;
+    };
+
+    //Orders pending as a min-heap of due times
+    static bool later(const Assignment& first, const Assignment& second){
+      return first.time > second.time || (first.time == second.time && first.sequence > second.sequence);
+    }
+
+    template<typename State>
+    void evaluate(Assignment& assignment, const State* S, double time){
+      assignment.values.resize(settings[assignment.event_number].number_assignments);
+      events.values(assignment.event_number, S, time, assignment.values.data());
+      assignment.evaluated = true;
+    }
+
+    //Drops the delayed assignments of an event whose trigger turned false
+    void cancel(unsigned int event_number){
+      auto end = std :: remove_if(pending.begin(), pending.end(), [event_number](const Assignment& assignment){
+	return assignment.event_number == event_number;
+      });
+      if(end != pending.end()){
+	pending.erase(end, pending.end());
+	std :: make_heap(pending.begin(), pending.end(), later);
+      }
+    }
+
+    std :: vector<unsigned char> trigger_values;
+    std :: vector<EventSettings> settings;
+    std :: vector<Assignment> pending;
+    std :: vector<Assignment> ready;
+    unsigned long long sequence = 0;
+  };
+
+  //Direct method carrying out the model's assignment rules and events after every reaction. Delayed assignments are
+  //carried out at the time they are due, and triggers are also checked at every timestep, so triggers on the time alone
+  //fire by the first timestep they are true at while no reactions fire.
+  template<typename PropensityFunction, typename ModelEvents>
+  class EventMethod{
+  public:
+    EngineCounters counters;
+
+    EventMethod(Simulation* simulation) :
+      simulation(simulation),
+      profiler(counters, (simulation -> model) -> number_reactions),
+      current_state(new unsigned int[(simulation -> model) -> number_species]),
+      propensity_values(new double[(simulation -> model) -> number_reactions])
+    {}
+
+    double simulate(unsigned int trajectory_number, Trajectory trajectory){
+      Model* model = simulation -> model;
+      TrajectoryRng rng = simulation_rng(simulation, trajectory_number);
+      propensity_function = static_cast<PropensityFunction*>(simulation -> trajectory_propensity_function(trajectory_number));
+      initial_populations(simulation, trajectory_number, current_state.get());
+      handler.start(current_state.get());
+      record_initial_state(simulation, trajectory_number, trajectory, current_state.get());
+      double current_time = 0;
+      unsigned int entry_count = 1;
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	propensity_values[reaction_number] = propensity_function -> evaluate(reaction_number, current_state.get());
+      }
+      counters.propensity_evaluations += model -> number_reactions;
+      while(current_time < (simulation -> end_time)){
+	if(interrupted){
+	  break ;
+	}
+	profiler.start();
+	double propensity_sum = 0;
+	for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	  propensity_sum += propensity_values[reaction_number];
+	}
+	double reaction_time = propensity_sum > 0 ? current_time + rng.exponential() / propensity_sum : std :: numeric_limits<double> :: infinity();
+	double event_time = handler.next_time();
+	if(ModelEvents :: number_events > 0 && entry_count < simulation -> number_timesteps){
+	  event_time = std :: min(event_time, simulation -> timeline[entry_count]);
+	}
+	//No more reactions or events
+	if(std :: isinf(reaction_time) && std :: isinf(event_time)){
+	  fill_trajectory(simulation, trajectory_number, trajectory, entry_count, current_state.get());
+	  profiler.lap(&EngineCounters :: output_seconds);
+	  break;
+	}
+	bool fires = reaction_time <= event_time;
+	current_time = fires ? reaction_time : event_time;
+	profiler.lap(&EngineCounters :: selection_seconds);
+	//Copy current state to passed timesteps, a timestep stopped at is recorded once its events are carried out
+	if(fires){
+	  entry_count = record_state(simulation, trajectory_number, trajectory, entry_count, current_time, current_state.get());
+	  profiler.lap(&EngineCounters :: output_seconds);
+	  double cumulative_sum = rng.uniform() * propensity_sum;
+	  for(unsigned int potential_reaction = 0; potential_reaction < model -> number_reactions; potential_reaction++){
+	    cumulative_sum -= propensity_values[potential_reaction];
+	    if(cumulative_sum <= 0 && propensity_values[potential_reaction] > 0){
+	      fire_reaction(model, potential_reaction, current_state.get());
+	      unsigned int fan_out = model -> affected_offsets[potential_reaction + 1] - model -> affected_offsets[potential_reaction];
+	      counters.events++;
+	      counters.propensity_evaluations += fan_out;
+	      profiler.fired(potential_reaction, 1, fan_out);
+	      for(unsigned int i = model -> affected_offsets[potential_reaction]; i < model -> affected_offsets[potential_reaction + 1]; i++){
+		unsigned int affected_reaction = model -> affected_reactions[i];
+		propensity_values[affected_reaction] = propensity_function -> evaluate(affected_reaction, current_state.get());
+	      }
+	      break;
+	    }
+	  }
+	}
+	//Propensities reading what the rules and events assign are recalculated once they change
+	if(handler.update(current_time, current_state.get())){
+	  for(unsigned int reaction_number : handler.events.target_readers){
+	    propensity_values[reaction_number] = propensity_function -> evaluate(reaction_number, current_state.get());
+	  }
+	  counters.propensity_evaluations += handler.events.target_readers.size();
+	}
+	if(fires){
+	  record_event(simulation, trajectory_number, current_time, current_state.get());
+	}else{
+	  entry_count = record_state(simulation, trajectory_number, trajectory, entry_count, current_time, current_state.get());
+	}
+	profiler.lap(&EngineCounters :: update_seconds);
+      }
+      return current_time;
+    }
+
+  private:
+    Simulation* simulation;
+    EngineProfiler profiler;
+    PropensityFunction* propensity_function;
+    EventHandler<ModelEvents> handler;
+    std :: unique_ptr<unsigned int[]> current_state;
+    std :: unique_ptr<double[]> propensity_values;
+  };
+
+  //Direct method with the model's assignment rules and events
+  template<typename PropensityFunction, typename ModelEvents>
+  void ssa_events(Simulation* simulation){
+    simulate_trajectories<EventMethod<PropensityFunction, ModelEvents>>(simulation);
+  }//end ssa_events
+}
+#endif
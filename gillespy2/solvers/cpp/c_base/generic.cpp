@@ -0,0 +1,97 @@
+#include "generic.h"
+#include <cstring>
+#include <fstream>
+
+namespace Gillespy{
+
+  namespace{
+    template<typename Value>
+    bool read_value(std :: istream& file, Value& value){
+      return (bool) file.read(reinterpret_cast<char*>(&value), sizeof(Value));
+    }
+
+    bool read_name(std :: istream& file, std :: string& name){
+      uint32_t length;
+      if(!read_value(file, length)){
+	return false;
+      }
+      name.resize(length);
+      return length == 0 || (bool) file.read(&name[0], length);
+    }
+
+    bool read_counts(std :: istream& file, unsigned int number_species, std :: vector<SpeciesCount>& counts){
+      uint32_t number_counts;
+      if(!read_value(file, number_counts)){
+	return false;
+      }
+      counts.resize(number_counts);
+      for(SpeciesCount& count : counts){
+	uint32_t species;
+	int32_t value;
+	if(!read_value(file, species) || !read_value(file, value) || species >= number_species){
+	  return false;
+	}
+	count = {species, value};
+      }
+      return true;
+    }
+  }
+
+  bool GenericModel :: load(int argc, char* argv[]){
+    std :: string path;
+    for(int i = 1; i + 1 < argc; i++){
+      if(std :: strcmp(argv[i], "-model") == 0){
+	path = argv[i + 1];
+      }
+    }
+    if(path.empty()){
+      std :: cerr << "The generic simulation requires a model description named by -model" << std :: endl;
+      return false;
+    }
+    std :: ifstream file(path, std :: ios :: binary);
+    if(!file){
+      std :: cerr << "Could not open model description " << path << std :: endl;
+      return false;
+    }
+    char magic[4];
+    uint32_t number_species, number_reactions;
+    bool valid = file.read(magic, sizeof(magic)) && std :: memcmp(magic, "GPYM", sizeof(magic)) == 0
+      && read_value(file, number_species) && read_value(file, number_reactions) && read_value(file, volume);
+    species_names.resize(valid ? number_species : 0);
+    populations.resize(species_names.size());
+    for(unsigned int s = 0; valid && s < number_species; s++){
+      uint32_t population;
+      valid = read_value(file, population) && read_name(file, species_names[s]);
+      populations[s] = population;
+    }
+    reaction_names.resize(valid ? number_reactions : 0);
+    reactions.resize(reaction_names.size());
+    reactants.resize(reaction_names.size());
+    species_changes.resize(reaction_names.size());
+    for(unsigned int r = 0; valid && r < number_reactions; r++){
+      Reaction& reaction = reactions[r];
+      valid = read_name(file, reaction_names[r]) && read_value(file, reaction.rate) && read_value(file, reaction.form)
+	&& read_value(file, reaction.a) && read_value(file, reaction.b) && reaction.form <= SECOND_ORDER
+	&& (reaction.form == ZEROTH_ORDER || reaction.a < number_species) && (reaction.form != SECOND_ORDER || reaction.b < number_species)
+	&& read_counts(file, number_species, reactants[r]) && read_counts(file, number_species, species_changes[r]);
+    }
+    if(!valid){
+      std :: cerr << "Model description " << path << " is malformed" << std :: endl;
+    }
+    return valid;
+  }
+
+  void GenericModel :: build(Model& model) const{
+    for(unsigned int r = 0; r < reactions.size(); r++){
+      for(const SpeciesCount& change : species_changes[r]){
+	model.species_changes.add(r, change);
+      }
+      //Propensities and rates read the reactants, listed by species as the code generator lists them
+      for(const SpeciesCount& reactant : reactants[r]){
+	model.reactants.add(r, reactant);
+	model.propensity_species.add(r, reactant.species);
+	model.rate_species.add(r, reactant.species);
+      }
+    }
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef GILLESPY_GENERIC
+#define GILLESPY_GENERIC
+#include "model.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Models of mass-action reactions loaded at runtime, so one precompiled simulation simulates any of them without a build.
+//The description named by -model, written by solverutils._write_model_description, is the magic GPYM, then the uint32
+//numbers of species and reactions and the double volume. Each species follows as its uint32 population and name, then
+//each reaction as its name, double rate, uint32 form and the two species its propensity reads, and its reactants and
+//species changes, each a uint32 count of (uint32 species, int32 count) entries. Names are a uint32 length and its bytes.
+namespace Gillespy{
+
+  class GenericModel{
+  public:
+    //Mass-action propensities, k*V, k*S[a], k*S[a]*(S[a]-1)/V and k*S[a]*S[b]/V
+    enum Form : uint32_t {ZEROTH_ORDER = 0, FIRST_ORDER = 1, DIMERIZATION = 2, SECOND_ORDER = 3};
+
+    std :: vector<std :: string> species_names;
+    std :: vector<unsigned int> populations;
+    std :: vector<std :: string> reaction_names;
+
+    //Reads the description named by the -model argument, returns false if it is missing or malformed
+    bool load(int argc, char* argv[]);
+    //Adds the reactions' species changes, reactants, and the species their propensities and rates read to model
+    void build(Model& model) const;
+
+    //Evaluated in the order the code generator writes each form, so trajectories match those of a compiled model
+    double propensity(unsigned int reaction_number, const unsigned int* S) const{
+      const Reaction& reaction = reactions[reaction_number];
+      switch(reaction.form){
+      case ZEROTH_ORDER:
+	return reaction.rate*volume;
+      case FIRST_ORDER:
+	return reaction.rate*S[reaction.a];
+      case DIMERIZATION:
+	return reaction.rate*S[reaction.a]*(S[reaction.a]-1)/volume;
+      default:
+	return reaction.rate*S[reaction.a]*S[reaction.b]/volume;
+      }
+    }
+
+    //Propensities of a reaction for every lane of a batch, populations indexed [species][lane]
+    template<unsigned int width>
+    void propensity_batch(unsigned int reaction_number, const unsigned int (*S)[width], double* propensities) const{
+      const Reaction& reaction = reactions[reaction_number];
+      const double rate = reaction.rate;
+      switch(reaction.form){
+      case ZEROTH_ORDER:
+	for(unsigned int lane = 0; lane < width; lane++){
+	  propensities[lane] = rate*volume;
+	}
+	break;
+      case FIRST_ORDER:
+	for(unsigned int lane = 0; lane < width; lane++){
+	  propensities[lane] = rate*S[reaction.a][lane];
+	}
+	break;
+      case DIMERIZATION:
+	for(unsigned int lane = 0; lane < width; lane++){
+	  propensities[lane] = rate*S[reaction.a][lane]*(S[reaction.a][lane]-1)/volume;
+	}
+	break;
+      default:
+	for(unsigned int lane = 0; lane < width; lane++){
+	  propensities[lane] = rate*S[reaction.a][lane]*S[reaction.b][lane]/volume;
+	}
+	break;
+      }
+    }
+
+  private:
+    struct Reaction{
+      double rate;
+      uint32_t form;
+      //Species the propensity reads, in the order it multiplies them
+      uint32_t a;
+      uint32_t b;
+    };
+
+    double volume = 1;
+    std :: vector<Reaction> reactions;
+    std :: vector<std :: vector<SpeciesCount>> reactants;
+    std :: vector<std :: vector<SpeciesCount>> species_changes;
+  };
+}
+#endif
@@ -0,0 +1,255 @@
+#ifndef GILLESPY_GPU
+#define GILLESPY_GPU
+
+//Marks the generated functions compiled for both the CPU engines and the GPU kernel. Simulations are compiled for the GPU by
+//the UserSimulationGPU target, with nvcc, every other build compiles them for the CPU only.
+#ifdef __CUDACC__
+#define GILLESPY_DEVICE __host__ __device__
+#else
+#define GILLESPY_DEVICE
+#endif
+
+#ifdef __CUDACC__
+#include "model.h"
+#include "ssa.h"
+#include <curand_kernel.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+//Species a model simulated on the GPU may have, each thread keeps its populations in an array of this size
+#ifndef GILLESPY_GPU_MAX_SPECIES
+#define GILLESPY_GPU_MAX_SPECIES 64
+#endif
+
+//GPU direct method, one trajectory per thread. PropensityFunction :: propensity(reaction_number, S) is compiled for the device,
+//the species changes and dependency graph of the Model are copied to the device once, and trajectories are simulated in chunks
+//sized to the device's free memory. Each chunk is copied into the simulation's trajectories_1D, or added to its statistics,
+//before the next is launched, so ensembles larger than device memory stream through it.
+namespace Gillespy{
+
+  //Device copies of the tables a kernel reads, indexed as on the host
+  struct GPUModel{
+    unsigned int number_species;
+    unsigned int number_reactions;
+    const unsigned int* initial_populations;
+    const unsigned int* change_offsets; //species changes of reaction r are changes[change_offsets[r] .. change_offsets[r+1])
+    const SpeciesCount* changes;
+    const unsigned int* affected_offsets;
+    const unsigned int* affected_reactions;
+  };
+
+  //A chunk of trajectories, with the propensities and output of every thread. Propensities are laid out [reaction][thread]
+  //so neighbouring threads read neighbouring words.
+  struct GPUChunk{
+    unsigned int first_trajectory; //number of the chunk's first trajectory within the ensemble, see simulation_rng
+    unsigned int number_trajectories;
+    unsigned long long seed;
+    double end_time;
+    const double* timeline;
+    unsigned int number_timesteps;
+    const unsigned int* observed_species; //species of each output column
+    unsigned int number_observed;
+    double* propensities;
+    unsigned int* trajectories; //uint32[number_trajectories][number_timesteps][number_observed]
+    unsigned long long* events; //reactions fired by each trajectory
+  };
+
+  //Direct method for the trajectory of one thread. Its generator is the counter based Philox generator of curand, with the
+  //trajectory number as the subsequence, so each trajectory draws the same numbers whichever chunk or thread simulates it.
+  template<typename PropensityFunction>
+  __global__ void gpu_direct_kernel(GPUModel model, GPUChunk chunk){
+    unsigned int thread = blockIdx.x * blockDim.x + threadIdx.x;
+    if(thread >= chunk.number_trajectories){
+      return;
+    }
+    unsigned int stride = chunk.number_trajectories;
+    double* propensities = chunk.propensities + thread;
+    unsigned int* trajectory = chunk.trajectories + (size_t) thread * chunk.number_timesteps * chunk.number_observed;
+    curandStatePhilox4_32_10_t rng;
+    curand_init(chunk.seed, chunk.first_trajectory + thread, 0, &rng);
+    unsigned int current_state[GILLESPY_GPU_MAX_SPECIES];
+    for(unsigned int species_number = 0; species_number < model.number_species; species_number++){
+      current_state[species_number] = model.initial_populations[species_number];
+    }
+    for(unsigned int reaction_number = 0; reaction_number < model.number_reactions; reaction_number++){
+      propensities[reaction_number * stride] = PropensityFunction :: propensity(reaction_number, current_state);
+    }
+    for(unsigned int column = 0; column < chunk.number_observed; column++){
+      trajectory[column] = current_state[chunk.observed_species[column]];
+    }
+    double current_time = 0;
+    unsigned int entry_count = 1;
+    unsigned long long events = 0;
+    while(current_time < chunk.end_time){
+      double propensity_sum = 0;
+      for(unsigned int reaction_number = 0; reaction_number < model.number_reactions; reaction_number++){
+	propensity_sum += propensities[reaction_number * stride];
+      }
+      //No more reactions, copy the state to the rest of the timesteps
+      if(propensity_sum <= 0){
+	current_time = chunk.end_time;
+      }else{
+	//curand_uniform_double is in (0, 1], so its logarithm is finite
+	double cumulative_sum = curand_uniform_double(&rng) * propensity_sum;
+	current_time -= log(curand_uniform_double(&rng)) / propensity_sum;
+	//Copy current state to passed timesteps
+	for(; entry_count < chunk.number_timesteps && chunk.timeline[entry_count] <= current_time; entry_count++){
+	  for(unsigned int column = 0; column < chunk.number_observed; column++){
+	    trajectory[entry_count * chunk.number_observed + column] = current_state[chunk.observed_species[column]];
+	  }
+	}
+	for(unsigned int potential_reaction = 0; potential_reaction < model.number_reactions; potential_reaction++){
+	  double propensity = propensities[potential_reaction * stride];
+	  cumulative_sum -= propensity;
+	  if(cumulative_sum <= 0 && propensity > 0){
+	    for(unsigned int i = model.change_offsets[potential_reaction]; i < model.change_offsets[potential_reaction + 1]; i++){
+	      current_state[model.changes[i].species] += model.changes[i].count;
+	    }
+	    events++;
+	    for(unsigned int i = model.affected_offsets[potential_reaction]; i < model.affected_offsets[potential_reaction + 1]; i++){
+	      unsigned int affected_reaction = model.affected_reactions[i];
+	      propensities[affected_reaction * stride] = PropensityFunction :: propensity(affected_reaction, current_state);
+	    }
+	    break;
+	  }
+	}
+      }
+      if(current_time >= chunk.end_time){
+	for(; entry_count < chunk.number_timesteps; entry_count++){
+	  for(unsigned int column = 0; column < chunk.number_observed; column++){
+	    trajectory[entry_count * chunk.number_observed + column] = current_state[chunk.observed_species[column]];
+	  }
+	}
+      }
+    }
+    chunk.events[thread] = events;
+  }
+
+  //Device allocation freed when it goes out of scope
+  template<typename T>
+  class DeviceArray{
+  public:
+    DeviceArray() {}
+    DeviceArray(const DeviceArray&) = delete;
+    ~DeviceArray(){
+      cudaFree(data);
+    }
+
+    //Allocates size elements, copying them from values if given, returns whether it succeeded
+    bool allocate(size_t size, const T* values = nullptr){
+      cudaFree(data);
+      data = nullptr;
+      if(cudaMalloc(&data, std :: max(size, (size_t) 1) * sizeof(T)) != cudaSuccess){
+	return false;
+      }
+      return !values || cudaMemcpy(data, values, size * sizeof(T), cudaMemcpyHostToDevice) == cudaSuccess;
+    }
+
+    T* data = nullptr;
+  };
+
+  inline bool gpu_error(const char* stage){
+    cudaError_t error = cudaGetLastError();
+    if(error != cudaSuccess){
+      std :: cerr << "GPU error " << stage << ": " << cudaGetErrorString(error) << std :: endl;
+      return true;
+    }
+    return false;
+  }
+
+  //Simulates every trajectory of a simulation on the GPU, returns false if the device failed. Trajectories are stored in
+  //simulation -> trajectories_1D, or added to simulation -> statistics.
+  template<typename PropensityFunction>
+  bool gpu_direct(Simulation* simulation){
+    signal(SIGINT, signalHandler) ;
+    Model* model = simulation -> model;
+    if(model -> number_species > GILLESPY_GPU_MAX_SPECIES){
+      std :: cerr << "The gpu_direct algorithm simulates models of up to " << GILLESPY_GPU_MAX_SPECIES << " species" << std :: endl;
+      return false;
+    }
+    //Host copies of the tables, flattened as the kernel reads them
+    std :: vector<unsigned int> initial_populations(model -> number_species);
+    for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+      initial_populations[species_number] = model -> species[species_number].initial_population;
+    }
+    std :: vector<unsigned int> change_offsets(model -> number_reactions + 1, 0);
+    std :: vector<SpeciesCount> changes;
+    for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+      changes.insert(changes.end(), model -> species_changes.begin(reaction_number), model -> species_changes.end(reaction_number));
+      change_offsets[reaction_number + 1] = changes.size();
+    }
+    std :: vector<unsigned int> observed_species(simulation -> number_observed);
+    for(unsigned int column = 0; column < simulation -> number_observed; column++){
+      observed_species[column] = simulation -> observed(column);
+    }
+    DeviceArray<unsigned int> device_populations, device_change_offsets, device_affected_offsets, device_affected_reactions, device_observed;
+    DeviceArray<SpeciesCount> device_changes;
+    DeviceArray<double> device_timeline;
+    if(!device_populations.allocate(initial_populations.size(), initial_populations.data())
+       || !device_change_offsets.allocate(change_offsets.size(), change_offsets.data())
+       || !device_changes.allocate(changes.size(), changes.data())
+       || !device_affected_offsets.allocate(model -> affected_offsets.size(), model -> affected_offsets.data())
+       || !device_affected_reactions.allocate(model -> affected_reactions.size(), model -> affected_reactions.data())
+       || !device_observed.allocate(observed_species.size(), observed_species.data())
+       || !device_timeline.allocate(simulation -> number_timesteps, simulation -> timeline)){
+      gpu_error("copying the model");
+      return false;
+    }
+    GPUModel device_model = {model -> number_species, model -> number_reactions, device_populations.data, device_change_offsets.data,
+			     device_changes.data, device_affected_offsets.data, device_affected_reactions.data};
+
+    //Chunks take up to half the free device memory
+    size_t trajectory_bytes = (size_t) model -> number_reactions * sizeof(double)
+      + (size_t) simulation -> number_timesteps * simulation -> number_observed * sizeof(unsigned int) + sizeof(unsigned long long);
+    size_t free_bytes = 0, total_bytes = 0;
+    cudaMemGetInfo(&free_bytes, &total_bytes);
+    unsigned int chunk_size = (unsigned int) std :: min<size_t>(simulation -> number_trajectories, std :: max<size_t>(1, free_bytes / 2 / trajectory_bytes));
+    DeviceArray<unsigned int> device_trajectories;
+    DeviceArray<double> device_propensities;
+    DeviceArray<unsigned long long> device_events;
+    if(!device_propensities.allocate((size_t) chunk_size * model -> number_reactions)
+       || !device_trajectories.allocate((size_t) chunk_size * simulation -> number_timesteps * simulation -> number_observed)
+       || !device_events.allocate(chunk_size)){
+      gpu_error("allocating trajectories");
+      return false;
+    }
+    std :: vector<unsigned int> chunk_trajectories;
+    if(!simulation -> trajectories_1D){
+      chunk_trajectories.resize((size_t) chunk_size * simulation -> number_timesteps * simulation -> number_observed);
+    }
+    std :: vector<unsigned long long> events(chunk_size);
+    const unsigned int block_size = 128;
+    unsigned int first_trajectory = 0;
+    for(; first_trajectory < simulation -> number_trajectories && !interrupted; first_trajectory += chunk_size){
+      unsigned int number_trajectories = std :: min(chunk_size, simulation -> number_trajectories - first_trajectory);
+      GPUChunk chunk = {simulation -> first_trajectory + first_trajectory, number_trajectories, (unsigned long long) simulation -> random_seed, simulation -> end_time,
+			device_timeline.data, simulation -> number_timesteps, device_observed.data, simulation -> number_observed,
+			device_propensities.data, device_trajectories.data, device_events.data};
+      gpu_direct_kernel<PropensityFunction><<<(number_trajectories + block_size - 1) / block_size, block_size>>>(device_model, chunk);
+      cudaDeviceSynchronize();
+      if(gpu_error("simulating trajectories")){
+	return false;
+      }
+      size_t chunk_entries = (size_t) number_trajectories * simulation -> number_timesteps * simulation -> number_observed;
+      unsigned int* populations = simulation -> trajectories_1D ? simulation -> trajectory(first_trajectory).populations : chunk_trajectories.data();
+      if(cudaMemcpy(populations, device_trajectories.data, chunk_entries * sizeof(unsigned int), cudaMemcpyDeviceToHost) != cudaSuccess
+	 || cudaMemcpy(events.data(), device_events.data, number_trajectories * sizeof(unsigned long long), cudaMemcpyDeviceToHost) != cudaSuccess){
+	gpu_error("copying trajectories");
+	return false;
+      }
+      for(unsigned int trajectory_number = 0; trajectory_number < number_trajectories; trajectory_number++){
+	if(simulation -> statistics){
+	  simulation -> statistics -> add(populations + (size_t) trajectory_number * simulation -> number_timesteps * simulation -> number_observed);
+	}
+	simulation -> counters.events += events[trajectory_number];
+      }
+    }
+    //Kernels always run their trajectories to the end time, but the trajectories of chunks an interrupt skipped were never
+    //simulated, so the ensemble only reached the end time once every chunk ran
+    simulation -> current_time = first_trajectory >= simulation -> number_trajectories ? simulation -> end_time : 0;
+    return true;
+  }
+}
+#endif
+#endif
@@ -0,0 +1,312 @@
+#ifndef GILLESPY_HYBRID
+#define GILLESPY_HYBRID
+#include "events.h"
+#include "model.h"
+#include "ode.h"
+#include "ssa.h"
+#include <cmath>
+#include <vector>
+
+//Hybrid SSA/ODE engine, as the TauHybridSolver partitions species. Continuous species are integrated by the Rosenbrock method of
+//ode.h over the rates of the reactions whose reactants and products are all continuous. Every other reaction fires discretely, at
+//the time the integral of the total propensity of those reactions since the last firing reaches an exponentially distributed
+//target, as in the direct method. Their propensities are kept up to date through the reaction dependency graph. Without
+//continuous species a trajectory is simulated as by the direct method. Species changed by rate rules are always continuous,
+//and assignment rules and events are carried out after every step as by the EventMethod of events.h.
+namespace Gillespy{
+
+  const unsigned char species_discrete = 0;
+  const unsigned char species_continuous = 1;
+  const unsigned char species_dynamic = 2;
+
+  //How each species is represented, as Species.mode, switch_tol and switch_min of the TauHybridSolver. A dynamic species is continuous
+  //while its expected population over the next timestep exceeds switch_min or, if switch_min is 0, while the coefficient of variance
+  //of its change is below switch_tol. Species without settings are dynamic, with switch_tol 0.03 and switch_min 0.
+  struct HybridSettings{
+    std :: vector<unsigned char> modes;
+    std :: vector<double> switch_tol;
+    std :: vector<double> switch_min;
+    double rtol = 1e-6; //error tolerances of the continuous species' integration
+    double atol = 1e-9;
+  };
+
+  template<typename PropensityFunction, typename ODEFunction, typename ModelEvents>
+  class HybridMethod{
+  public:
+    EngineCounters counters;
+
+    HybridMethod(Simulation* simulation, const HybridSettings& settings) :
+      simulation(simulation),
+      model(simulation -> model),
+      profiler(counters, model -> number_reactions),
+      settings(settings),
+      stepper(model, &ode_function, settings.rtol, settings.atol, counters),
+      state(stepper.state),
+      discrete_state(model -> number_species),
+      continuous(model -> number_species),
+      deterministic(model -> number_reactions),
+      propensity_values(model -> number_reactions),
+      produced(model -> number_species),
+      consumed(model -> number_species)
+    {}
+
+    double simulate(unsigned int trajectory_number, Trajectory trajectory){
+      TrajectoryRng rng = simulation_rng(simulation, trajectory_number);
+      propensity_function = static_cast<PropensityFunction*>(simulation -> trajectory_propensity_function(trajectory_number));
+      const unsigned int* point_populations = simulation -> trajectory_populations(trajectory_number);
+      for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	state[species_number] = point_populations ? point_populations[species_number] : model -> species[species_number].initial_population;
+	continuous[species_number] = false;
+      }
+      handler.start(state.data());
+      synchronize_state();
+      record(trajectory_number, 0);
+      double current_time = 0;
+      double step = -1;
+      double integral = 0;
+      double target = rng.exponential();
+      for(unsigned int entry_count = 1; entry_count < simulation -> number_timesteps; entry_count++){
+	double save_time = simulation -> timeline[entry_count];
+	partition(save_time - current_time);
+	if(step < 0 && any_deterministic){
+	  stepper.start();
+	  step = stepper.initial_step(save_time - current_time);
+	}
+	//Until save step reached
+	while(current_time < save_time){
+	  if(interrupted){
+	    return current_time;
+	  }
+	  profiler.start();
+	  double total_propensity = discrete_propensity();
+	  //Steps end at the next save step, delayed event assignment or firing
+	  double step_end = std :: min(save_time, handler.next_time());
+	  //Triggers of models with events are checked after every integration step
+	  if(ModelEvents :: number_events > 0 && any_deterministic){
+	    step_end = std :: min(step_end, current_time + step);
+	  }
+	  double duration = step_end - current_time;
+	  bool fires = false;
+	  if(total_propensity > 0 && (target - integral) / total_propensity < duration){
+	    duration = (target - integral) / total_propensity;
+	    step_end = current_time + duration;
+	    fires = true;
+	  }
+	  if(any_deterministic){
+	    if(!stepper.advance(current_time, duration, step)){
+	      return current_time;
+	    }
+	    synchronize_continuous();
+	  }
+	  //The propensities of discrete reactions reading continuous species changed over the step
+	  integral += duration * (total_propensity + discrete_propensity()) / 2;
+	  current_time = step_end;
+	  profiler.lap(&EngineCounters :: update_seconds);
+	  if(fires || integral >= target){
+	    fire(rng);
+	    integral = 0;
+	    target = rng.exponential();
+	  }
+	  if(handler.update(current_time, state.data())){
+	    synchronize_state();
+	  }
+	}
+	//Save step reached
+	profiler.start();
+	record(trajectory_number, entry_count);
+	profiler.lap(&EngineCounters :: output_seconds);
+      }
+      return current_time;
+    }
+
+  private:
+    //Sets which species are continuous over the next duration, and which reactions are integrated, as TauHybridSolver does
+    void partition(double duration){
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	propensity_values[reaction_number] = propensity_function -> evaluate(reaction_number, discrete_state.data());
+      }
+      counters.propensity_evaluations += model -> number_reactions;
+      std :: vector<double> mean(state.begin(), state.end());
+      std :: vector<double> deviation(model -> number_species, 0);
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	reaction_counts(reaction_number);
+	for(unsigned int species_number : touched){
+	  double weight = duration * propensity_values[reaction_number];
+	  mean[species_number] += weight * (produced[species_number] - consumed[species_number]);
+	  deviation[species_number] += weight * (produced[species_number] * produced[species_number] + consumed[species_number] * consumed[species_number]);
+	}
+      }
+      for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	unsigned char mode = species_number < settings.modes.size() ? settings.modes[species_number] : species_dynamic;
+	bool was_continuous = continuous[species_number];
+	if(mode == species_dynamic){
+	  double switch_tol = species_number < settings.switch_tol.size() ? settings.switch_tol[species_number] : 0.03;
+	  double switch_min = species_number < settings.switch_min.size() ? settings.switch_min[species_number] : 0;
+	  if(switch_min == 0){
+	    double variation = mean[species_number] > 0 ? deviation[species_number] / mean[species_number] : 1;
+	    continuous[species_number] = variation < switch_tol;
+	  }else{
+	    continuous[species_number] = mean[species_number] > switch_min;
+	  }
+	}else{
+	  continuous[species_number] = mode == species_continuous;
+	}
+	//Species turned discrete take the nearest population
+	if(was_continuous && !continuous[species_number]){
+	  state[species_number] = discrete_state[species_number];
+	}
+      }
+      for(unsigned int species_number : ode_function.rate_rule_species){
+	continuous[species_number] = true;
+      }
+      //Reactions are integrated when every reactant and product is continuous, rate rules always are
+      any_deterministic = !ode_function.rate_rule_species.empty();
+      continuous_readers.clear();
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	reaction_counts(reaction_number);
+	bool reads_continuous = false;
+	bool all_continuous = true;
+	for(const unsigned int* species = model -> propensity_species.begin(reaction_number); species != model -> propensity_species.end(reaction_number); species++){
+	  reads_continuous = reads_continuous || continuous[*species];
+	}
+	for(unsigned int species_number : touched){
+	  all_continuous = all_continuous && continuous[species_number];
+	}
+	deterministic[reaction_number] = all_continuous && !touched.empty();
+	any_deterministic = any_deterministic || deterministic[reaction_number];
+	if(!deterministic[reaction_number] && reads_continuous){
+	  continuous_readers.push_back(reaction_number);
+	}
+      }
+      stepper.set_active(deterministic);
+    }
+
+    //Fills touched with the species a reaction consumes or produces, and produced and consumed with their counts
+    void reaction_counts(unsigned int reaction_number){
+      for(unsigned int species_number : touched){
+	produced[species_number] = consumed[species_number] = 0;
+      }
+      touched.clear();
+      for(const SpeciesCount* reactant = model -> reactants.begin(reaction_number); reactant != model -> reactants.end(reaction_number); reactant++){
+	touched.push_back(reactant -> species);
+	consumed[reactant -> species] = reactant -> count;
+	produced[reactant -> species] = reactant -> count;
+      }
+      for(const SpeciesCount* change = model -> species_changes.begin(reaction_number); change != model -> species_changes.end(reaction_number); change++){
+	if(consumed[change -> species] == 0){
+	  touched.push_back(change -> species);
+	}
+	produced[change -> species] = consumed[change -> species] + change -> count;
+      }
+    }
+
+    //Rounds the populations of discrete species after rules or events set them, and updates every propensity
+    void synchronize_state(){
+      for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	discrete_state[species_number] = state[species_number] > 0 ? (unsigned int) std :: lround(state[species_number]) : 0;
+	if(!continuous[species_number]){
+	  state[species_number] = discrete_state[species_number];
+	}
+      }
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	propensity_values[reaction_number] = propensity_function -> evaluate(reaction_number, discrete_state.data());
+      }
+      counters.propensity_evaluations += model -> number_reactions;
+    }
+
+    //Total propensity of the reactions fired discretely
+    double discrete_propensity() const{
+      double total = 0;
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	if(!deterministic[reaction_number]){
+	  total += propensity_values[reaction_number];
+	}
+      }
+      return total;
+    }
+
+    //Rounds the integrated continuous populations for the propensity functions, and updates the propensities reading them
+    void synchronize_continuous(){
+      for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	if(continuous[species_number]){
+	  discrete_state[species_number] = state[species_number] > 0 ? (unsigned int) std :: lround(state[species_number]) : 0;
+	}
+      }
+      for(unsigned int reaction_number : continuous_readers){
+	propensity_values[reaction_number] = propensity_function -> evaluate(reaction_number, discrete_state.data());
+      }
+      counters.propensity_evaluations += continuous_readers.size();
+    }
+
+    //Fires a discrete reaction chosen by its propensity, and updates the propensities it affects through the dependency graph
+    void fire(TrajectoryRng& rng){
+      double total_propensity = discrete_propensity();
+      if(total_propensity <= 0){
+	return;
+      }
+      double cumulative_sum = rng.uniform() * total_propensity;
+      unsigned int chosen = model -> number_reactions;
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	if(deterministic[reaction_number] || propensity_values[reaction_number] <= 0){
+	  continue;
+	}
+	chosen = reaction_number;
+	cumulative_sum -= propensity_values[reaction_number];
+	if(cumulative_sum <= 0){
+	  break;
+	}
+      }
+      for(const SpeciesCount* change = model -> species_changes.begin(chosen); change != model -> species_changes.end(chosen); change++){
+	state[change -> species] += change -> count;
+	discrete_state[change -> species] = state[change -> species] > 0 ? (unsigned int) std :: lround(state[change -> species]) : 0;
+      }
+      unsigned int fan_out = model -> affected_offsets[chosen + 1] - model -> affected_offsets[chosen];
+      for(unsigned int i = model -> affected_offsets[chosen]; i < model -> affected_offsets[chosen + 1]; i++){
+	unsigned int affected = model -> affected_reactions[i];
+	propensity_values[affected] = propensity_function -> evaluate(affected, discrete_state.data());
+      }
+      counters.events++;
+      counters.propensity_evaluations += fan_out;
+      profiler.fired(chosen, 1, fan_out);
+    }
+
+    void record(unsigned int trajectory_number, unsigned int timestep){
+      double* row = &(simulation -> concentrations[((size_t) trajectory_number * simulation -> number_timesteps + timestep) * simulation -> number_observed]);
+      for(unsigned int column = 0; column < simulation -> number_observed; column++){
+	row[column] = state[simulation -> observed(column)];
+      }
+    }
+
+    Simulation* simulation;
+    Model* model;
+    EngineProfiler profiler;
+    PropensityFunction* propensity_function;
+    ODEFunction ode_function;
+    EventHandler<ModelEvents> handler;
+    HybridSettings settings;
+    RosenbrockStepper<ODEFunction> stepper;
+    //Populations of every species, real valued for continuous species, and the stepper's state
+    std :: vector<double>& state;
+    //Populations rounded to the nearest count for the propensity functions
+    std :: vector<unsigned int> discrete_state;
+    std :: vector<unsigned char> continuous;
+    std :: vector<unsigned char> deterministic;
+    //Whether any reactions or rate rules are integrated
+    bool any_deterministic = false;
+    //Discrete reactions whose propensities read continuous species
+    std :: vector<unsigned int> continuous_readers;
+    //Propensities of every reaction, kept up to date for discrete reactions
+    std :: vector<double> propensity_values;
+    //Scratch space of reaction_counts
+    std :: vector<unsigned int> touched;
+    std :: vector<int> produced;
+    std :: vector<int> consumed;
+  };
+
+  //Hybrid SSA/ODE method, species are partitioned into discrete and continuous sets at every timestep by settings
+  template<typename PropensityFunction, typename ODEFunction, typename ModelEvents>
+  void hybrid_solver(Simulation* simulation, const HybridSettings& settings){
+    simulate_trajectories<HybridMethod<PropensityFunction, ODEFunction, ModelEvents>>(simulation, settings);
+  }//end hybrid_solver
+}
+#endif
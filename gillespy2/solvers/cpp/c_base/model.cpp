@@ -1,10 +1,25 @@
 #include "model.h"
+#include "statistics.h"
+#include "rng.h"//Included for the size of checkpointed generators
+#include <algorithm>
+#include <cerrno>//Included for reporting mapping errors
+#include <cstdlib>//Included for aligned arena storage
+#include <cstring>
+#include <fstream>//Included for reading peak memory use on Linux
+#include <new>//Included for reporting failed arena allocations
+#ifndef _WIN32
+#include <fcntl.h>//Included for memory mapped results
+#include <sys/mman.h>
+#include <sys/resource.h>//Included for peak memory use of benchmarks
+#include <unistd.h>
+#endif
 
 namespace Gillespy{
   
   Model :: Model(std :: vector<std :: string> species_names, std :: vector<unsigned int> species_populations, std :: vector<std :: string> reaction_names):
     number_species(species_names.size()),
-    number_reactions(reaction_names.size())
+    number_reactions(reaction_names.size()),
+    reaction_names(reaction_names)
   {
     species = std :: make_unique<Species[]>(number_species);
     for(unsigned int i = 0; i < number_species; i++){
@@ -12,69 +27,269 @@ namespace Gillespy{
       species[i].initial_population = species_populations[i];
       species[i].name = species_names[i];
     }
-    reactions = std :: make_unique<Reaction[]>(number_reactions);
-    for(unsigned int i = 0; i < number_reactions; i++){
-      reactions[i].name = reaction_names[i];
-      reactions[i].species_change = std :: make_unique<int[]>(number_species);
-      for(unsigned int j = 0; j < number_species; j++){
-	reactions[i].species_change[j] = 0;	
-      }
-      reactions[i].affected_reactions = std :: vector<unsigned int>();
-    }
+  }
+
+  void Model :: build(){
+    species_changes.build(number_reactions);
+    reactants.build(number_reactions);
+    propensity_species.build(number_reactions);
+    rate_species.build(number_reactions);
+    update_affected_reactions();
   }
 
   void Model :: update_affected_reactions(){
-    //Clear affected_reactions for each reaction
-    for(unsigned int i = 0; i < number_reactions; i++){
-      reactions[i].affected_reactions.clear();
-    }   
-    //Check all reactions for common species changes -> affected reactions
+    //Index which reactions read each species, so the graph is built in time linear in the model size
+    std :: vector<unsigned int> reader_offsets(number_species + 1, 0);
+    for(unsigned int r = 0; r < number_reactions; r++){
+      for(const unsigned int* s = propensity_species.begin(r); s != propensity_species.end(r); s++){
+	reader_offsets[*s + 1]++;
+      }
+    }
+    for(unsigned int s = 0; s < number_species; s++){
+      reader_offsets[s + 1] += reader_offsets[s];
+    }
+    std :: vector<unsigned int> readers(reader_offsets[number_species]);
+    std :: vector<unsigned int> reader_fill(reader_offsets.begin(), reader_offsets.end() - 1);
+    for(unsigned int r = 0; r < number_reactions; r++){
+      for(const unsigned int* s = propensity_species.begin(r); s != propensity_species.end(r); s++){
+	readers[reader_fill[*s]++] = r;
+      }
+    }
+    //r2 is affected by r1 when r1 changes a species r2's propensity reads, each r2 is listed once per r1
+    affected_offsets.assign(number_reactions + 1, 0);
+    affected_reactions.clear();
+    std :: vector<unsigned int> last_added(number_reactions, number_reactions);
     for(unsigned int r1 = 0; r1 < number_reactions; r1++){
-      for(unsigned int r2 = 0; r2 < number_reactions; r2++){
-	    for(unsigned int s = 0; s < number_species; s++){
-	        if(reactions[r2].species_change[s] != 0){
-	            reactions[r1].affected_reactions.push_back(r2);
-	        }
-	    }
+      for(const SpeciesCount* change = species_changes.begin(r1); change != species_changes.end(r1); change++){
+	if(change -> count == 0){
+	  continue;
+	}
+	unsigned int s = change -> species;
+	for(unsigned int i = reader_offsets[s]; i < reader_offsets[s + 1]; i++){
+	  unsigned int r2 = readers[i];
+	  if(last_added[r2] != r1){
+	    last_added[r2] = r1;
+	    affected_reactions.push_back(r2);
+	  }
+	}
       }
+      affected_offsets[r1 + 1] = affected_reactions.size();
     }
   }
 
 
-  Simulation :: Simulation(Model* model, unsigned int number_trajectories, unsigned int number_timesteps, double end_time, IPropensityFunction* propensity_function, int random_seed,double current_time) : model(model), end_time(end_time), random_seed(random_seed), number_timesteps(number_timesteps), number_trajectories(number_trajectories), propensity_function(propensity_function){
-    timeline = new double[number_timesteps];
+  Simulation :: Simulation(Model* model, unsigned int number_trajectories, unsigned int number_timesteps, double end_time, IPropensityFunction* propensity_function, int random_seed, const SimulationOptions& options) : model(model), end_time(end_time), current_time(0), random_seed(random_seed), number_timesteps(number_timesteps), number_trajectories(number_trajectories), number_threads(options.number_threads), first_trajectory(0), trajectories_1D(nullptr), propensity_function(propensity_function), output_header(nullptr), statistics(options.statistics), stream(nullptr), profile(false), record_changes(options.record_changes), record_every(options.record_every), save_checkpoints(false), continuous(options.continuous), observed_species(options.observed_species), number_observed(observed_species.empty() ? model -> number_species : observed_species.size()){
+    Arena* arena = options.arena ? options.arena : &own_arena;
+    //Trajectories start on their own cache line after the timeline
+    size_t timeline_size = (sizeof(double) * number_timesteps + Arena :: alignment - 1) / Arena :: alignment * Arena :: alignment;
+    if(statistics || record_changes || record_every || continuous){
+      //Trajectories are simulated into per-thread scratch space and summarized, or recorded as their changes, events or concentrations
+      timeline = static_cast<double*>(arena -> reserve(sizeof(double) * number_timesteps));
+      if(continuous){
+	concentrations.assign(number_trajectories * (size_t) number_timesteps * number_observed, 0);
+      }
+    }else if(options.results_storage){
+      //Lay out header, timeline and trajectories exactly as output_results_binary writes them
+      output_header = static_cast<OutputHeader*>(options.results_storage);
+      *output_header = binary_header();
+      timeline = reinterpret_cast<double*>(output_header + 1);
+      trajectories_1D = reinterpret_cast<unsigned int*>(timeline + number_timesteps);
+    }else{
+      char* storage = static_cast<char*>(arena -> reserve(timeline_size + sizeof(unsigned int) * number_trajectories * (size_t) number_timesteps * number_observed));
+      timeline = reinterpret_cast<double*>(storage);
+      trajectories_1D = reinterpret_cast<unsigned int*>(storage + timeline_size);
+    }
     double timestep_size = end_time/(number_timesteps-1);
     for(unsigned int i = 0; i < number_timesteps; i++){
       timeline[i] = timestep_size * i;
     }
-    unsigned int trajectory_size = number_timesteps * (model -> number_species);
-    trajectories_1D = new unsigned int[number_trajectories * trajectory_size];
-    trajectories = new unsigned int**[number_trajectories];
-    for(unsigned int i = 0; i < number_trajectories; i++){
-      trajectories[i] = new unsigned int*[number_timesteps];
-      for(unsigned int j = 0; j < number_timesteps; j++){
-	trajectories[i][j] = &(trajectories_1D[i * trajectory_size + j *  (model -> number_species)]);
-      }
-    }    
+    if(record_changes){
+      trajectory_changes.resize(number_trajectories);
+      trajectory_timesteps.assign(number_trajectories, 0);
+    }
+    if(record_every){
+      event_times.resize(number_trajectories);
+      event_populations.resize(number_trajectories);
+      events_since_record.assign(number_trajectories, 0);
+    }
   }
 
+  void Simulation :: add_point(const unsigned int* populations, IPropensityFunction* propensity_function){
+    point_populations.insert(point_populations.end(), populations, populations + model -> number_species);
+    point_propensity_functions.push_back(propensity_function);
+  }
 
-  Simulation :: ~Simulation(){
-    delete timeline;
-    delete trajectories_1D;
-    for(unsigned int i = 0; i < number_trajectories; i++){
-      delete trajectories[i];
+  void Simulation :: set_timeline(const std :: vector<double>& times){
+    std :: copy(times.begin(), times.begin() + std :: min<size_t>(times.size(), number_timesteps), timeline);
+  }
+
+  bool read_timeline(const std :: string& path, std :: vector<double>& timeline){
+    std :: ifstream file(path, std :: ios :: binary | std :: ios :: ate);
+    if(!file){
+      std :: cerr << "Could not open timeline " << path << std :: endl;
+      return false;
+    }
+    std :: streamsize size = file.tellg();
+    if(size < (std :: streamsize) (2 * sizeof(double)) || size % sizeof(double) != 0){
+      std :: cerr << "Timeline " << path << " does not hold two or more doubles" << std :: endl;
+      return false;
     }
-    delete trajectories;
+    timeline.resize(size / sizeof(double));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(timeline.data()), size);
+    if(timeline[0] != 0 || !std :: is_sorted(timeline.begin(), timeline.end())){
+      std :: cerr << "Timeline " << path << " is not sorted from 0" << std :: endl;
+      return false;
+    }
+    return true;
+  }
+
+  void Simulation :: enable_profile(){
+    profile = true;
+    trajectory_events.assign(number_trajectories, 0);
+  }
+
+  void Simulation :: enable_checkpoints(){
+    save_checkpoints = true;
+    checkpoints.resize(number_trajectories);
+  }
+
+  bool Simulation :: read_checkpoint(const std :: string& path){
+    std :: ifstream file(path, std :: ios :: binary);
+    if(!file){
+      std :: cerr << "Could not open checkpoint " << path << std :: endl;
+      return false;
+    }
+    CheckpointHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(CheckpointHeader));
+    if(!file || memcmp(header.magic, "GPYK", 4) != 0){
+      std :: cerr << "Checkpoint " << path << " is not a GillesPy2 checkpoint" << std :: endl;
+      return false;
+    }
+    if(header.number_trajectories != number_trajectories || header.number_species != model -> number_species || header.number_reactions != model -> number_reactions || header.rng_size != sizeof(TrajectoryRng)){
+      std :: cerr << "Checkpoint " << path << " was saved by a simulation of " << header.number_trajectories << " trajectories of another model or build" << std :: endl;
+      return false;
+    }
+    //Entry counts index this simulation's timesteps, so they must be spaced as those of the simulation that saved it
+    double spacing = number_timesteps > 1 ? end_time / (number_timesteps - 1) : 0;
+    double saved_spacing = header.number_timesteps > 1 ? header.end_time / (header.number_timesteps - 1) : 0;
+    if(std :: fabs(spacing - saved_spacing) > 1e-9 * std :: max(spacing, saved_spacing)){
+      std :: cerr << "Checkpoint " << path << " was saved by a simulation with timesteps " << saved_spacing << " apart, not " << spacing << std :: endl;
+      return false;
+    }
+    if(header.end_time > end_time){
+      std :: cerr << "Checkpoint " << path << " was saved by a simulation ending at " << header.end_time << ", after " << end_time << std :: endl;
+      return false;
+    }
+    enable_checkpoints();
+    for(TrajectoryCheckpoint& checkpoint : checkpoints){
+      CheckpointEntry entry;
+      file.read(reinterpret_cast<char*>(&entry), sizeof(CheckpointEntry));
+      checkpoint.started = entry.flags & checkpoint_started;
+      checkpoint.time = entry.time;
+      checkpoint.entry_count = entry.entry_count;
+      checkpoint.state.resize(model -> number_species);
+      file.read(reinterpret_cast<char*>(checkpoint.state.data()), sizeof(unsigned int) * checkpoint.state.size());
+      checkpoint.rng.resize(header.rng_size);
+      file.read(reinterpret_cast<char*>(checkpoint.rng.data()), checkpoint.rng.size());
+      checkpoint.firing_times.resize((entry.flags & checkpoint_firing_times) ? model -> number_reactions : 0);
+      file.read(reinterpret_cast<char*>(checkpoint.firing_times.data()), sizeof(double) * checkpoint.firing_times.size());
+    }
+    if(!file){
+      std :: cerr << "Checkpoint " << path << " is truncated" << std :: endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool Simulation :: write_checkpoint(const std :: string& path) const{
+    std :: ofstream file(path, std :: ios :: binary | std :: ios :: trunc);
+    CheckpointHeader header = {{'G', 'P', 'Y', 'K'}, number_trajectories, model -> number_species, model -> number_reactions, sizeof(TrajectoryRng), number_timesteps, end_time};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(CheckpointHeader));
+    std :: vector<unsigned char> unused_rng(sizeof(TrajectoryRng), 0);
+    std :: vector<unsigned int> unused_state(model -> number_species, 0);
+    for(const TrajectoryCheckpoint& checkpoint : checkpoints){
+      CheckpointEntry entry = {checkpoint.time, checkpoint.entry_count, (checkpoint.started ? checkpoint_started : 0) | (checkpoint.firing_times.empty() ? 0 : checkpoint_firing_times)};
+      file.write(reinterpret_cast<const char*>(&entry), sizeof(CheckpointEntry));
+      const std :: vector<unsigned int>& state = checkpoint.started ? checkpoint.state : unused_state;
+      file.write(reinterpret_cast<const char*>(state.data()), sizeof(unsigned int) * state.size());
+      const std :: vector<unsigned char>& rng = checkpoint.started ? checkpoint.rng : unused_rng;
+      file.write(reinterpret_cast<const char*>(rng.data()), rng.size());
+      file.write(reinterpret_cast<const char*>(checkpoint.firing_times.data()), sizeof(double) * checkpoint.firing_times.size());
+    }
+    file.flush();
+    if(!file){
+      std :: cerr << "Could not write checkpoint " << path << std :: endl;
+      return false;
+    }
+    return true;
+  }
+
+  size_t Simulation :: binary_output_size(unsigned int number_trajectories, unsigned int number_timesteps, unsigned int number_species){
+    return sizeof(OutputHeader) + sizeof(double) * number_timesteps + sizeof(unsigned int) * number_trajectories * number_timesteps * (size_t) number_species;
+  }
+
+
+  void* Arena :: reserve(size_t size){
+    if(size <= this -> size){
+      return data;
+    }
+    release();
+#ifdef _WIN32
+    data = _aligned_malloc(size, alignment);
+#else
+#ifdef MADV_HUGEPAGE
+    //Arenas of at least a huge page are mapped whole huge pages at a time, so the kernel may back them with huge pages
+    const size_t huge_page_size = 2 << 20;
+    if(size >= huge_page_size){
+      size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+      void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(mapping != MAP_FAILED){
+	madvise(mapping, size, MADV_HUGEPAGE);
+	data = mapping;
+	mapped = true;
+      }
+    }
+#endif
+    if(!data && posix_memalign(&data, alignment, size) != 0){
+      data = nullptr;
+    }
+#endif
+    if(!data){
+      throw std :: bad_alloc();
+    }
+    this -> size = size;
+    return data;
+  }
+
+  void Arena :: release(){
+    if(!data){
+      return;
+    }
+#ifdef _WIN32
+    _aligned_free(data);
+#else
+    if(mapped){
+      munmap(data, size);
+    }else{
+      free(data);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+    mapped = false;
+  }
+
+  Arena :: ~Arena(){
+    release();
   }
 
-  
   std :: ostream& operator<<(std :: ostream& os, const Simulation& simulation){
     for(unsigned int i = 0; i < simulation.number_timesteps; i++){
       os << simulation.timeline[i] << " ";
       for(unsigned int trajectory = 0; trajectory < simulation.number_trajectories; trajectory++){
-	for(unsigned int j = 0; j < simulation.model -> number_species; j++){
-	  os << simulation.trajectories[trajectory][i][j] <<  " ";
+	for(unsigned int j = 0; j < simulation.number_observed; j++){
+	  os << simulation.trajectory(trajectory)[i][j] <<  " ";
 	}
       }
       os << "\n";
@@ -86,12 +301,209 @@ void Simulation :: output_results_buffer(std::ostream& os){
     for (int i = 0 ; i < number_trajectories; i++){
         for (int j = 0; j<number_timesteps;j++){
             os<<timeline[j]<<',';
-            for (int k = 0; k<model->number_species; k++){
-                os<<trajectories[i][j][k]<<',';
+            for (int k = 0; k<number_observed; k++){
+                os<<trajectory(i)[j][k]<<',';
                 }
             }
          }
     os<<(int)current_time;
     }
 
+  OutputHeader Simulation :: binary_header(){
+    OutputHeader header = {{'G', 'P', 'Y', '2'}, sizeof(OutputHeader), number_trajectories, number_timesteps, number_observed, 0, end_time, current_time};
+    return header;
+  }
+
+  //Writes the header, followed by the profile if enabled, and the timeline
+  void Simulation :: output_header_binary(std :: ostream& os, const char* magic){
+    OutputHeader header = binary_header();
+    memcpy(header.magic, magic, 4);
+    if(profile){
+      header.header_size += profile_size();
+    }
+    os.write(reinterpret_cast<const char*>(&header), sizeof(OutputHeader));
+    if(profile){
+      output_profile(os);
+    }
+    os.write(reinterpret_cast<const char*>(timeline), sizeof(double) * number_timesteps);
+  }
+
+  void Simulation :: output_results_binary(std :: ostream& os){
+    output_header_binary(os, "GPY2");
+    os.write(reinterpret_cast<const char*>(trajectories_1D), sizeof(unsigned int) * number_trajectories * number_timesteps * (size_t) number_observed);
+    os.flush();
+  }
+
+  void Simulation :: output_concentrations_binary(std :: ostream& os){
+    output_header_binary(os, "GPYF");
+    os.write(reinterpret_cast<const char*>(concentrations.data()), sizeof(double) * concentrations.size());
+    os.flush();
+  }
+
+  void Simulation :: output_changes_binary(std :: ostream& os){
+    output_header_binary(os, "GPYC");
+    os.write(reinterpret_cast<const char*>(trajectory_timesteps.data()), sizeof(uint32_t) * number_trajectories);
+    std :: vector<uint64_t> counts;
+    for(const std :: vector<PopulationChange>& changes : trajectory_changes){
+      counts.push_back(changes.size());
+    }
+    os.write(reinterpret_cast<const char*>(counts.data()), sizeof(uint64_t) * number_trajectories);
+    for(const std :: vector<PopulationChange>& changes : trajectory_changes){
+      os.write(reinterpret_cast<const char*>(changes.data()), sizeof(PopulationChange) * changes.size());
+    }
+    os.flush();
+  }
+
+  size_t Simulation :: profile_size() const{
+    return sizeof(ProfileHeader) + sizeof(uint64_t) * ((size_t) model -> number_reactions + number_trajectories);
+  }
+
+  void Simulation :: output_profile(std :: ostream& os){
+    ProfileHeader header = {{'G', 'P', 'Y', 'P'}, model -> number_reactions, counters.profiled, 0, counters.events, counters.propensity_evaluations, counters.fan_out, counters.selection_seconds, counters.update_seconds, counters.output_seconds};
+    os.write(reinterpret_cast<const char*>(&header), sizeof(ProfileHeader));
+    std :: vector<uint64_t> firings(model -> number_reactions, 0);
+    std :: copy(counters.firings.begin(), counters.firings.begin() + std :: min(counters.firings.size(), firings.size()), firings.begin());
+    os.write(reinterpret_cast<const char*>(firings.data()), sizeof(uint64_t) * firings.size());
+    std :: vector<uint64_t> events(trajectory_events.begin(), trajectory_events.end());
+    events.resize(number_trajectories, 0);
+    os.write(reinterpret_cast<const char*>(events.data()), sizeof(uint64_t) * events.size());
+  }
+
+  void Simulation :: output_events_binary(std :: ostream& os){
+    output_header_binary(os, "GPYE");
+    std :: vector<uint64_t> counts;
+    for(const std :: vector<double>& times : event_times){
+      counts.push_back(times.size());
+    }
+    os.write(reinterpret_cast<const char*>(counts.data()), sizeof(uint64_t) * number_trajectories);
+    for(unsigned int trajectory = 0; trajectory < number_trajectories; trajectory++){
+      os.write(reinterpret_cast<const char*>(event_times[trajectory].data()), sizeof(double) * event_times[trajectory].size());
+      os.write(reinterpret_cast<const char*>(event_populations[trajectory].data()), sizeof(unsigned int) * event_populations[trajectory].size());
+    }
+    os.flush();
+  }
+
+  void Simulation :: output_statistics_binary(std :: ostream& os, const std :: vector<double>& quantiles){
+    OutputHeader header = binary_header();
+    memcpy(header.magic, "GPYS", 4);
+    header.number_trajectories = statistics -> count;
+    os.write(reinterpret_cast<const char*>(&header), sizeof(OutputHeader));
+    os.write(reinterpret_cast<const char*>(timeline), sizeof(double) * number_timesteps);
+    unsigned int number_entries = number_timesteps * number_observed;
+    std :: vector<double> block(number_entries);
+    auto write_block = [&](auto entry_value){
+      for(unsigned int entry = 0; entry < number_entries; entry++){
+	block[entry] = entry_value(entry);
+      }
+      os.write(reinterpret_cast<const char*>(block.data()), sizeof(double) * number_entries);
+    };
+    write_block([&](unsigned int entry){ return statistics -> mean(entry); });
+    write_block([&](unsigned int entry){ return statistics -> variance(entry); });
+    for(double probability : quantiles){
+      write_block([&](unsigned int entry){ return statistics -> quantile(entry, probability); });
+    }
+    std :: vector<uint64_t> sums(number_entries);
+    std :: vector<uint64_t> squared_sums(2 * (size_t) number_entries);
+    for(unsigned int entry = 0; entry < number_entries; entry++){
+      sums[entry] = statistics -> sum(entry);
+      unsigned __int128 squared_sum = statistics -> squared_sum(entry);
+      squared_sums[2 * (size_t) entry] = (uint64_t) squared_sum;
+      squared_sums[2 * (size_t) entry + 1] = (uint64_t) (squared_sum >> 64);
+    }
+    os.write(reinterpret_cast<const char*>(sums.data()), sizeof(uint64_t) * sums.size());
+    os.write(reinterpret_cast<const char*>(squared_sums.data()), sizeof(uint64_t) * squared_sums.size());
+    os.flush();
+  }
+
+  void Simulation :: output_benchmark(std :: ostream& os, double seconds){
+    long peak_resident_kb = 0;
+#if defined(__linux__)
+    //ru_maxrss on Linux keeps the peak of the process image replaced by exec, VmHWM is this program's alone
+    std :: ifstream status("/proc/self/status");
+    for(std :: string line; std :: getline(status, line);){
+      if(line.compare(0, 6, "VmHWM:") == 0){
+	peak_resident_kb = std :: stol(line.substr(6));
+      }
+    }
+#elif !defined(_WIN32)
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0){
+#ifdef __APPLE__
+      peak_resident_kb = usage.ru_maxrss / 1024; //bytes on macOS
+#else
+      peak_resident_kb = usage.ru_maxrss;
+#endif
+    }
+#endif
+    os << "trajectories " << number_trajectories << "\n";
+    os << "threads " << number_threads << "\n";
+    os << "events " << counters.events << "\n";
+    os << "propensity_evaluations " << counters.propensity_evaluations << "\n";
+    os << "seconds " << seconds << "\n";
+    os << "peak_resident_kb " << peak_resident_kb << std :: endl;
+  }
+
+  void TrajectoryStream :: start(Simulation& simulation){
+    simulation.output_header_binary(os, "GPYT");
+    os.flush();
+  }
+
+  void TrajectoryStream :: write(const Simulation& simulation, unsigned int trajectory_number, const unsigned int* populations){
+    std :: lock_guard<std :: mutex> lock(mutex);
+    uint32_t number = trajectory_number;
+    os.write(reinterpret_cast<const char*>(&number), sizeof(uint32_t));
+    os.write(reinterpret_cast<const char*>(populations), sizeof(unsigned int) * simulation.number_timesteps * (size_t) simulation.number_observed);
+    os.flush();
+    finished++;
+    if(progress){
+      std :: cerr << "progress " << finished << " " << simulation.number_trajectories << std :: endl;
+    }
+  }
+
+  void TrajectoryStream :: finish(const Simulation& simulation){
+    uint32_t number = end_of_stream;
+    os.write(reinterpret_cast<const char*>(&number), sizeof(uint32_t));
+    os.write(reinterpret_cast<const char*>(&simulation.current_time), sizeof(double));
+    os.flush();
+  }
+
+  //Results were written in place, only the stop time is left to record
+  void Simulation :: output_results_mapped(){
+    if(output_header){
+      output_header -> current_time = current_time;
+    }
+  }
+
+  MappedFile :: MappedFile(const std :: string& path, bool shared_memory, size_t size) : data(nullptr), size(size){
+#ifdef _WIN32
+    std :: cerr << "Memory mapped results are not supported on this platform" << std :: endl;
+#else
+    int fd = shared_memory ? shm_open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600) : open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0){
+      std :: cerr << "Could not open results file " << path << ": " << strerror(errno) << std :: endl;
+      return;
+    }
+    if(ftruncate(fd, size) != 0){
+      std :: cerr << "Could not resize results file " << path << ": " << strerror(errno) << std :: endl;
+      close(fd);
+      return;
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    //The mapping stays valid after its descriptor is closed
+    close(fd);
+    if(mapped == MAP_FAILED){
+      std :: cerr << "Could not map results file " << path << ": " << strerror(errno) << std :: endl;
+      return;
+    }
+    data = mapped;
+#endif
+  }
+
+  MappedFile :: ~MappedFile(){
+#ifndef _WIN32
+    if(data){
+      munmap(data, size);
+    }
+#endif
+  }
 }
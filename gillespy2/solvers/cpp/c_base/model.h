@@ -1,10 +1,14 @@
 #ifndef GILLESPY_MODEL
 #define GILLESPY_MODEL
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <utility>
 
 namespace Gillespy{
 
@@ -15,22 +19,77 @@ namespace Gillespy{
     unsigned int initial_population;
   };
   
-  struct Reaction{
-    unsigned int id; //useful for propensity function id associated
-    std :: string name;
-    std :: unique_ptr<int[]> species_change; //list of changes to species with this reaction firing
-    std :: vector<unsigned int> affected_reactions; //list of which reactions have propensities that would change with this reaction firing 
+  //A species and a signed count of it, entries of a model's stoichiometry and reactant tables
+  struct SpeciesCount{
+    unsigned int species;
+    int count;
   };
-  
+
+  //Sparse table with a row of entries per reaction, in CSR form so all rows share one contiguous allocation.
+  //Rows may be added to in any order, build must be called before they are read.
+  template<typename Entry>
+  class ReactionTable{
+  public:
+    void add(unsigned int reaction_number, const Entry& entry){
+      staged.emplace_back(reaction_number, entry);
+    }
+
+    //Lays out the added entries by reaction, keeping the order they were added in within each row
+    void build(unsigned int number_reactions){
+      offsets.assign(number_reactions + 1, 0);
+      for(auto& staged_entry : staged){
+	offsets[staged_entry.first + 1]++;
+      }
+      for(unsigned int r = 0; r < number_reactions; r++){
+	offsets[r + 1] += offsets[r];
+      }
+      std :: vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+      entries.resize(staged.size());
+      for(auto& staged_entry : staged){
+	entries[fill[staged_entry.first]++] = staged_entry.second;
+      }
+      staged.clear();
+      staged.shrink_to_fit();
+    }
+
+    const Entry* begin(unsigned int reaction_number) const{
+      return entries.data() + offsets[reaction_number];
+    }
+
+    const Entry* end(unsigned int reaction_number) const{
+      return entries.data() + offsets[reaction_number + 1];
+    }
+
+  private:
+    std :: vector<unsigned int> offsets;
+    std :: vector<Entry> entries;
+    std :: vector<std :: pair<unsigned int, Entry>> staged;
+  };
+
   //Represents a model of reactions and species
   struct Model{
-      void update_affected_reactions();
-
     unsigned int number_species;
     std :: unique_ptr<Species[]> species;
     unsigned int number_reactions;
-    std :: unique_ptr<Reaction[]> reactions;
+    std :: vector<std :: string> reaction_names;
+    //Change to each species' population when a reaction fires, nonzero changes only
+    ReactionTable<SpeciesCount> species_changes;
+    //Population of each species consumed when a reaction fires
+    ReactionTable<SpeciesCount> reactants;
+    //Species each reaction's propensity function reads
+    ReactionTable<unsigned int> propensity_species;
+    //Species each reaction's deterministic rate reads, the columns of its partial derivatives in the ode engine's Jacobian
+    ReactionTable<unsigned int> rate_species;
+    //Reaction dependency graph in CSR form:
+    //reactions whose propensities change when reaction r fires are affected_reactions[affected_offsets[r] .. affected_offsets[r+1])
+    std :: vector<unsigned int> affected_offsets;
+    std :: vector<unsigned int> affected_reactions;
     Model(std :: vector<std :: string> species_names, std :: vector<unsigned int> species_populations, std :: vector<std :: string> reaction_names);
+    //Lays out the reaction tables and builds the dependency graph, call once every reaction is added
+    void build();
+
+  private:
+    void update_affected_reactions();
   };
   
   //Interface class to represent container for propensity functions
@@ -41,10 +100,191 @@ namespace Gillespy{
   };
 
   
+  class TrajectoryStatistics;
+
+  //Header written ahead of binary results, followed by the timeline (double[number_timesteps])
+  //and trajectories_1D (uint32[number_trajectories * number_timesteps * number_species])
+  struct OutputHeader{
+    char magic[4]; //always "GPY2"
+    uint32_t header_size; //bytes from the start of the header to the timeline
+    uint32_t number_trajectories;
+    uint32_t number_timesteps;
+    uint32_t number_species;
+    uint32_t status; //0, or nonzero when a simulation server could not run the request
+    double end_time;
+    double current_time; //time the simulation stopped at, meaningful when interrupted
+  };
+
+  //File or POSIX shared memory segment mapped into memory, used as the backing store for binary results
+  struct MappedFile{
+    void* data;
+    size_t size;
+    MappedFile(const std :: string& path, bool shared_memory, size_t size);
+    ~MappedFile();
+  };
+
+  struct Simulation;
+
+  //Writes trajectories as soon as they are simulated, for simulations run with -stream. start writes the header, with magic "GPYT",
+  //and the timeline. Each trajectory is then written once it finishes, in the order they finish, as its uint32 trajectory number
+  //followed by its uint32[number_timesteps * number_species] populations, trajectories cut short by an interrupt are left out.
+  //finish writes end_of_stream in place of a trajectory number, followed by the double time the simulation stopped at.
+  //With progress, a line "progress <finished> <number_trajectories>" is also written to std :: cerr as each trajectory finishes.
+  class TrajectoryStream{
+  public:
+    static const uint32_t end_of_stream = 0xFFFFFFFF;
+    TrajectoryStream(std :: ostream& os, bool progress) : os(os), progress(progress), finished(0){}
+    void start(Simulation& simulation);
+    //Called by the thread simulating the trajectory, with its stored populations
+    void write(const Simulation& simulation, unsigned int trajectory_number, const unsigned int* populations);
+    void finish(const Simulation& simulation);
+  private:
+    std :: ostream& os;
+    bool progress;
+    unsigned int finished;
+    std :: mutex mutex;
+  };
+
+  //Profile written after OutputHeader by simulations run with -profile and counted in its header_size,
+  //followed by uint64[number_reactions] firings of each reaction and uint64[number_trajectories] events of each trajectory
+  struct ProfileHeader{
+    char magic[4]; //always "GPYP"
+    uint32_t number_reactions;
+    uint32_t profiled; //1 if the engine was built with GILLESPY_PROFILE, else only events and evaluations are counted
+    uint32_t reserved;
+    uint64_t events;
+    uint64_t propensity_evaluations;
+    uint64_t fan_out;
+    double selection_seconds;
+    double update_seconds;
+    double output_seconds;
+  };
+
+  //A species' population from a timestep on. Simulations run with -changes record each trajectory as the populations
+  //that changed at each timestep instead of every population at every timestep.
+  struct PopulationChange{
+    uint32_t timestep;
+    uint32_t species;
+    uint32_t population;
+  };
+
+  //Reads a timeline of sorted doubles starting at 0 from a binary file, returns false with the reason on std :: cerr if it is not one
+  bool read_timeline(const std :: string& path, std :: vector<double>& timeline);
+
+  //Where a trajectory left off, saved by simulations run with -checkpoint and restored by -resume. Engines save the start of the
+  //step that passed the end time or that an interrupt stopped before, so a resumed trajectory retakes that step with the same draws.
+  struct TrajectoryCheckpoint{
+    bool started = false; //false for trajectories an interrupt stopped before they began, they are resumed from the start
+    double time = 0;
+    unsigned int entry_count = 0; //timesteps recorded before time
+    std :: vector<unsigned int> state;
+    std :: vector<unsigned char> rng; //bytes of the trajectory's TrajectoryRng
+    std :: vector<double> firing_times; //absolute firing time of each reaction, saved by the next reaction method only
+  };
+
+  //Header of a checkpoint file, followed for each trajectory by a CheckpointEntry, uint32[number_species] state,
+  //rng_size bytes of generator state and, if flagged, double[number_reactions] firing times
+  struct CheckpointHeader{
+    char magic[4]; //always "GPYK"
+    uint32_t number_trajectories;
+    uint32_t number_species;
+    uint32_t number_reactions;
+    uint32_t rng_size;
+    uint32_t number_timesteps; //timesteps from 0 to end_time of the simulation that saved it, which set their spacing
+    double end_time; //end time of the simulation that saved it
+  };
+
+  struct CheckpointEntry{
+    double time;
+    uint32_t entry_count;
+    uint32_t flags; //checkpoint_started | checkpoint_firing_times
+  };
+  const uint32_t checkpoint_started = 1;
+  const uint32_t checkpoint_firing_times = 2;
+
+  //Work done by the engines. An event is one reaction firing, or one leap for tau-leaping.
+  //Only engines built with GILLESPY_PROFILE keep the counters after events and propensity_evaluations.
+  struct EngineCounters{
+    unsigned long long events = 0;
+    unsigned long long propensity_evaluations = 0;
+    bool profiled = false;
+    unsigned long long fan_out = 0; //propensities re-evaluated through the dependency graph after firings
+    std :: vector<unsigned long long> firings; //times each reaction fired
+    double selection_seconds = 0; //choosing the next reaction and its time, or the next leap
+    double update_seconds = 0; //firing reactions and updating propensities
+    double output_seconds = 0; //copying the state into the trajectory
+
+    void add(const EngineCounters& other){
+      events += other.events;
+      propensity_evaluations += other.propensity_evaluations;
+      profiled = profiled || other.profiled;
+      fan_out += other.fan_out;
+      if(firings.size() < other.firings.size()){
+	firings.resize(other.firings.size(), 0);
+      }
+      for(unsigned int i = 0; i < other.firings.size(); i++){
+	firings[i] += other.firings[i];
+      }
+      selection_seconds += other.selection_seconds;
+      update_seconds += other.update_seconds;
+      output_seconds += other.output_seconds;
+    }
+  };
+
+  //Aligned storage a Simulation lays out its timeline and trajectories in. Storage is only reallocated when more is reserved than
+  //the arena holds, so one arena may back the simulations of repeated requests. Large arenas are mapped with huge pages where available.
+  class Arena{
+  public:
+    static const size_t alignment = 64;
+    Arena() : data(nullptr), size(0), mapped(false) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+    //Returns at least size bytes aligned to alignment, throws std :: bad_alloc if they can not be allocated. Storage reserved earlier is invalidated.
+    void* reserve(size_t size);
+    size_t capacity() const{
+      return size;
+    }
+  private:
+    void* data;
+    size_t size;
+    bool mapped;
+    void release();
+  };
+
+  //A trajectory's populations, one row of number_observed per timestep, stride apart.
+  //A stride of 0 makes every timestep the same row.
+  struct Trajectory{
+    unsigned int* populations;
+    size_t stride;
+    unsigned int* operator[](unsigned int timestep) const{
+      return populations + timestep * stride;
+    }
+  };
+
+  //How a Simulation stores and outputs its trajectories, beyond its model, size and propensity function.
+  //Every option defaults to a plain run, storing every species of every trajectory in the simulation's own arena.
+  struct SimulationOptions{
+    unsigned int number_threads = 1; //number of threads trajectories are simulated on
+    //Storage holding binary_output_size bytes, laid out as the binary output, or nullptr
+    void* results_storage = nullptr;
+    //Summary the trajectories are streamed into instead of being stored, or nullptr
+    TrajectoryStatistics* statistics = nullptr;
+    //Record only the populations each trajectory changes, see Simulation :: record_changes
+    bool record_changes = false;
+    //Species stored and output for each timestep, in order, or empty for every species
+    std :: vector<unsigned int> observed_species;
+    //Record each trajectory after every record_every-th event instead of at the timeline, or 0
+    unsigned int record_every = 0;
+    //Arena trajectories not written to results_storage are laid out in, which must outlive the simulation, or nullptr
+    Arena* arena = nullptr;
+    //Record real valued populations into concentrations, for the ode and hybrid engines
+    bool continuous = false;
+  };
+
   //Represents simulation return data
   struct Simulation{
     Model* model;
-    ~Simulation();
 
     double* timeline;
     double end_time;
@@ -52,12 +292,135 @@ namespace Gillespy{
     int random_seed;
     unsigned int number_timesteps;
     unsigned int number_trajectories;
+    unsigned int number_threads; //number of threads trajectories are simulated on
+    //Number of the first trajectory within an ensemble split between simulations, 0 unless set with -first_trajectory.
+    //Trajectories draw from the random stream of their number within the ensemble, see simulation_rng.
+    unsigned int first_trajectory;
+    //Populations of every trajectory, number_timesteps rows of number_observed each, or nullptr if trajectories are not stored
     unsigned int* trajectories_1D;
-    unsigned int*** trajectories;
     IPropensityFunction *propensity_function;
-    Simulation(Model* model, unsigned int number_trajectories, unsigned int number_timesteps, double end_time, IPropensityFunction* propensity_function, int random_seed, double current_time);
+    //Parameter sweep points, trajectories are split evenly between them in order of add_point.
+    //Each point starts from its own populations and is simulated with its own propensity function,
+    //without points every trajectory uses the model's populations and propensity_function
+    std :: vector<unsigned int> point_populations;
+    std :: vector<IPropensityFunction*> point_propensity_functions;
+    OutputHeader* output_header; //header of the results storage, if results are written in place
+    //Summary the trajectories are streamed into instead of being stored, if given
+    TrajectoryStatistics* statistics;
+    //Output each stored trajectory is written to as soon as it finishes, if given
+    TrajectoryStream* stream;
+    //Summed over every thread's engine once all trajectories are done
+    EngineCounters counters;
+    //Set by enable_profile, binary output then carries a ProfileHeader and trajectory_events holds each trajectory's events
+    bool profile;
+    std :: vector<unsigned long long> trajectory_events;
+    //With record_changes, trajectories are not stored densely. trajectory_changes holds the populations each trajectory
+    //changed to at each timestep, and trajectory_timesteps the number of timesteps it reached before finishing or being interrupted.
+    bool record_changes;
+    std :: vector<std :: vector<PopulationChange>> trajectory_changes;
+    std :: vector<uint32_t> trajectory_timesteps;
+    //With record_every, trajectories are not stored at the timeline. Each is recorded at its start and after every record_every-th event,
+    //event_times and event_populations hold the times and observed populations it was recorded with.
+    unsigned int record_every;
+    std :: vector<std :: vector<double>> event_times;
+    std :: vector<std :: vector<unsigned int>> event_populations;
+    std :: vector<unsigned int> events_since_record;
+    //Set by enable_checkpoints, each trajectory's engine then saves where it left off into checkpoints.
+    //Trajectories with a started checkpoint when they are simulated are resumed from it.
+    bool save_checkpoints;
+    std :: vector<TrajectoryCheckpoint> checkpoints;
+    //With continuous, trajectories are not stored in trajectories_1D. The ode and hybrid engines record real valued populations
+    //into concentrations instead, laid out as trajectories_1D.
+    bool continuous;
+    std :: vector<double> concentrations;
+    //Species stored and output for each timestep, in order, or empty for every species.
+    //Engines simulate the full state, trajectories and results hold number_observed populations per timestep.
+    std :: vector<unsigned int> observed_species;
+    unsigned int number_observed;
+    //If options.results_storage is given, the results are laid out in it as the binary output.
+    //If options.statistics is given, trajectories are not stored and only their summary can be output.
+    //Otherwise the timeline and trajectories are laid out in options.arena if given, or else in the simulation's own.
+    //Continuous simulations only lay out the timeline, results_storage is not used.
+    Simulation(Model* model, unsigned int number_trajectories, unsigned int number_timesteps, double end_time, IPropensityFunction* propensity_function, int random_seed, const SimulationOptions& options = SimulationOptions());
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+    //Rows of a stored trajectory in trajectories_1D
+    Trajectory trajectory(unsigned int trajectory_number) const{
+      return {trajectories_1D + trajectory_number * (size_t) number_timesteps * number_observed, number_observed};
+    }
+    void add_point(const unsigned int* populations, IPropensityFunction* propensity_function);
+    //Replaces the uniform timeline with number_timesteps sorted times starting at 0, as read by read_timeline
+    void set_timeline(const std :: vector<double>& times);
+    void enable_profile();
+    void enable_checkpoints();
+    //Resumes trajectories from a checkpoint file saved by a simulation of the same model and number of trajectories,
+    //returns false with the reason on std :: cerr if it can not be read. Enables checkpoints.
+    bool read_checkpoint(const std :: string& path);
+    bool write_checkpoint(const std :: string& path) const;
+    //Checkpoint the trajectory is resumed from, nullptr if it starts from its initial populations
+    const TrajectoryCheckpoint* resumed_checkpoint(unsigned int trajectory_number) const{
+      if(checkpoints.empty() || !checkpoints[trajectory_number].started){
+	return nullptr;
+      }
+      return &checkpoints[trajectory_number];
+    }
+    //Populations the trajectory starts from, nullptr for the model's initial populations
+    const unsigned int* trajectory_populations(unsigned int trajectory_number) const{
+      if(point_propensity_functions.empty()){
+	return nullptr;
+      }
+      return &point_populations[trajectory_point(trajectory_number) * model -> number_species];
+    }
+    IPropensityFunction* trajectory_propensity_function(unsigned int trajectory_number) const{
+      if(point_propensity_functions.empty()){
+	return propensity_function;
+      }
+      return point_propensity_functions[trajectory_point(trajectory_number)];
+    }
+    unsigned int trajectory_point(unsigned int trajectory_number) const{
+      return trajectory_number / (number_trajectories / point_propensity_functions.size());
+    }
+    //Species output in column of each timestep
+    unsigned int observed(unsigned int column) const{
+      return observed_species.empty() ? column : observed_species[column];
+    }
+    //Copies the observed populations of a state into a timestep
+    void observe(unsigned int* timestep, const unsigned int* state) const{
+      if(observed_species.empty()){
+	std :: copy(state, state + number_observed, timestep);
+	return;
+      }
+      for(unsigned int column = 0; column < number_observed; column++){
+	timestep[column] = state[observed_species[column]];
+      }
+    }
+    static size_t binary_output_size(unsigned int number_trajectories, unsigned int number_timesteps, unsigned int number_species);
     friend std :: ostream& operator<<(std :: ostream& os, const Simulation& simulation);
     void output_results_buffer(std :: ostream& os);
+    void output_results_binary(std :: ostream& os);
+    //Header, with magic "GPYC", then the timeline, uint32[number_trajectories] timesteps each trajectory reached,
+    //uint64[number_trajectories] number of changes of each trajectory, then every trajectory's PopulationChanges in turn
+    void output_changes_binary(std :: ostream& os);
+    //Header, with magic "GPYE", then the timeline, uint64[number_trajectories] number of records of each trajectory, then for each
+    //trajectory in turn double[records] times followed by uint32[records * number_observed] populations
+    void output_events_binary(std :: ostream& os);
+    void output_results_mapped();
+    //Header, with magic "GPYF", then the timeline and concentrations, laid out as output_results_binary lays out trajectories_1D
+    void output_concentrations_binary(std :: ostream& os);
+    //Header, with magic "GPYS" and number_trajectories counting the trajectories summarized, then the timeline,
+    //then double[number_timesteps * number_species] blocks of the mean, variance and each quantile in turn, then the exact
+    //uint64[number_timesteps * number_species] sums and uint64[number_timesteps * number_species][2] low and high words of
+    //the squared sums the statistics of shards are reduced by
+    void output_statistics_binary(std :: ostream& os, const std :: vector<double>& quantiles);
+    //Lines of "name value" reporting the counters, the seconds the engines ran for, and the peak resident memory
+    void output_benchmark(std :: ostream& os, double seconds);
+  private:
+    friend class TrajectoryStream;
+    Arena own_arena;
+    OutputHeader binary_header();
+    void output_header_binary(std :: ostream& os, const char* magic);
+    size_t profile_size() const;
+    void output_profile(std :: ostream& os);
   };
 }
 #endif
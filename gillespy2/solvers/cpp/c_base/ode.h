@@ -0,0 +1,382 @@
+#ifndef GILLESPY_ODE
+#define GILLESPY_ODE
+#include "model.h"
+#include "ssa.h"//Included for the interrupt flag
+#include <algorithm>
+#include <cmath>
+#include <csignal>//Included for timeout signal handling
+#include <iostream>
+#include <limits>
+#include <vector>
+
+//Deterministic engine. Each reaction fires at its rate, its ODE propensity over real valued populations, and each species
+//changes at the sum of the rates times its change in Model :: species_changes. The system is integrated by the L-stable
+//Rosenbrock method of Shampine, L. F.; Reichelt, M. W. (1997). "The MATLAB ODE Suite". SIAM Journal on Scientific Computing.
+//18 (1): 1-22. doi:10.1137/S1064827594276424, which stays stable on stiff models. Its linear systems use the Jacobian assembled
+//from the rates' partial derivatives, which the code generator differentiates analytically.
+namespace Gillespy{
+
+  //Takes steps of the Rosenbrock method from state, over the rates of every reaction or of those set active, and the rate rules.
+  //ODEFunction :: evaluate(reaction_number, S) returns a reaction's rate and ODEFunction :: partials(reaction_number, S, P) writes
+  //its partial derivative by each species of Model :: rate_species into P, in order. ODEFunction :: rate_rule(rule, S) returns the
+  //rate of change of ODEFunction :: rate_rule_species[rule] and rate_rule_partials(rule, S, P) writes its nonzero partial
+  //derivatives by each species into P. partials and rate_rule_partials may change S but restore it.
+  template<typename ODEFunction>
+  class RosenbrockStepper{
+  public:
+    //Populations steps are taken from, may be changed between steps if start is called again
+    std :: vector<double> state;
+
+    //rtol and atol bound each step's error estimate in each species by atol + rtol * its population
+    RosenbrockStepper(Model* model, ODEFunction* ode_function, double rtol, double atol, EngineCounters& counters) :
+      state(model -> number_species),
+      model(model),
+      ode_function(ode_function),
+      number_species(model -> number_species),
+      rtol(rtol),
+      atol(atol),
+      counters(counters),
+      next_state(number_species),
+      stage_state(number_species),
+      derivative(number_species),
+      stage_derivative(number_species),
+      next_derivative(number_species),
+      k1(number_species),
+      k2(number_species),
+      k3(number_species),
+      jacobian(number_species * number_species),
+      iteration_matrix(number_species * number_species),
+      pivots(number_species),
+      partials(number_species)
+    {}
+
+    //Integrates only the rates of reactions flagged in active, or of every reaction if it is empty
+    void set_active(const std :: vector<unsigned char>& active){
+      this -> active = active;
+    }
+
+    //Evaluates the rates of change and Jacobian at state, call before stepping from a state that was set or changed
+    void start(){
+      evaluate(state.data(), derivative.data());
+      assemble_jacobian();
+    }
+
+    //Initial step as in the MATLAB suite, call after start
+    double initial_step(double max_step) const{
+      double rate = 0;
+      for(unsigned int species_number = 0; species_number < number_species; species_number++){
+	rate = std :: max(rate, std :: fabs(derivative[species_number]) / tolerance(state[species_number]));
+      }
+      return rate > 0 ? std :: min(max_step, 0.8 * std :: cbrt(rtol) / rate) : max_step;
+    }
+
+    //Takes a step from state, returns the error estimate relative to the tolerances, above 1 if the step should be rejected
+    double attempt(double step){
+      if(!factor(step)){
+	return std :: numeric_limits<double> :: infinity();
+      }
+      //k1 = W \ F0
+      std :: copy(derivative.begin(), derivative.end(), k1.begin());
+      solve(k1.data());
+      //k2 = W \ (F1 - k1) + k1
+      for(unsigned int i = 0; i < number_species; i++){
+	stage_state[i] = state[i] + 0.5 * step * k1[i];
+      }
+      evaluate(stage_state.data(), stage_derivative.data());
+      for(unsigned int i = 0; i < number_species; i++){
+	k2[i] = stage_derivative[i] - k1[i];
+      }
+      solve(k2.data());
+      for(unsigned int i = 0; i < number_species; i++){
+	k2[i] += k1[i];
+	next_state[i] = state[i] + step * k2[i];
+      }
+      //k3 = W \ (F2 - e32 (k2 - F1) - 2 (k1 - F0))
+      evaluate(next_state.data(), next_derivative.data());
+      for(unsigned int i = 0; i < number_species; i++){
+	k3[i] = next_derivative[i] - e32 * (k2[i] - stage_derivative[i]) - 2 * (k1[i] - derivative[i]);
+      }
+      solve(k3.data());
+      double error = 0;
+      for(unsigned int i = 0; i < number_species; i++){
+	double estimate = step / 6 * (k1[i] - 2 * k2[i] + k3[i]);
+	error = std :: max(error, std :: fabs(estimate) / tolerance(std :: max(std :: fabs(state[i]), std :: fabs(next_state[i]))));
+      }
+      return std :: isfinite(error) ? error : std :: numeric_limits<double> :: infinity();
+    }
+
+    //Population of a species fraction of the way through the last attempted step, by the method's continuous extension
+    double interpolate(unsigned int species_number, double fraction, double step) const{
+      double k1_weight = step * fraction * (1 - fraction) / (1 - 2 * gamma);
+      double k2_weight = step * fraction * (fraction - 2 * gamma) / (1 - 2 * gamma);
+      return state[species_number] + k1_weight * k1[species_number] + k2_weight * k2[species_number];
+    }
+
+    //Moves state to the end of the last attempted step
+    void accept(){
+      std :: swap(state, next_state);
+      std :: swap(derivative, next_derivative);
+      assemble_jacobian();
+      counters.events++;
+    }
+
+    //Size of the next step after one with the given error estimate, shrunk after rejected steps and grown after accepted ones
+    static double next_step(double step, double error){
+      if(error > 1){
+	return step * std :: max(0.5, 0.8 / std :: cbrt(error));
+      }
+      return step * (error > 0 ? std :: min(5.0, 0.8 / std :: cbrt(error)) : 5.0);
+    }
+
+    //Smallest step taken at a time, smaller steps fail
+    static double min_step(double time){
+      return 16 * std :: numeric_limits<double> :: epsilon() * std :: max(1.0, std :: fabs(time));
+    }
+
+    //Integrates state from time over duration with as many steps as the tolerances need, starting with step and leaving
+    //the size of the next step in it. Returns false with the reason on std :: cerr if the step size underflows.
+    bool advance(double time, double duration, double& step){
+      start();
+      double remaining = duration;
+      while(remaining > min_step(time + duration)){
+	double size = std :: min(step, remaining);
+	double error = attempt(size);
+	step = next_step(size, error);
+	if(error > 1){
+	  if(step < min_step(time)){
+	    std :: cerr << "ODE step size fell below " << min_step(time) << " at time " << time << std :: endl;
+	    return false;
+	  }
+	  continue;
+	}
+	accept();
+	remaining -= size;
+	time += size;
+      }
+      return true;
+    }
+
+  private:
+    //d and e32 of the method's coefficients
+    static constexpr double gamma = 0.29289321881345247559915563789515; //1 / (2 + sqrt(2))
+    static constexpr double e32 = 7.4142135623730950488016887242097; //6 + sqrt(2)
+
+    double tolerance(double population) const{
+      return std :: max(atol, rtol * std :: fabs(population));
+    }
+
+    bool integrated(unsigned int reaction_number) const{
+      return active.empty() || active[reaction_number];
+    }
+
+    //Rate of change of each species at populations S
+    void evaluate(const double* S, double* dSdt){
+      std :: fill(dSdt, dSdt + number_species, 0);
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	if(!integrated(reaction_number)){
+	  continue;
+	}
+	double rate = ode_function -> evaluate(reaction_number, S);
+	for(const SpeciesCount* change = model -> species_changes.begin(reaction_number); change != model -> species_changes.end(reaction_number); change++){
+	  dSdt[change -> species] += change -> count * rate;
+	}
+	counters.propensity_evaluations++;
+      }
+      for(unsigned int rule = 0; rule < ode_function -> rate_rule_species.size(); rule++){
+	dSdt[ode_function -> rate_rule_species[rule]] += ode_function -> rate_rule(rule, S);
+      }
+    }
+
+    //Jacobian of evaluate at state, summed from each reaction's partials times its species changes and the rate rules' partials
+    void assemble_jacobian(){
+      std :: fill(jacobian.begin(), jacobian.end(), 0);
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	const unsigned int* rate_species = model -> rate_species.begin(reaction_number);
+	unsigned int number_partials = model -> rate_species.end(reaction_number) - rate_species;
+	if(number_partials == 0 || !integrated(reaction_number)){
+	  continue;
+	}
+	partials.resize(std :: max<size_t>(partials.size(), number_partials));
+	ode_function -> partials(reaction_number, state.data(), partials.data());
+	for(const SpeciesCount* change = model -> species_changes.begin(reaction_number); change != model -> species_changes.end(reaction_number); change++){
+	  double* row = &jacobian[change -> species * (size_t) number_species];
+	  for(unsigned int i = 0; i < number_partials; i++){
+	    row[rate_species[i]] += change -> count * partials[i];
+	  }
+	}
+      }
+      for(unsigned int rule = 0; rule < ode_function -> rate_rule_species.size(); rule++){
+	std :: fill(partials.begin(), partials.begin() + number_species, 0);
+	ode_function -> rate_rule_partials(rule, state.data(), partials.data());
+	double* row = &jacobian[ode_function -> rate_rule_species[rule] * (size_t) number_species];
+	for(unsigned int i = 0; i < number_species; i++){
+	  row[i] += partials[i];
+	}
+      }
+    }
+
+    //LU factors W = I - step * gamma * J with partial pivoting, returns false if it is singular
+    bool factor(double step){
+      size_t n = number_species;
+      for(size_t i = 0; i < n * n; i++){
+	iteration_matrix[i] = -step * gamma * jacobian[i];
+      }
+      for(size_t i = 0; i < n; i++){
+	iteration_matrix[i * n + i] += 1;
+      }
+      for(size_t column = 0; column < n; column++){
+	size_t pivot = column;
+	for(size_t row = column + 1; row < n; row++){
+	  if(std :: fabs(iteration_matrix[row * n + column]) > std :: fabs(iteration_matrix[pivot * n + column])){
+	    pivot = row;
+	  }
+	}
+	pivots[column] = pivot;
+	if(iteration_matrix[pivot * n + column] == 0 || !std :: isfinite(iteration_matrix[pivot * n + column])){
+	  return false;
+	}
+	if(pivot != column){
+	  std :: swap_ranges(&iteration_matrix[column * n], &iteration_matrix[column * n] + n, &iteration_matrix[pivot * n]);
+	}
+	double diagonal = iteration_matrix[column * n + column];
+	for(size_t row = column + 1; row < n; row++){
+	  double multiplier = iteration_matrix[row * n + column] /= diagonal;
+	  if(multiplier == 0){
+	    continue;
+	  }
+	  for(size_t i = column + 1; i < n; i++){
+	    iteration_matrix[row * n + i] -= multiplier * iteration_matrix[column * n + i];
+	  }
+	}
+      }
+      return true;
+    }
+
+    //Solves W x = b in place with the factors of W
+    void solve(double* b){
+      size_t n = number_species;
+      for(size_t column = 0; column < n; column++){
+	std :: swap(b[column], b[pivots[column]]);
+	for(size_t row = column + 1; row < n; row++){
+	  b[row] -= iteration_matrix[row * n + column] * b[column];
+	}
+      }
+      for(size_t row = n; row > 0; row--){
+	for(size_t i = row; i < n; i++){
+	  b[row - 1] -= iteration_matrix[(row - 1) * n + i] * b[i];
+	}
+	b[row - 1] /= iteration_matrix[(row - 1) * n + row - 1];
+      }
+    }
+
+    Model* model;
+    ODEFunction* ode_function;
+    unsigned int number_species;
+    double rtol;
+    double atol;
+    EngineCounters& counters;
+    std :: vector<unsigned char> active;
+    std :: vector<double> next_state;
+    std :: vector<double> stage_state;
+    //Rates of change at state, the midpoint stage and next_state
+    std :: vector<double> derivative;
+    std :: vector<double> stage_derivative;
+    std :: vector<double> next_derivative;
+    std :: vector<double> k1;
+    std :: vector<double> k2;
+    std :: vector<double> k3;
+    //Dense number_species * number_species matrices, row major
+    std :: vector<double> jacobian;
+    std :: vector<double> iteration_matrix;
+    std :: vector<size_t> pivots;
+    std :: vector<double> partials;
+  };
+
+  template<typename ODEFunction>
+  constexpr double RosenbrockStepper<ODEFunction> :: gamma;
+  template<typename ODEFunction>
+  constexpr double RosenbrockStepper<ODEFunction> :: e32;
+
+  //Integrates the deterministic solution of every reaction over the timeline, interpolating the timesteps each step passes
+  template<typename ODEFunction>
+  class RosenbrockMethod{
+  public:
+    EngineCounters counters;
+
+    RosenbrockMethod(Simulation* simulation, ODEFunction* ode_function, double rtol, double atol) :
+      simulation(simulation),
+      stepper(simulation -> model, ode_function, rtol, atol, counters)
+    {}
+
+    //Integrates the solution into the first trajectory of simulation -> concentrations, returns the time it stopped at
+    double simulate(){
+      Model* model = simulation -> model;
+      const unsigned int* point_populations = simulation -> trajectory_populations(0);
+      for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	stepper.state[species_number] = point_populations ? point_populations[species_number] : model -> species[species_number].initial_population;
+      }
+      double current_time = 0;
+      unsigned int entry_count = 0;
+      double end_time = simulation -> timeline[simulation -> number_timesteps - 1];
+      for(; entry_count < simulation -> number_timesteps && simulation -> timeline[entry_count] <= 0; entry_count++){
+	record(entry_count, 0, 0);
+      }
+      stepper.start();
+      double max_step = end_time / 10;
+      double step = stepper.initial_step(max_step);
+      while(entry_count < simulation -> number_timesteps){
+	if(interrupted){
+	  return current_time;
+	}
+	step = std :: min(step, end_time - current_time);
+	double error = stepper.attempt(step);
+	if(error > 1){
+	  step = stepper.next_step(step, error);
+	  if(step < stepper.min_step(current_time)){
+	    std :: cerr << "ODE step size fell below " << stepper.min_step(current_time) << " at time " << current_time << std :: endl;
+	    return current_time;
+	  }
+	  continue;
+	}
+	//Timesteps passed by the step are interpolated from its stages
+	double next_time = (end_time - current_time - step <= stepper.min_step(end_time)) ? end_time : current_time + step;
+	for(; entry_count < simulation -> number_timesteps && simulation -> timeline[entry_count] <= next_time; entry_count++){
+	  record(entry_count, (simulation -> timeline[entry_count] - current_time) / step, step);
+	}
+	current_time = next_time;
+	stepper.accept();
+	step = std :: min(stepper.next_step(step, error), max_step);
+      }
+      return current_time;
+    }
+
+  private:
+    void record(unsigned int timestep, double fraction, double step){
+      double* row = &(simulation -> concentrations[timestep * (size_t) simulation -> number_observed]);
+      for(unsigned int column = 0; column < simulation -> number_observed; column++){
+	unsigned int species_number = simulation -> observed(column);
+	row[column] = step > 0 ? stepper.interpolate(species_number, fraction, step) : stepper.state[species_number];
+      }
+    }
+
+    Simulation* simulation;
+    RosenbrockStepper<ODEFunction> stepper;
+  };
+
+  //Deterministic solution by a stiff Rosenbrock method, every trajectory of the continuous simulation is the same solution.
+  //rtol and atol are the relative and absolute error tolerances of each step.
+  template<typename ODEFunction>
+  void ode_solver(Simulation* simulation, ODEFunction* ode_function, double rtol, double atol){
+    signal(SIGINT, signalHandler);
+    if(simulation){
+      RosenbrockMethod<ODEFunction> method(simulation, ode_function, rtol, atol);
+      simulation -> current_time = method.simulate();
+      simulation -> counters.add(method.counters);
+      size_t trajectory_size = (size_t) simulation -> number_timesteps * simulation -> number_observed;
+      for(unsigned int trajectory_number = 1; trajectory_number < simulation -> number_trajectories; trajectory_number++){
+	std :: copy(simulation -> concentrations.begin(), simulation -> concentrations.begin() + trajectory_size, simulation -> concentrations.begin() + trajectory_number * trajectory_size);
+      }
+    }
+  }//end ode_solver
+}
+#endif
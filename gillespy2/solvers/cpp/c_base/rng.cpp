@@ -0,0 +1,46 @@
+#include "rng.h"
+
+namespace Gillespy{
+
+  constexpr double ExponentialZiggurat :: tail_start;
+
+  ExponentialZiggurat :: ExponentialZiggurat(){
+    const double scale = 9007199254740992.0; //2^53
+    const double area = 3.949659822581572e-3; //area of each layer
+    double edge = tail_start;
+    double previous_edge = edge;
+    double base_width = area / std :: exp(-edge);
+    k[0] = (uint64_t) ((edge / base_width) * scale);
+    k[1] = 0;
+    w[0] = base_width / scale;
+    w[255] = edge / scale;
+    f[0] = 1;
+    f[255] = std :: exp(-edge);
+    for(int i = 254; i >= 1; i--){
+      edge = -std :: log(area / edge + std :: exp(-edge));
+      k[i + 1] = (uint64_t) ((edge / previous_edge) * scale);
+      previous_edge = edge;
+      f[i] = std :: exp(-edge);
+      w[i] = edge / scale;
+    }
+  }
+
+  const ExponentialZiggurat exponential_ziggurat;
+
+  Xoshiro256 :: Xoshiro256(std :: seed_seq& seed){
+    uint32_t words[8];
+    seed.generate(words, words + 8);
+    for(int i = 0; i < 4; i++){
+      state[i] = ((uint64_t) words[2 * i] << 32) | words[2 * i + 1];
+    }
+    //The all zero state is the one state xoshiro can not leave
+    if(!(state[0] | state[1] | state[2] | state[3])){
+      state[0] = 1;
+    }
+  }
+
+  TrajectoryRng trajectory_rng(int random_seed, unsigned int trajectory_number){
+    std :: seed_seq seed{(unsigned int) random_seed, trajectory_number};
+    return TrajectoryRng(seed);
+  }
+}
@@ -0,0 +1,114 @@
+#ifndef GILLESPY_RNG
+#define GILLESPY_RNG
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+//Random number generation for the engines. Each trajectory draws from its own generator, seeded from the
+//simulation seed and the trajectory number. TrajectoryRng is xoshiro256++, or std :: mt19937_64 when
+//built with -DGILLESPY_MT19937. Both satisfy UniformRandomBitGenerator, so they also drive std distributions.
+namespace Gillespy{
+
+  //Tables of the 256 layer ziggurat for the unit exponential distribution, Marsaglia and Tsang (2000)
+  //"The Ziggurat Method for Generating Random Variables". Layer widths are scaled to 53 bit integers.
+  struct ExponentialZiggurat{
+    static constexpr double tail_start = 7.69711747013104972;
+    uint64_t k[256]; //acceptance bound of each layer
+    double w[256]; //scale from a 53 bit integer to a point in each layer
+    double f[256]; //density at each layer's edge
+    ExponentialZiggurat();
+  };
+  extern const ExponentialZiggurat exponential_ziggurat;
+
+  //Samples shared by every generator, Generator :: operator() returns 64 random bits
+  template<typename Generator>
+  class RandomSampler{
+  public:
+    //Uniform in (0, 1], never 0 so its logarithm is finite
+    double uniform(){
+      return ((generator()() >> 11) + 1) * (1.0 / 9007199254740992.0);
+    }
+
+    //Uniform integer in [0, n), by Lemire's multiply and shift, n must be below 2^32
+    uint32_t below(uint32_t n){
+      return (uint32_t) (((generator()() >> 32) * n) >> 32);
+    }
+
+    //Unit exponential, by the ziggurat method, the common case costs one draw and one comparison
+    double exponential(){
+      const ExponentialZiggurat& z = exponential_ziggurat;
+      while(true){
+	uint64_t bits = generator()();
+	unsigned int layer = bits & 255;
+	uint64_t position = bits >> 11;
+	double x = position * z.w[layer];
+	if(position < z.k[layer]){
+	  return x;
+	}
+	if(layer == 0){
+	  return ExponentialZiggurat :: tail_start - std :: log(uniform());
+	}
+	if(z.f[layer] + uniform() * (z.f[layer - 1] - z.f[layer]) < std :: exp(-x)){
+	  return x;
+	}
+      }
+    }
+
+  private:
+    Generator& generator(){
+      return static_cast<Generator&>(*this);
+    }
+  };
+
+  //xoshiro256++ 1.0, Blackman and Vigna (2019) "Scrambled Linear Pseudorandom Number Generators"
+  class Xoshiro256 : public RandomSampler<Xoshiro256>{
+  public:
+    typedef uint64_t result_type;
+
+    static constexpr result_type min(){
+      return 0;
+    }
+    static constexpr result_type max(){
+      return std :: numeric_limits<result_type> :: max();
+    }
+
+    explicit Xoshiro256(std :: seed_seq& seed);
+
+    result_type operator()(){
+      uint64_t result = rotate(state[0] + state[3], 23) + state[0];
+      uint64_t t = state[1] << 17;
+      state[2] ^= state[0];
+      state[3] ^= state[1];
+      state[1] ^= state[2];
+      state[0] ^= state[3];
+      state[2] ^= t;
+      state[3] = rotate(state[3], 45);
+      return result;
+    }
+
+  private:
+    uint64_t state[4];
+
+    static uint64_t rotate(uint64_t x, int k){
+      return (x << k) | (x >> (64 - k));
+    }
+  };
+
+  //std :: mt19937_64 with the common samples, the generator used before xoshiro256++
+  class Mt19937 : public std :: mt19937_64, public RandomSampler<Mt19937>{
+  public:
+    explicit Mt19937(std :: seed_seq& seed) : std :: mt19937_64(seed) {}
+  };
+
+#ifdef GILLESPY_MT19937
+  typedef Mt19937 TrajectoryRng;
+#else
+  typedef Xoshiro256 TrajectoryRng;
+#endif
+
+  //Each trajectory gets its own random stream derived from the simulation seed,
+  //so results for a fixed seed do not depend on how trajectories are split between threads
+  TrajectoryRng trajectory_rng(int random_seed, unsigned int trajectory_number);
+}
+#endif
@@ -0,0 +1,11 @@
+#ifndef GILLESPY_SIMULATION
+#define GILLESPY_SIMULATION
+//Headers included by every simulation template, which the makefile's cbase target precompiles
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <math.h>
+#include "model.h"
+#include "ssa.h"
+#endif
@@ -1,104 +1,177 @@
 #include "ssa.h"
-#include <random>//Included for mt19937 random number generator
-#include <cmath>//Included for natural logarithm
-#include <string.h>//Included for memcpy only
-#include <csignal>//Included for timeout signal handling
+#include <algorithm>
 
 namespace Gillespy{
 
-  bool interrupted = false ;
+  std :: atomic<bool> interrupted(false);
 
   void signalHandler( int signum){
     interrupted = true ;
   }
 
-  void ssa_direct(Simulation* simulation){
-    signal(SIGINT, signalHandler) ;
-
-    if(simulation){
-      std :: mt19937_64 rng(simulation -> random_seed);
-      //Number of bytes for copying states
-      unsigned int state_size = sizeof(int)*((simulation -> model) -> number_species);
-      //Current state
-      unsigned int* current_state = new unsigned int[(simulation -> model) -> number_species];
-      //Calculated propensity values for current state
-      double* propensity_values = new double[(simulation -> model) -> number_reactions];
-      
-      //copy initial state for each trajectory
-      for(unsigned int species_number = 0; species_number < ((simulation -> model) -> number_species); species_number++){
-	simulation -> trajectories[0][0][species_number] = (simulation -> model) -> species[species_number].initial_population;
+
+  void ReactionQueue :: build(){
+    for(unsigned int i = 0; i < heap.size(); i++){
+      heap[i] = i;
+      position[i] = i;
+    }
+    for(unsigned int i = heap.size() / 2; i > 0; i--){
+      sift_down(i - 1);
+    }
+  }
+
+  void ReactionQueue :: update(unsigned int reaction_number, double firing_time){
+    double previous_time = firing_times[reaction_number];
+    firing_times[reaction_number] = firing_time;
+    if(firing_time < previous_time){
+      sift_up(position[reaction_number]);
+    }else{
+      sift_down(position[reaction_number]);
+    }
+  }
+
+  void ReactionQueue :: swap(unsigned int i, unsigned int j){
+    std :: swap(heap[i], heap[j]);
+    position[heap[i]] = i;
+    position[heap[j]] = j;
+  }
+
+  void ReactionQueue :: sift_up(unsigned int i){
+    while(i > 0 && firing_times[heap[i]] < firing_times[heap[(i - 1) / 2]]){
+      swap(i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+  }
+
+  void ReactionQueue :: sift_down(unsigned int i){
+    while(true){
+      unsigned int smallest = i;
+      unsigned int left = 2 * i + 1;
+      unsigned int right = left + 1;
+      if(left < heap.size() && firing_times[heap[left]] < firing_times[heap[smallest]]){
+	smallest = left;
+      }
+      if(right < heap.size() && firing_times[heap[right]] < firing_times[heap[smallest]]){
+	smallest = right;
+      }
+      if(smallest == i){
+	return;
+      }
+      swap(i, smallest);
+      i = smallest;
+    }
+  }
+
+
+  PropensityGroups :: PropensityGroups(unsigned int number_reactions) :
+    groups(max_exponent - min_exponent + 1),
+    reaction_group(number_reactions),
+    reaction_position(number_reactions),
+    propensities(number_reactions)
+  {
+    clear();
+  }
+
+  void PropensityGroups :: clear(){
+    for(Group& group : groups){
+      group.sum = 0;
+      group.members.clear();
+    }
+    std :: fill(reaction_group.begin(), reaction_group.end(), -1);
+    lowest = groups.size();
+    highest = -1;
+    propensity_sum = 0;
+  }
+
+  void PropensityGroups :: update(unsigned int reaction_number, double propensity){
+    double previous = propensities[reaction_number];
+    int previous_group = reaction_group[reaction_number];
+    int group = propensity > 0 ? group_index(propensity) : -1;
+    propensities[reaction_number] = propensity;
+    if(previous_group == group){
+      if(group >= 0){
+	groups[group].sum += propensity - previous;
+	propensity_sum += propensity - previous;
+      }
+      return;
+    }
+    if(previous_group >= 0){
+      remove(reaction_number, previous_group, previous);
+    }
+    if(group >= 0){
+      insert(reaction_number, group, propensity);
+    }
+  }
+
+  void PropensityGroups :: refresh(){
+    propensity_sum = 0;
+    for(int g = lowest; g <= highest; g++){
+      groups[g].sum = 0;
+      for(unsigned int reaction_number : groups[g].members){
+	groups[g].sum += propensities[reaction_number];
+      }
+      propensity_sum += groups[g].sum;
+    }
+  }
+
+  unsigned int PropensityGroups :: select(TrajectoryRng& rng){
+    double remaining = rng.uniform() * propensity_sum;
+    int g = highest;
+    for(; g > lowest; g--){
+      remaining -= groups[g].sum;
+      if(remaining <= 0 && !groups[g].members.empty()){
+	break;
+      }
+    }
+    const std :: vector<unsigned int>& members = groups[g].members;
+    double upper_bound = ldexp(1.0, g + min_exponent);
+    while(true){
+      unsigned int reaction_number = members[rng.below(members.size())];
+      if(rng.uniform() * upper_bound < propensities[reaction_number]){
+	return reaction_number;
       }
-      //Simulate for each trajectory
-      for(unsigned int trajectory_number = 0; trajectory_number < simulation -> number_trajectories; trajectory_number++){
-    if(interrupted){
-        break ;
     }
-	//Get simpler reference to memory space for this trajectory
-	unsigned int** trajectory = simulation -> trajectories[trajectory_number];
-	//Copy initial state as needed
-	if(trajectory_number > 0){
-	  memcpy(trajectory[0], simulation -> trajectories[0][0], state_size);
-	}
-	//Set up current state from initial state
-	memcpy(current_state, trajectory[0], state_size);
-	simulation->current_time = 0;
-	unsigned int entry_count = 1;
-	//calculate initial propensities
-	for(unsigned int reaction_number = 0; reaction_number < ((simulation -> model) -> number_reactions); reaction_number++){
-	  propensity_values[reaction_number] = (simulation -> propensity_function) -> evaluate(reaction_number, current_state);
-	}
-	double propensity_sum;
-	while(simulation->current_time < (simulation -> end_time)){
-      if(interrupted){
-        break ;
+  }
+
+  int PropensityGroups :: group_index(double propensity){
+    int exponent;
+    frexp(propensity, &exponent);
+    return exponent - min_exponent;
+  }
+
+  void PropensityGroups :: insert(unsigned int reaction_number, int group, double propensity){
+    reaction_group[reaction_number] = group;
+    reaction_position[reaction_number] = groups[group].members.size();
+    groups[group].members.push_back(reaction_number);
+    groups[group].sum += propensity;
+    propensity_sum += propensity;
+    if(group < lowest){
+      lowest = group;
+    }
+    if(group > highest){
+      highest = group;
+    }
+  }
+
+  void PropensityGroups :: remove(unsigned int reaction_number, int group, double propensity){
+    std :: vector<unsigned int>& members = groups[group].members;
+    unsigned int position = reaction_position[reaction_number];
+    members[position] = members.back();
+    reaction_position[members[position]] = position;
+    members.pop_back();
+    reaction_group[reaction_number] = -1;
+    propensity_sum -= propensity;
+    if(members.empty()){
+      propensity_sum -= groups[group].sum - propensity;
+      groups[group].sum = 0;
+      while(highest >= lowest && groups[highest].members.empty()){
+	highest--;
       }
-	  //Sum propensities
-	  propensity_sum = 0;
-	  for(unsigned int reaction_number = 0; reaction_number < ((simulation -> model) -> number_reactions); reaction_number++){
-	    propensity_sum += propensity_values[reaction_number];
-	  }
-	  //No more reactions
-	  if(propensity_sum <= 0){
-	    //Copy all of last changed state for rest of entries
-	    for(unsigned int i = entry_count; i < simulation -> number_timesteps; i++){
-	      memcpy(trajectory[i], current_state, state_size);
-	    }
-	    //Quit simulating this trajectory
-	    break;
-	  }//End if no more reactions
-	  
-	  //Reaction will fire, determine which one
-	  double cumulative_sum = rng() * propensity_sum/rng.max();
-	  simulation->current_time += -log(rng() * 1.0 / rng.max()) / propensity_sum;
-	  //Copy current state to passed timesteps
-	  while(entry_count < simulation -> number_timesteps && (simulation -> timeline[entry_count]) <= simulation->current_time){
-        if(interrupted){
-            break ;
-        }
-	    memcpy(trajectory[entry_count], current_state, state_size);
-	    entry_count++;
-	  }
-
-	  for(unsigned int potential_reaction = 0; potential_reaction < ((simulation -> model) -> number_reactions); potential_reaction++){
-	    cumulative_sum -= propensity_values[potential_reaction];
-	    //This reaction fired
-	    if (cumulative_sum <= 0 && propensity_values[potential_reaction] > 0){
-	      //Update current state
-	      Reaction& reaction = ((simulation -> model) -> reactions[potential_reaction]);
-	      for(unsigned int species_number = 0; species_number < ((simulation -> model) -> number_species); species_number++){
-		current_state[species_number] += reaction.species_change[species_number];
-	      }
-	      //Recalculate needed propensities
-	      for(unsigned int& affected_reaction : reaction.affected_reactions){
-	 	propensity_values[affected_reaction] =  (simulation -> propensity_function) -> evaluate(affected_reaction, current_state);
-	      }
-	      break;
-	    }//Finished updating state/propensities with this reaction
-	  }//Finished checking for which reaction fired at this time
-	}//Simulation has reached end time
-      }//Finished simulating all trajectories
-      delete propensity_values;
-      delete current_state;
-    }//end if simulation pointer not null
-  }//end ssa_direct
+      while(lowest <= highest && groups[lowest].members.empty()){
+	lowest++;
+      }
+    }else{
+      groups[group].sum -= propensity;
+    }
+  }
 }//end namespace
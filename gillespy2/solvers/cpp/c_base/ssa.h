@@ -1,5 +1,811 @@
+#ifndef GILLESPY_SSA
+#define GILLESPY_SSA
 #include "model.h"
+#include "statistics.h"
+#include "rng.h"
+#include <cmath>//Included for natural logarithm
+#include <cstring>//Included for restoring checkpointed generators
+#include <limits>//Included for infinite firing times
+#include <atomic>//Included for interrupt flag and trajectory counter shared between threads
+#include <chrono>//Included for profiling the phases of events
+#include <csignal>//Included for timeout signal handling
+#include <mutex>//Included for adding worker threads' counters
+#include <thread>//Included for trajectory-parallel simulation
+#include <type_traits>//Included for checking generators can be checkpointed as bytes
 
+//The SSA engines are class templates over the propensity function type, so a generated simulation
+//whose PropensityFunction is final has every propensity evaluation inlined into the engine loops.
+//Instantiated with the default IPropensityFunction they dispatch through the virtual interface instead.
 namespace Gillespy{
-  void ssa_direct(Simulation* simulation);
+  extern std :: atomic<bool> interrupted;
+  void signalHandler(int signum);
+
+  //Hot path profiling. Engines record through an EngineProfiler, which in simulations built with -DGILLESPY_PROFILE
+  //counts each reaction's firings and the dependency graph fan-out and times the phases of each event into the
+  //engine's counters. Otherwise every call is empty and compiles away.
+  template<bool enabled>
+  class Profiler{
+  public:
+    Profiler(EngineCounters& counters, unsigned int number_reactions) {}
+    void fired(unsigned int reaction_number, unsigned long long count, unsigned int fan_out) {}
+    void start() {}
+    void lap(double EngineCounters :: * phase) {}
+  };
+
+  template<>
+  class Profiler<true>{
+  public:
+    Profiler(EngineCounters& counters, unsigned int number_reactions) : counters(counters){
+      counters.profiled = true;
+      counters.firings.assign(number_reactions, 0);
+    }
+
+    void fired(unsigned int reaction_number, unsigned long long count, unsigned int fan_out){
+      counters.firings[reaction_number] += count;
+      counters.fan_out += fan_out;
+    }
+
+    //Starts timing the phases of an event
+    void start(){
+      last = clock :: now();
+    }
+
+    //Adds the time since start or the previous lap to a phase
+    void lap(double EngineCounters :: * phase){
+      clock :: time_point now = clock :: now();
+      counters.*phase += std :: chrono :: duration<double>(now - last).count();
+      last = now;
+    }
+
+  private:
+    typedef std :: chrono :: steady_clock clock;
+    EngineCounters& counters;
+    clock :: time_point last;
+  };
+
+#ifdef GILLESPY_PROFILE
+  typedef Profiler<true> EngineProfiler;
+#else
+  typedef Profiler<false> EngineProfiler;
+#endif
+
+  //Copies the initial populations of a trajectory's point, or else the model's, into the current state
+  inline void initial_populations(Simulation* simulation, unsigned int trajectory_number, unsigned int* current_state){
+    const unsigned int* point_populations = simulation -> trajectory_populations(trajectory_number);
+    for(unsigned int species_number = 0; species_number < ((simulation -> model) -> number_species); species_number++){
+      current_state[species_number] = point_populations ? point_populations[species_number] : (simulation -> model) -> species[species_number].initial_population;
+    }
+  }
+
+  //Generator of a trajectory, seeded from the simulation seed and the trajectory's number within the whole ensemble,
+  //so an ensemble split between simulations draws the same numbers as one simulation of every trajectory
+  inline TrajectoryRng simulation_rng(const Simulation* simulation, unsigned int trajectory_number){
+    return trajectory_rng(simulation -> random_seed, simulation -> first_trajectory + trajectory_number);
+  }
+
+  //Records the current state as a trajectory's first timestep
+  inline void record_initial_state(Simulation* simulation, unsigned int trajectory_number, Trajectory trajectory, unsigned int* current_state){
+    simulation -> observe(trajectory[0], current_state);
+    if(simulation -> record_changes){
+      std :: vector<PopulationChange>& changes = simulation -> trajectory_changes[trajectory_number];
+      changes.clear();
+      for(unsigned int column = 0; column < simulation -> number_observed; column++){
+	if(trajectory[0][column] != 0){
+	  changes.push_back({0, column, trajectory[0][column]});
+	}
+      }
+      simulation -> trajectory_timesteps[trajectory_number] = 1;
+    }
+    if(simulation -> record_every){
+      simulation -> event_times[trajectory_number].assign(1, 0);
+      simulation -> event_populations[trajectory_number].assign(trajectory[0], trajectory[0] + simulation -> number_observed);
+      simulation -> events_since_record[trajectory_number] = 0;
+    }
+  }
+
+  //Copies the initial populations of a trajectory's point, or else the model's, into the current state and its first timestep
+  inline void initialize_trajectory(Simulation* simulation, unsigned int trajectory_number, Trajectory trajectory, unsigned int* current_state){
+    initial_populations(simulation, trajectory_number, current_state);
+    record_initial_state(simulation, trajectory_number, trajectory, current_state);
+  }
+
+  //Records the time and observed state after every simulation -> record_every-th event of a trajectory up to the end time, call after each event
+  inline void record_event(Simulation* simulation, unsigned int trajectory_number, double current_time, const unsigned int* current_state){
+    if(!simulation -> record_every || current_time > simulation -> end_time || ++(simulation -> events_since_record[trajectory_number]) < simulation -> record_every){
+      return;
+    }
+    simulation -> events_since_record[trajectory_number] = 0;
+    simulation -> event_times[trajectory_number].push_back(current_time);
+    std :: vector<unsigned int>& populations = simulation -> event_populations[trajectory_number];
+    for(unsigned int column = 0; column < simulation -> number_observed; column++){
+      populations.push_back(current_state[simulation -> observed(column)]);
+    }
+  }
+
+  //Records the populations changed since the last recorded timestep at entry_count, the first timestep passed by current_time.
+  //Later timesteps it passes hold the same state and are skipped without copying. Every row of trajectory holds the last recorded state.
+  inline unsigned int record_changed_populations(Simulation* simulation, unsigned int trajectory_number, Trajectory trajectory, unsigned int entry_count, double current_time, unsigned int* current_state){
+    if(entry_count >= simulation -> number_timesteps || (simulation -> timeline[entry_count]) > current_time){
+      return entry_count;
+    }
+    std :: vector<PopulationChange>& changes = simulation -> trajectory_changes[trajectory_number];
+    unsigned int* last_state = trajectory[entry_count];
+    for(unsigned int column = 0; column < simulation -> number_observed; column++){
+      unsigned int population = current_state[simulation -> observed(column)];
+      if(last_state[column] != population){
+	changes.push_back({entry_count, column, population});
+	last_state[column] = population;
+      }
+    }
+    do{
+      entry_count++;
+    }while(entry_count < simulation -> number_timesteps && (simulation -> timeline[entry_count]) <= current_time);
+    simulation -> trajectory_timesteps[trajectory_number] = entry_count;
+    return entry_count;
+  }
+
+  //Copies the observed current state to every timestep passed by current_time, returns the updated entry count.
+  //A step's timesteps are always recorded whole, so an interrupted trajectory's checkpoint holds every timestep before it.
+  inline unsigned int record_state(Simulation* simulation, unsigned int trajectory_number, Trajectory trajectory, unsigned int entry_count, double current_time, unsigned int* current_state){
+    if(simulation -> record_changes){
+      return record_changed_populations(simulation, trajectory_number, trajectory, entry_count, current_time, current_state);
+    }
+    //Only events are recorded, the timeline just bounds the engines' steps
+    if(simulation -> record_every){
+      while(entry_count < simulation -> number_timesteps && (simulation -> timeline[entry_count]) <= current_time){
+	entry_count++;
+      }
+      return entry_count;
+    }
+    while(entry_count < simulation -> number_timesteps && (simulation -> timeline[entry_count]) <= current_time){
+      simulation -> observe(trajectory[entry_count], current_state);
+      entry_count++;
+    }
+    return entry_count;
+  }
+
+  //Copies the observed current state to every remaining timestep, used once no more reactions can fire
+  inline void fill_trajectory(Simulation* simulation, unsigned int trajectory_number, Trajectory trajectory, unsigned int entry_count, unsigned int* current_state){
+    if(simulation -> record_changes){
+      record_changed_populations(simulation, trajectory_number, trajectory, entry_count, std :: numeric_limits<double> :: infinity(), current_state);
+      return;
+    }
+    if(simulation -> record_every){
+      return;
+    }
+    for(unsigned int i = entry_count; i < simulation -> number_timesteps; i++){
+      simulation -> observe(trajectory[i], current_state);
+    }
+  }
+
+  //Applies a reaction's nonzero population changes
+  inline void fire_reaction(Model* model, unsigned int reaction_number, unsigned int* current_state){
+    const SpeciesCount* end = model -> species_changes.end(reaction_number);
+    for(const SpeciesCount* change = model -> species_changes.begin(reaction_number); change != end; change++){
+      current_state[change -> species] += change -> count;
+    }
+  }
+
+  static_assert(std :: is_trivially_copyable<TrajectoryRng> :: value, "Checkpoints save generators as bytes");
+
+  //Saves where a trajectory is at the start of a step, if the simulation saves checkpoints
+  inline void save_checkpoint(Simulation* simulation, unsigned int trajectory_number, double current_time, unsigned int entry_count, const unsigned int* current_state, const TrajectoryRng& rng, const double* firing_times = nullptr){
+    if(!simulation -> save_checkpoints){
+      return;
+    }
+    TrajectoryCheckpoint& checkpoint = simulation -> checkpoints[trajectory_number];
+    checkpoint.started = true;
+    checkpoint.time = current_time;
+    checkpoint.entry_count = entry_count;
+    checkpoint.state.assign(current_state, current_state + (simulation -> model) -> number_species);
+    const unsigned char* rng_bytes = reinterpret_cast<const unsigned char*>(&rng);
+    checkpoint.rng.assign(rng_bytes, rng_bytes + sizeof(TrajectoryRng));
+    if(firing_times){
+      checkpoint.firing_times.assign(firing_times, firing_times + (simulation -> model) -> number_reactions);
+    }else{
+      checkpoint.firing_times.clear();
+    }
+  }
+
+  //Starts a trajectory from its checkpoint if it is resumed, else from its initial populations at time 0, and sets the time and
+  //entry count it starts at. Timesteps before a resumed trajectory's entry count belong to the simulation that saved the checkpoint
+  //and are left 0. Returns the checkpoint resumed from, or nullptr.
+  inline const TrajectoryCheckpoint* start_trajectory(Simulation* simulation, unsigned int trajectory_number, Trajectory trajectory, unsigned int* current_state, double& current_time, unsigned int& entry_count, TrajectoryRng& rng){
+    const TrajectoryCheckpoint* checkpoint = simulation -> resumed_checkpoint(trajectory_number);
+    if(!checkpoint){
+      initialize_trajectory(simulation, trajectory_number, trajectory, current_state);
+      current_time = 0;
+      entry_count = 1;
+      save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state, rng);
+      return nullptr;
+    }
+    std :: copy(checkpoint -> state.begin(), checkpoint -> state.end(), current_state);
+    memcpy(&rng, checkpoint -> rng.data(), sizeof(TrajectoryRng));
+    current_time = checkpoint -> time;
+    entry_count = checkpoint -> entry_count;
+    for(unsigned int timestep = 0; timestep < std :: min(entry_count, simulation -> number_timesteps); timestep++){
+      std :: fill(trajectory[timestep], trajectory[timestep] + simulation -> number_observed, 0);
+    }
+    return checkpoint;
+  }
+
+  //Simulates every trajectory of a simulation on up to simulation -> number_threads threads
+  //Each thread constructs its own TrajectorySimulator(simulation, args...) to hold its scratch buffers,
+  //TrajectorySimulator :: simulate(trajectory_number, trajectory) fills the trajectory, indexed by [timestep][species],
+  //and returns the time it stopped at, trajectory 0's is kept as simulation -> current_time. Each simulator's counters are added to simulation -> counters. With simulation -> statistics, each thread simulates into one scratch trajectory
+  //and accumulates its finished trajectories, the threads' statistics are merged once all are done. With simulation -> record_changes
+  //or record_every, every timestep of the trajectory a thread simulates into is the same scratch row, holding the last recorded state.
+  //Simulators of a simulation -> continuous simulation ignore the trajectory and record into simulation -> concentrations.
+  template<typename TrajectorySimulator, typename... Args>
+  void simulate_trajectories(Simulation* simulation, Args... args){
+    signal(SIGINT, signalHandler) ;
+
+    if(simulation){
+      unsigned int number_threads = simulation -> number_threads;
+      if(number_threads > simulation -> number_trajectories){
+	number_threads = simulation -> number_trajectories;
+      }
+      if(number_threads < 1){
+	number_threads = 1;
+      }
+      unsigned int number_observed = simulation -> number_observed;
+      std :: vector<TrajectoryStatistics> thread_statistics;
+      if(simulation -> statistics){
+	thread_statistics.assign(number_threads, *(simulation -> statistics));
+      }
+      //Trajectories are handed out one at a time, each writes only its own slice of trajectories_1D
+      std :: atomic<unsigned int> next_trajectory(0);
+      std :: mutex counters_mutex;
+      auto simulate_thread = [&](unsigned int thread_number){
+	TrajectorySimulator simulator(simulation, args...);
+	std :: vector<unsigned int> scratch_populations;
+	Trajectory scratch_trajectory = {nullptr, 0};
+	if(simulation -> statistics){
+	  scratch_populations.resize((size_t) simulation -> number_timesteps * number_observed);
+	  scratch_trajectory = {scratch_populations.data(), number_observed};
+	}else if(simulation -> record_changes || simulation -> record_every){
+	  scratch_populations.resize(number_observed);
+	  scratch_trajectory = {scratch_populations.data(), 0};
+	}
+	for(unsigned int trajectory_number = next_trajectory++; trajectory_number < simulation -> number_trajectories; trajectory_number = next_trajectory++){
+	  if(interrupted){
+	    break ;
+	  }
+	  Trajectory trajectory = simulation -> trajectories_1D ? simulation -> trajectory(trajectory_number) : scratch_trajectory;
+	  unsigned long long events = simulator.counters.events;
+	  double stop_time = simulator.simulate(trajectory_number, trajectory);
+	  if(simulation -> profile){
+	    simulation -> trajectory_events[trajectory_number] = simulator.counters.events - events;
+	  }
+	  if(simulation -> stream && !interrupted){
+	    simulation -> stream -> write(*simulation, trajectory_number, trajectory[0]);
+	  }
+	  //Trajectories cut short by an interrupt are left out of the statistics
+	  if(simulation -> statistics && !interrupted){
+	    thread_statistics[thread_number].add(trajectory[0]);
+	  }
+	  //The stop time reported is trajectory 0's, the trajectory the results of an interrupted run are cut short by
+	  if(trajectory_number == 0){
+	    simulation -> current_time = stop_time;
+	  }
+	}
+	std :: lock_guard<std :: mutex> lock(counters_mutex);
+	simulation -> counters.add(simulator.counters);
+      };
+      if(number_threads == 1){
+	simulate_thread(0);
+      }else{
+	std :: vector<std :: thread> threads;
+	for(unsigned int i = 0; i < number_threads; i++){
+	  threads.emplace_back(simulate_thread, i);
+	}
+	for(std :: thread& thread : threads){
+	  thread.join();
+	}
+      }
+      for(TrajectoryStatistics& statistics : thread_statistics){
+	simulation -> statistics -> merge(statistics);
+      }
+    }//end if simulation pointer not null
+  }
+
+  //Direct method, with per-thread scratch buffers for the current state and propensities
+  template<typename PropensityFunction>
+  class DirectMethod{
+  public:
+    EngineCounters counters;
+
+    DirectMethod(Simulation* simulation) :
+      simulation(simulation),
+      profiler(counters, (simulation -> model) -> number_reactions),
+      current_state(new unsigned int[(simulation -> model) -> number_species]),
+      propensity_values(new double[(simulation -> model) -> number_reactions])
+    {}
+
+    double simulate(unsigned int trajectory_number, Trajectory trajectory){
+      Model* model = simulation -> model;
+      TrajectoryRng rng = simulation_rng(simulation, trajectory_number);
+      propensity_function = static_cast<PropensityFunction*>(simulation -> trajectory_propensity_function(trajectory_number));
+      double current_time;
+      unsigned int entry_count;
+      start_trajectory(simulation, trajectory_number, trajectory, current_state.get(), current_time, entry_count, rng);
+      //Generator at the start of the step, kept to checkpoint the step that passes the end time
+      TrajectoryRng step_rng = rng;
+      //calculate initial propensities
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	propensity_values[reaction_number] = propensity_function -> evaluate(reaction_number, current_state.get());
+      }
+      counters.propensity_evaluations += model -> number_reactions;
+      double propensity_sum;
+      while(current_time < (simulation -> end_time)){
+	if(interrupted){
+	  save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state.get(), rng);
+	  break ;
+	}
+	profiler.start();
+	//Sum propensities
+	propensity_sum = 0;
+	for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	  propensity_sum += propensity_values[reaction_number];
+	}
+	//No more reactions
+	if(propensity_sum <= 0){
+	  save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state.get(), rng);
+	  //Copy all of last changed state for rest of entries
+	  fill_trajectory(simulation, trajectory_number, trajectory, entry_count, current_state.get());
+	  profiler.lap(&EngineCounters :: output_seconds);
+	  //Quit simulating this trajectory
+	  break;
+	}//End if no more reactions
+
+	//Reaction will fire, determine which one
+	if(simulation -> save_checkpoints){
+	  step_rng = rng;
+	}
+	double step_time = current_time;
+	double cumulative_sum = rng.uniform() * propensity_sum;
+	current_time += rng.exponential() / propensity_sum;
+	if(current_time >= simulation -> end_time){
+	  save_checkpoint(simulation, trajectory_number, step_time, entry_count, current_state.get(), step_rng);
+	}
+	profiler.lap(&EngineCounters :: selection_seconds);
+	//Copy current state to passed timesteps
+	entry_count = record_state(simulation, trajectory_number, trajectory, entry_count, current_time, current_state.get());
+	profiler.lap(&EngineCounters :: output_seconds);
+
+	for(unsigned int potential_reaction = 0; potential_reaction < model -> number_reactions; potential_reaction++){
+	  cumulative_sum -= propensity_values[potential_reaction];
+	  //This reaction fired
+	  if (cumulative_sum <= 0 && propensity_values[potential_reaction] > 0){
+	    profiler.lap(&EngineCounters :: selection_seconds);
+	    //Update current state
+	    fire_reaction(model, potential_reaction, current_state.get());
+	    unsigned int fan_out = model -> affected_offsets[potential_reaction + 1] - model -> affected_offsets[potential_reaction];
+	    counters.events++;
+	    counters.propensity_evaluations += fan_out;
+	    profiler.fired(potential_reaction, 1, fan_out);
+	    record_event(simulation, trajectory_number, current_time, current_state.get());
+	    //Recalculate needed propensities
+	    for(unsigned int i = model -> affected_offsets[potential_reaction]; i < model -> affected_offsets[potential_reaction + 1]; i++){
+	      unsigned int affected_reaction = model -> affected_reactions[i];
+	      propensity_values[affected_reaction] = propensity_function -> evaluate(affected_reaction, current_state.get());
+	    }
+	    profiler.lap(&EngineCounters :: update_seconds);
+	    break;
+	  }//Finished updating state/propensities with this reaction
+	}//Finished checking for which reaction fired at this time
+      }//Simulation has reached end time
+      return current_time;
+    }
+
+  private:
+    Simulation* simulation;
+    EngineProfiler profiler;
+    PropensityFunction* propensity_function;
+    //Current state
+    std :: unique_ptr<unsigned int[]> current_state;
+    //Calculated propensity values for current state
+    std :: unique_ptr<double[]> propensity_values;
+  };
+
+  //Binary min-heap of reaction firing times, indexed by reaction so a firing time can be changed in place
+  class ReactionQueue{
+  public:
+    ReactionQueue(unsigned int number_reactions) : firing_times(number_reactions), heap(number_reactions), position(number_reactions) {}
+
+    //Sets a firing time without restoring the heap, call build once all are set
+    void set(unsigned int reaction_number, double firing_time){
+      firing_times[reaction_number] = firing_time;
+    }
+
+    void build();
+
+    unsigned int top() const{
+      return heap[0];
+    }
+
+    double time(unsigned int reaction_number) const{
+      return firing_times[reaction_number];
+    }
+
+    //Firing time of each reaction, indexed by reaction
+    const double* times() const{
+      return firing_times.data();
+    }
+
+    void update(unsigned int reaction_number, double firing_time);
+
+  private:
+    std :: vector<double> firing_times;
+    std :: vector<unsigned int> heap;
+    std :: vector<unsigned int> position;
+
+    void swap(unsigned int i, unsigned int j);
+    void sift_up(unsigned int i);
+    void sift_down(unsigned int i);
+  };
+
+  //Next reaction method, each reaction keeps an absolute firing time in a ReactionQueue
+  //Only reactions in the fired reaction's dependency graph row are re-evaluated and rescheduled
+  template<typename PropensityFunction>
+  class NextReactionMethod{
+  public:
+    EngineCounters counters;
+
+    NextReactionMethod(Simulation* simulation) :
+      simulation(simulation),
+      profiler(counters, (simulation -> model) -> number_reactions),
+      current_state(new unsigned int[(simulation -> model) -> number_species]),
+      propensity_values(new double[(simulation -> model) -> number_reactions]),
+      queue((simulation -> model) -> number_reactions)
+    {}
+
+    double simulate(unsigned int trajectory_number, Trajectory trajectory){
+      Model* model = simulation -> model;
+      const double never = std :: numeric_limits<double> :: infinity();
+      TrajectoryRng rng = simulation_rng(simulation, trajectory_number);
+      propensity_function = static_cast<PropensityFunction*>(simulation -> trajectory_propensity_function(trajectory_number));
+      double current_time;
+      unsigned int entry_count;
+      const TrajectoryCheckpoint* checkpoint = start_trajectory(simulation, trajectory_number, trajectory, current_state.get(), current_time, entry_count, rng);
+      if(model -> number_reactions == 0){
+	fill_trajectory(simulation, trajectory_number, trajectory, entry_count, current_state.get());
+	return current_time;
+      }
+      //calculate initial propensities and firing times, or take the firing times of the checkpoint resumed from
+      bool resume_firing_times = checkpoint && !checkpoint -> firing_times.empty();
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	propensity_values[reaction_number] = propensity_function -> evaluate(reaction_number, current_state.get());
+	if(resume_firing_times){
+	  queue.set(reaction_number, checkpoint -> firing_times[reaction_number]);
+	}else{
+	  queue.set(reaction_number, propensity_values[reaction_number] > 0 ? current_time + rng.exponential() / propensity_values[reaction_number] : never);
+	}
+      }
+      counters.propensity_evaluations += model -> number_reactions;
+      queue.build();
+      while(current_time < (simulation -> end_time)){
+	if(interrupted){
+	  save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state.get(), rng, queue.times());
+	  break ;
+	}
+	profiler.start();
+	unsigned int fired_reaction = queue.top();
+	//No more reactions
+	if(queue.time(fired_reaction) == never){
+	  save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state.get(), rng, queue.times());
+	  fill_trajectory(simulation, trajectory_number, trajectory, entry_count, current_state.get());
+	  profiler.lap(&EngineCounters :: output_seconds);
+	  break;
+	}
+	if(queue.time(fired_reaction) >= simulation -> end_time){
+	  save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state.get(), rng, queue.times());
+	}
+	current_time = queue.time(fired_reaction);
+	profiler.lap(&EngineCounters :: selection_seconds);
+	//Copy current state to passed timesteps
+	entry_count = record_state(simulation, trajectory_number, trajectory, entry_count, current_time, current_state.get());
+	profiler.lap(&EngineCounters :: output_seconds);
+	fire_reaction(model, fired_reaction, current_state.get());
+	unsigned int fan_out = model -> affected_offsets[fired_reaction + 1] - model -> affected_offsets[fired_reaction];
+	counters.events++;
+	counters.propensity_evaluations += fan_out;
+	profiler.fired(fired_reaction, 1, fan_out);
+	record_event(simulation, trajectory_number, current_time, current_state.get());
+	//Rescale firing times of affected reactions to their new propensities
+	for(unsigned int i = model -> affected_offsets[fired_reaction]; i < model -> affected_offsets[fired_reaction + 1]; i++){
+	  unsigned int affected_reaction = model -> affected_reactions[i];
+	  double old_propensity = propensity_values[affected_reaction];
+	  double new_propensity = propensity_function -> evaluate(affected_reaction, current_state.get());
+	  propensity_values[affected_reaction] = new_propensity;
+	  if(affected_reaction == fired_reaction){
+	    continue;
+	  }
+	  double firing_time;
+	  if(new_propensity <= 0){
+	    firing_time = never;
+	  }else if(old_propensity > 0){
+	    firing_time = current_time + (old_propensity / new_propensity) * (queue.time(affected_reaction) - current_time);
+	  }else{
+	    firing_time = current_time + rng.exponential() / new_propensity;
+	  }
+	  queue.update(affected_reaction, firing_time);
+	}
+	//The fired reaction always draws a new firing time
+	queue.update(fired_reaction, propensity_values[fired_reaction] > 0 ? current_time + rng.exponential() / propensity_values[fired_reaction] : never);
+	profiler.lap(&EngineCounters :: update_seconds);
+      }//Simulation has reached end time
+      return current_time;
+    }
+
+  private:
+    Simulation* simulation;
+    EngineProfiler profiler;
+    PropensityFunction* propensity_function;
+    std :: unique_ptr<unsigned int[]> current_state;
+    std :: unique_ptr<double[]> propensity_values;
+    ReactionQueue queue;
+  };
+
+  //Reactions grouped by the binary exponent of their propensity, group g holds propensities in [2^(g-1), 2^g)
+  //Keeps each group's sum and the total propensity up to date as single propensities change
+  class PropensityGroups{
+  public:
+    //Range of exponents returned by frexp for positive doubles
+    static const int min_exponent = std :: numeric_limits<double> :: min_exponent - std :: numeric_limits<double> :: digits;
+    static const int max_exponent = std :: numeric_limits<double> :: max_exponent;
+
+    double propensity_sum;
+
+    PropensityGroups(unsigned int number_reactions);
+
+    void clear();
+
+    bool empty() const{
+      return highest < lowest;
+    }
+
+    void update(unsigned int reaction_number, double propensity);
+    //Recomputes sums from the propensities, bounding rounding drift from incremental updates
+    void refresh();
+    //Composition: choose a group by its share of the total, rejection: choose uniformly within it
+    //and accept with probability propensity / group upper bound, which is at least 1/2
+    unsigned int select(TrajectoryRng& rng);
+
+  private:
+    struct Group{
+      double sum = 0;
+      std :: vector<unsigned int> members;
+    };
+    std :: vector<Group> groups;
+    std :: vector<int> reaction_group;
+    std :: vector<unsigned int> reaction_position;
+    std :: vector<double> propensities;
+    //Bounds of the non-empty groups
+    int lowest;
+    int highest;
+
+    static int group_index(double propensity);
+    void insert(unsigned int reaction_number, int group, double propensity);
+    void remove(unsigned int reaction_number, int group, double propensity);
+  };
+
+  //Composition-rejection method, reaction selection costs O(number of groups) instead of O(number of reactions)
+  template<typename PropensityFunction>
+  class CompositionRejectionMethod{
+  public:
+    EngineCounters counters;
+
+    CompositionRejectionMethod(Simulation* simulation) :
+      simulation(simulation),
+      profiler(counters, (simulation -> model) -> number_reactions),
+      current_state(new unsigned int[(simulation -> model) -> number_species]),
+      groups((simulation -> model) -> number_reactions)
+    {}
+
+    double simulate(unsigned int trajectory_number, Trajectory trajectory){
+      Model* model = simulation -> model;
+      TrajectoryRng rng = simulation_rng(simulation, trajectory_number);
+      propensity_function = static_cast<PropensityFunction*>(simulation -> trajectory_propensity_function(trajectory_number));
+      double current_time;
+      unsigned int entry_count;
+      start_trajectory(simulation, trajectory_number, trajectory, current_state.get(), current_time, entry_count, rng);
+      //Generator at the start of the step, kept to checkpoint the step that passes the end time
+      TrajectoryRng step_rng = rng;
+      groups.clear();
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	groups.update(reaction_number, propensity_function -> evaluate(reaction_number, current_state.get()));
+      }
+      counters.propensity_evaluations += model -> number_reactions;
+      unsigned int refresh_interval = model -> number_reactions > 0 ? model -> number_reactions : 1;
+      unsigned long long event_count = 0;
+      while(current_time < (simulation -> end_time)){
+	if(interrupted){
+	  save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state.get(), rng);
+	  break ;
+	}
+	profiler.start();
+	//No more reactions
+	if(groups.empty() || groups.propensity_sum <= 0){
+	  save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state.get(), rng);
+	  fill_trajectory(simulation, trajectory_number, trajectory, entry_count, current_state.get());
+	  profiler.lap(&EngineCounters :: output_seconds);
+	  break;
+	}
+	if(simulation -> save_checkpoints){
+	  step_rng = rng;
+	}
+	double step_time = current_time;
+	unsigned int fired_reaction = groups.select(rng);
+	current_time += rng.exponential() / groups.propensity_sum;
+	if(current_time >= simulation -> end_time){
+	  save_checkpoint(simulation, trajectory_number, step_time, entry_count, current_state.get(), step_rng);
+	}
+	profiler.lap(&EngineCounters :: selection_seconds);
+	//Copy current state to passed timesteps
+	entry_count = record_state(simulation, trajectory_number, trajectory, entry_count, current_time, current_state.get());
+	profiler.lap(&EngineCounters :: output_seconds);
+	fire_reaction(model, fired_reaction, current_state.get());
+	unsigned int fan_out = model -> affected_offsets[fired_reaction + 1] - model -> affected_offsets[fired_reaction];
+	counters.events++;
+	counters.propensity_evaluations += fan_out;
+	profiler.fired(fired_reaction, 1, fan_out);
+	record_event(simulation, trajectory_number, current_time, current_state.get());
+	for(unsigned int i = model -> affected_offsets[fired_reaction]; i < model -> affected_offsets[fired_reaction + 1]; i++){
+	  unsigned int affected_reaction = model -> affected_reactions[i];
+	  groups.update(affected_reaction, propensity_function -> evaluate(affected_reaction, current_state.get()));
+	}
+	if(++event_count % refresh_interval == 0){
+	  groups.refresh();
+	}
+	profiler.lap(&EngineCounters :: update_seconds);
+      }//Simulation has reached end time
+      return current_time;
+    }
+
+  private:
+    Simulation* simulation;
+    EngineProfiler profiler;
+    PropensityFunction* propensity_function;
+    std :: unique_ptr<unsigned int[]> current_state;
+    PropensityGroups groups;
+  };
+
+  //Coupled finite difference method, Anderson (2012) "An Efficient Finite Difference Method for Parameter Sensitivities
+  //of Continuous Time Markov Chains". Each trajectory simulates a base and a perturbed process together, splitting
+  //every reaction with base propensity a and perturbed propensity b into a channel of propensity min(a, b) firing in
+  //both, and one of |a - b| firing only in the process whose propensity is larger. Both processes keep their own law,
+  //while sharing most of their events, so their difference has a far lower variance than that of independent runs.
+  //A trajectory records the perturbed minus the base populations of each timestep, as int32 values in the unsigned slots.
+  //Trajectories of the base process start from their point's populations and use their point's propensity function.
+  template<typename PropensityFunction>
+  class CoupledDirectMethod{
+  public:
+    EngineCounters counters;
+
+    CoupledDirectMethod(Simulation* simulation, PropensityFunction* perturbed_function, const unsigned int* perturbed_populations) :
+      simulation(simulation),
+      perturbed_function(perturbed_function),
+      perturbed_populations(perturbed_populations),
+      base_state(new unsigned int[(simulation -> model) -> number_species]),
+      perturbed_state(new unsigned int[(simulation -> model) -> number_species]),
+      base_propensities(new double[(simulation -> model) -> number_reactions]),
+      perturbed_propensities(new double[(simulation -> model) -> number_reactions])
+    {}
+
+    double simulate(unsigned int trajectory_number, Trajectory trajectory){
+      Model* model = simulation -> model;
+      TrajectoryRng rng = simulation_rng(simulation, trajectory_number);
+      base_function = static_cast<PropensityFunction*>(simulation -> trajectory_propensity_function(trajectory_number));
+      initial_populations(simulation, trajectory_number, base_state.get());
+      std :: copy(perturbed_populations, perturbed_populations + model -> number_species, perturbed_state.get());
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	base_propensities[reaction_number] = base_function -> evaluate(reaction_number, base_state.get());
+	perturbed_propensities[reaction_number] = perturbed_function -> evaluate(reaction_number, perturbed_state.get());
+      }
+      counters.propensity_evaluations += 2 * model -> number_reactions;
+      double current_time = 0;
+      unsigned int entry_count = record_difference(trajectory, 0, current_time);
+      while(current_time < (simulation -> end_time)){
+	if(interrupted){
+	  break ;
+	}
+	//Each reaction's three channels together fire at the larger of its two propensities
+	double propensity_sum = 0;
+	for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	  propensity_sum += std :: max(base_propensities[reaction_number], perturbed_propensities[reaction_number]);
+	}
+	//No more reactions in either process
+	if(propensity_sum <= 0){
+	  record_difference(trajectory, entry_count, std :: numeric_limits<double> :: infinity());
+	  break;
+	}
+	double cumulative_sum = rng.uniform() * propensity_sum;
+	current_time += rng.exponential() / propensity_sum;
+	entry_count = record_difference(trajectory, entry_count, current_time);
+
+	for(unsigned int potential_reaction = 0; potential_reaction < model -> number_reactions; potential_reaction++){
+	  double base_propensity = base_propensities[potential_reaction];
+	  double perturbed_propensity = perturbed_propensities[potential_reaction];
+	  double channel_sum = std :: max(base_propensity, perturbed_propensity);
+	  cumulative_sum -= channel_sum;
+	  //This reaction fired, in the shared channel if the draw falls within the smaller propensity
+	  if(cumulative_sum <= 0 && channel_sum > 0){
+	    double position = cumulative_sum + channel_sum;
+	    bool shared = position <= std :: min(base_propensity, perturbed_propensity);
+	    //One event of the coupled process, fired in one or both processes
+	    counters.events++;
+	    if(shared || base_propensity > perturbed_propensity){
+	      fire(potential_reaction, base_state.get(), base_propensities.get(), base_function);
+	    }
+	    if(shared || perturbed_propensity > base_propensity){
+	      fire(potential_reaction, perturbed_state.get(), perturbed_propensities.get(), perturbed_function);
+	    }
+	    break;
+	  }
+	}
+      }//Simulation has reached end time
+      return current_time;
+    }
+
+  private:
+    Simulation* simulation;
+    PropensityFunction* base_function;
+    PropensityFunction* perturbed_function;
+    const unsigned int* perturbed_populations;
+    std :: unique_ptr<unsigned int[]> base_state;
+    std :: unique_ptr<unsigned int[]> perturbed_state;
+    std :: unique_ptr<double[]> base_propensities;
+    std :: unique_ptr<double[]> perturbed_propensities;
+
+    //Fires a reaction in one process and updates the propensities it affects
+    void fire(unsigned int reaction_number, unsigned int* state, double* propensities, PropensityFunction* propensity_function){
+      Model* model = simulation -> model;
+      fire_reaction(model, reaction_number, state);
+      counters.propensity_evaluations += model -> affected_offsets[reaction_number + 1] - model -> affected_offsets[reaction_number];
+      for(unsigned int i = model -> affected_offsets[reaction_number]; i < model -> affected_offsets[reaction_number + 1]; i++){
+	unsigned int affected_reaction = model -> affected_reactions[i];
+	propensities[affected_reaction] = propensity_function -> evaluate(affected_reaction, state);
+      }
+    }
+
+    //Writes the difference of the processes' observed populations to every timestep passed by current_time, returns the updated entry count
+    unsigned int record_difference(Trajectory trajectory, unsigned int entry_count, double current_time){
+      while(entry_count < simulation -> number_timesteps && (simulation -> timeline[entry_count]) <= current_time){
+	unsigned int* timestep = trajectory[entry_count];
+	for(unsigned int column = 0; column < simulation -> number_observed; column++){
+	  unsigned int species = simulation -> observed(column);
+	  timestep[column] = perturbed_state[species] - base_state[species];
+	}
+	entry_count++;
+      }
+      return entry_count;
+    }
+  };
+
+  //Gillespie's direct method
+  template<typename PropensityFunction = IPropensityFunction>
+  void ssa_direct(Simulation* simulation){
+    simulate_trajectories<DirectMethod<PropensityFunction>>(simulation);
+  }//end ssa_direct
+
+  //Gibson-Bruck next reaction method, firing times are kept in an indexed priority queue
+  template<typename PropensityFunction = IPropensityFunction>
+  void ssa_next_reaction(Simulation* simulation){
+    simulate_trajectories<NextReactionMethod<PropensityFunction>>(simulation);
+  }//end ssa_next_reaction
+
+  //Composition-rejection method, propensities are grouped by powers of two
+  template<typename PropensityFunction = IPropensityFunction>
+  void ssa_composition_rejection(Simulation* simulation){
+    simulate_trajectories<CompositionRejectionMethod<PropensityFunction>>(simulation);
+  }//end ssa_composition_rejection
+
+  //Coupled finite difference of a perturbed process, starting from perturbed_populations and simulated with perturbed_function,
+  //and the simulation's own, trajectories hold the perturbed minus the base populations
+  template<typename PropensityFunction = IPropensityFunction>
+  void ssa_coupled_difference(Simulation* simulation, PropensityFunction* perturbed_function, const unsigned int* perturbed_populations){
+    simulate_trajectories<CoupledDirectMethod<PropensityFunction>>(simulation, perturbed_function, perturbed_populations);
+  }//end ssa_coupled_difference
 }
+#endif
@@ -0,0 +1,93 @@
+#include "statistics.h"
+#include <algorithm>
+
+namespace Gillespy{
+
+  TrajectoryStatistics :: TrajectoryStatistics(unsigned int number_timesteps, unsigned int number_species, bool keep_histograms) :
+    count(0),
+    number_entries(number_timesteps * number_species),
+    keep_histograms(keep_histograms),
+    sums(number_entries, 0),
+    squared_sums(number_entries, 0)
+  {
+    if(keep_histograms){
+      bin_shift.assign(number_entries, 0);
+      histograms.assign((size_t) number_entries * histogram_bins, 0);
+    }
+  }
+
+  void TrajectoryStatistics :: add(const unsigned int* populations){
+    count++;
+    for(unsigned int entry = 0; entry < number_entries; entry++){
+      uint64_t population = populations[entry];
+      sums[entry] += population;
+      squared_sums[entry] += population * population;
+      if(keep_histograms){
+	unsigned int shift = bin_shift[entry];
+	while((populations[entry] >> shift) >= histogram_bins){
+	  shift++;
+	}
+	widen(entry, shift);
+	histograms[(size_t) entry * histogram_bins + (populations[entry] >> shift)]++;
+      }
+    }
+  }
+
+  void TrajectoryStatistics :: merge(const TrajectoryStatistics& other){
+    if(other.count == 0){
+      return;
+    }
+    for(unsigned int entry = 0; entry < number_entries; entry++){
+      sums[entry] += other.sums[entry];
+      squared_sums[entry] += other.squared_sums[entry];
+      if(keep_histograms){
+	unsigned int shift = std :: max(bin_shift[entry], other.bin_shift[entry]);
+	widen(entry, shift);
+	const uint32_t* other_bins = &other.histograms[(size_t) entry * histogram_bins];
+	uint32_t* bins = &histograms[(size_t) entry * histogram_bins];
+	unsigned int scale = shift - other.bin_shift[entry];
+	for(unsigned int i = 0; i < histogram_bins; i++){
+	  bins[i >> scale] += other_bins[i];
+	}
+      }
+    }
+    count += other.count;
+  }
+
+  double TrajectoryStatistics :: quantile(unsigned int entry, double probability) const{
+    if(!keep_histograms || count == 0){
+      return 0;
+    }
+    const uint32_t* bins = &histograms[(size_t) entry * histogram_bins];
+    unsigned int shift = bin_shift[entry];
+    double target = probability * count;
+    double cumulative = 0;
+    unsigned int last = 0;
+    for(unsigned int i = 0; i < histogram_bins; i++){
+      if(bins[i] == 0){
+	continue;
+      }
+      last = i;
+      if(cumulative + bins[i] >= target){
+	if(shift == 0){
+	  return i;
+	}
+	return (double) (i << shift) + (double) (1u << shift) * std :: max(0.0, target - cumulative) / bins[i];
+      }
+      cumulative += bins[i];
+    }
+    return (double) (last << shift);
+  }
+
+  //Doubles the width of an entry's bins until they are 2^shift wide, summing neighbouring bins
+  void TrajectoryStatistics :: widen(unsigned int entry, unsigned int shift){
+    uint32_t* bins = &histograms[(size_t) entry * histogram_bins];
+    while(bin_shift[entry] < shift){
+      for(unsigned int i = 0; i < histogram_bins / 2; i++){
+	bins[i] = bins[2 * i] + bins[2 * i + 1];
+      }
+      std :: fill(bins + histogram_bins / 2, bins + histogram_bins, 0);
+      bin_shift[entry]++;
+    }
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef GILLESPY_STATISTICS
+#define GILLESPY_STATISTICS
+#include <cstdint>
+#include <vector>
+
+//Summary statistics of an ensemble, accumulated one finished trajectory at a time so the
+//trajectories themselves need not be stored. Memory is O(timesteps * species), times the
+//histogram size when quantiles are kept.
+namespace Gillespy{
+
+  class TrajectoryStatistics{
+  public:
+    //Number of bins in each histogram, populations below it are counted exactly
+    static const unsigned int histogram_bins = 256;
+
+    //Trajectories accumulated so far
+    unsigned int count;
+
+    TrajectoryStatistics(unsigned int number_timesteps, unsigned int number_species, bool keep_histograms);
+
+    //Adds a finished trajectory's populations, number_species per timestep in order
+    void add(const unsigned int* populations);
+    //Combines the statistics of a disjoint set of trajectories into these
+    void merge(const TrajectoryStatistics& other);
+
+    //Entries are indexed by timestep * number_species + species
+    double mean(unsigned int entry) const{
+      return count > 0 ? (double) sums[entry] / count : 0;
+    }
+    //Sample variance, 0 with fewer than two trajectories. count * squared_sums - sums^2 is exact, as count < 2^32 and
+    //populations are below 2^32, so the variance is rounded once.
+    double variance(unsigned int entry) const{
+      if(count < 2){
+	return 0;
+      }
+      unsigned __int128 sum = sums[entry];
+      return (double) (count * squared_sums[entry] - sum * sum) / ((double) count * (count - 1));
+    }
+    //Exact sum of the populations and of their squares, which the statistics of shards of an ensemble are reduced by
+    uint64_t sum(unsigned int entry) const{
+      return sums[entry];
+    }
+    unsigned __int128 squared_sum(unsigned int entry) const{
+      return squared_sums[entry];
+    }
+    //Smallest population whose cumulative share of the trajectories is at least probability, exact for
+    //populations below histogram_bins and linearly interpolated within a bin above, 0 without histograms
+    double quantile(unsigned int entry, double probability) const;
+
+  private:
+    unsigned int number_entries;
+    bool keep_histograms;
+    //Populations are summed exactly, in integers, so the statistics do not depend on the order trajectories are added
+    //or merged in, such as by the number of threads simulating them
+    std :: vector<uint64_t> sums;
+    std :: vector<unsigned __int128> squared_sums;
+    //Bins of each entry's histogram are 2^bin_shift populations wide, widened to hold the largest population seen
+    std :: vector<unsigned int> bin_shift;
+    std :: vector<uint32_t> histograms;
+
+    void widen(unsigned int entry, unsigned int shift);
+  };
+}
+#endif
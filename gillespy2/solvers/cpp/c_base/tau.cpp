@@ -0,0 +1,152 @@
+#include "tau.h"
+#include <algorithm>
+#include <limits>
+
+namespace Gillespy{
+
+  TauArgs initialize_tau_args(Model& model){
+    TauArgs tau_args;
+    tau_args.HOR.assign(model.number_species, 0);
+    tau_args.g_form.assign(model.number_species, 0);
+    tau_args.reaction_reactants.resize(model.number_reactions);
+    tau_args.critical_threshold = 10;
+    tau_args.mu_i.assign(model.number_species, 0);
+    tau_args.sigma_i.assign(model.number_species, 0);
+    std :: vector<bool> is_reactant(model.number_species, false);
+
+    for(unsigned int reaction_number = 0; reaction_number < model.number_reactions; reaction_number++){
+      //Calculate this reaction's order
+      int reaction_order = 0;
+      for(const SpeciesCount* reactant = model.reactants.begin(reaction_number); reactant != model.reactants.end(reaction_number); reactant++){
+	if(reactant -> count > 0){
+	  tau_args.reaction_reactants[reaction_number].push_back(std :: make_pair(reactant -> species, reactant -> count));
+	  reaction_order += reactant -> count;
+	}
+      }
+      for(auto& reactant : tau_args.reaction_reactants[reaction_number]){
+	unsigned int species_number = reactant.first;
+	int count = reactant.second;
+	is_reactant[species_number] = true;
+	//If this reaction's order is higher than previous, set HOR
+	if(reaction_order > tau_args.HOR[species_number]){
+	  tau_args.HOR[species_number] = reaction_order;
+	  if(count == 2 && reaction_order == 2){
+	    tau_args.g_form[species_number] = 1;
+	  }else if(count == 2 && reaction_order == 3){
+	    tau_args.g_form[species_number] = 2;
+	  }else if(count == 3){
+	    tau_args.g_form[species_number] = 3;
+	  }else{
+	    tau_args.g_form[species_number] = 0;
+	  }
+	}
+      }
+    }
+    for(unsigned int species_number = 0; species_number < model.number_species; species_number++){
+      if(is_reactant[species_number]){
+	tau_args.reactants.push_back(species_number);
+      }
+    }
+    return tau_args;
+  }
+
+  double select_tau(TauArgs& tau_args, double tau_tol, double current_time, double save_time, const double* propensity_values, const unsigned int* current_state){
+    unsigned int number_reactions = tau_args.reaction_reactants.size();
+    bool critical = false; //system-wide flag, true when any reaction is critical
+    double critical_tau = 0; //holds the smallest tau time for critical reactions
+    double non_critical_tau = 0; //holds the smallest tau time for non-critical reactions
+    bool non_critical_found = false;
+    double tau;
+
+    //Determine if there are any critical reactions
+    for(unsigned int reaction_number = 0; reaction_number < number_reactions && !critical; reaction_number++){
+      if(propensity_values[reaction_number] <= 0){
+	continue;
+      }
+      for(auto& reactant : tau_args.reaction_reactants[reaction_number]){
+	if((double) current_state[reactant.first] / reactant.second < tau_args.critical_threshold){
+	  critical = true;
+	  break;
+	}
+      }
+    }
+
+    //If a critical reaction is present, estimate tau for a single firing of each
+    //reaction with propensity > 0, and take the smallest tau
+    if(critical){
+      critical_tau = std :: numeric_limits<double> :: infinity();
+      for(unsigned int reaction_number = 0; reaction_number < number_reactions; reaction_number++){
+	if(propensity_values[reaction_number] > 0){
+	  critical_tau = std :: min(critical_tau, 1 / propensity_values[reaction_number]);
+	}
+      }
+    }
+
+    //Calculate abs mean and standard deviation for each reactant
+    for(unsigned int species_number : tau_args.reactants){
+      tau_args.mu_i[species_number] = 0;
+      tau_args.sigma_i[species_number] = 0;
+    }
+    for(unsigned int reaction_number = 0; reaction_number < number_reactions; reaction_number++){
+      for(auto& reactant : tau_args.reaction_reactants[reaction_number]){
+	tau_args.mu_i[reactant.first] += reactant.second * propensity_values[reaction_number]; //Cao, Gillespie, Petzold 32a
+	tau_args.sigma_i[reactant.first] += reactant.second * reactant.second * propensity_values[reaction_number]; //Cao, Gillespie, Petzold 32b
+      }
+    }
+
+    for(unsigned int species_number : tau_args.reactants){
+      if(tau_args.mu_i[species_number] <= 0){
+	continue;
+      }
+      //Relative error allowance of the species, g_i is evaluated at the current population
+      double x = current_state[species_number];
+      double g_i = tau_args.HOR[species_number];
+      switch(tau_args.g_form[species_number]){
+      case 1:
+	if(x > 1){
+	  g_i = 2 + 1 / (x - 1);
+	}
+	break;
+      case 2:
+	if(x > 1){
+	  g_i = 1.5 * (2 + 1 / (x - 1));
+	}
+	break;
+      case 3:
+	if(x > 2){
+	  g_i = 3 + 1 / (x - 1) + 2 / (x - 2);
+	}
+	break;
+      }
+      double max_pop_change = std :: max(tau_tol / g_i * x, 1.0);
+      //Cao, Gillespie, Petzold 33
+      double tau_i = std :: min(max_pop_change / tau_args.mu_i[species_number], max_pop_change * max_pop_change / tau_args.sigma_i[species_number]);
+      if(!non_critical_found || tau_i < non_critical_tau){
+	non_critical_tau = tau_i;
+	non_critical_found = true;
+      }
+    }
+
+    //If all reactions are non-critical, use non-critical tau
+    if(!critical){
+      tau = non_critical_tau;
+    //If all reactions are critical, use critical tau
+    }else if(!non_critical_found){
+      tau = critical_tau;
+    //If there are both critical and non-critical reactions,
+    //take the shortest tau between critical and non-critical
+    }else{
+      tau = std :: min(non_critical_tau, critical_tau);
+    }
+    //If selected tau exceeds save time, integrate to save time
+    if(tau > 0){
+      tau = std :: max(tau, 1e-10); //set minimum to prevent integration errors
+      if(save_time - current_time > 0){
+	tau = std :: min(tau, save_time - current_time);
+      }
+    }else{
+      tau = save_time - current_time;
+    }
+    return tau;
+  }
+}
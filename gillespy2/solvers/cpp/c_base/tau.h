@@ -0,0 +1,33 @@
+#ifndef GILLESPY_TAU
+#define GILLESPY_TAU
+#include "model.h"
+#include <utility>
+#include <vector>
+
+//Initialization and selection methods for the tau-leaping step size, as in gillespy2/solvers/utilities/Tau.py.
+//Based on Cao, Y.; Gillespie, D. T.; Petzold, L. R. (2006). "Efficient step size selection for the tau-leaping
+//simulation method". The Journal of Chemical Physics. 124 (4): 044109. doi:10.1063/1.2159468
+namespace Gillespy{
+
+  struct TauArgs{
+    //Highest order reaction of each species
+    std :: vector<int> HOR;
+    //Form of the relative error allowance denominator g_i of each species:
+    //0 for g_i = HOR, 1 for 2 + 1/(x-1), 2 for 3/2 * (2 + 1/(x-1)), 3 for 3 + 1/(x-1) + 2/(x-2)
+    std :: vector<int> g_form;
+    //All species in the model which act as reactants
+    std :: vector<unsigned int> reactants;
+    //Species consumed by each reaction, with their counts
+    std :: vector<std :: vector<std :: pair<unsigned int, int>>> reaction_reactants;
+    //Reactant population to be considered critical
+    int critical_threshold;
+    //Scratch space for the mean and variance of each species' change, Cao, Gillespie, Petzold 32a and 32b
+    std :: vector<double> mu_i;
+    std :: vector<double> sigma_i;
+  };
+
+  TauArgs initialize_tau_args(Model& model);
+  //Returns the tau step to take from current_time, never past save_time
+  double select_tau(TauArgs& tau_args, double tau_tol, double current_time, double save_time, const double* propensity_values, const unsigned int* current_state);
+}
+#endif
@@ -0,0 +1,129 @@
+#ifndef GILLESPY_TAU_LEAPING
+#define GILLESPY_TAU_LEAPING
+#include "model.h"
+#include "ssa.h"
+#include "tau.h"
+#include <random>//Included for poisson distribution
+
+namespace Gillespy{
+
+  //Tau-leaping method, with per-thread scratch buffers and tau selection state
+  template<typename PropensityFunction>
+  class TauLeapingMethod{
+  public:
+    EngineCounters counters;
+
+    TauLeapingMethod(Simulation* simulation, double tau_tol) :
+      simulation(simulation),
+      profiler(counters, (simulation -> model) -> number_reactions),
+      tau_tol(tau_tol),
+      tau_args(initialize_tau_args(*(simulation -> model))),
+      current_state(new unsigned int[(simulation -> model) -> number_species]),
+      leap_state(new long long[(simulation -> model) -> number_species]),
+      propensity_values(new double[(simulation -> model) -> number_reactions]),
+      leap_firings(new long long[(simulation -> model) -> number_reactions])
+    {}
+
+    double simulate(unsigned int trajectory_number, Trajectory trajectory){
+      Model* model = simulation -> model;
+      TrajectoryRng rng = simulation_rng(simulation, trajectory_number);
+      propensity_function = static_cast<PropensityFunction*>(simulation -> trajectory_propensity_function(trajectory_number));
+      double current_time;
+      unsigned int entry_count;
+      start_trajectory(simulation, trajectory_number, trajectory, current_state.get(), current_time, entry_count, rng);
+      //Each save step
+      for(; entry_count < simulation -> number_timesteps; entry_count++){
+	double save_time = simulation -> timeline[entry_count];
+	//Until save step reached
+	while(current_time < save_time){
+	  if(interrupted){
+	    save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state.get(), rng);
+	    return current_time;
+	  }
+	  profiler.start();
+	  for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	    propensity_values[reaction_number] = propensity_function -> evaluate(reaction_number, current_state.get());
+	  }
+	  counters.propensity_evaluations += model -> number_reactions;
+	  profiler.lap(&EngineCounters :: update_seconds);
+	  double tau_step = select_tau(tau_args, tau_tol, current_time, save_time, propensity_values.get(), current_state.get());
+	  profiler.lap(&EngineCounters :: selection_seconds);
+	  //Leap, rejecting steps which drive a population negative and retrying with half the step
+	  while(!leap(tau_step, rng)){
+	    tau_step /= 2;
+	  }
+	  counters.events++;
+	  for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	    profiler.fired(reaction_number, leap_firings[reaction_number], 0);
+	  }
+	  for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	    current_state[species_number] = leap_state[species_number];
+	  }
+	  //Snap to the save time so rounding cannot add a vanishing extra step
+	  current_time = (current_time + tau_step < save_time) ? current_time + tau_step : save_time;
+	  record_event(simulation, trajectory_number, current_time, current_state.get());
+	  profiler.lap(&EngineCounters :: update_seconds);
+	}
+	//Save step reached
+	profiler.start();
+	record_state(simulation, trajectory_number, trajectory, entry_count, save_time, current_state.get());
+	profiler.lap(&EngineCounters :: output_seconds);
+      }
+      save_checkpoint(simulation, trajectory_number, current_time, entry_count, current_state.get(), rng);
+      return current_time;
+    }
+
+  private:
+    //Fires each reaction a Poisson distributed number of times over tau_step into leap_state,
+    //returns false if any population would become negative
+    bool leap(double tau_step, TrajectoryRng& rng){
+      Model* model = simulation -> model;
+      for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	leap_state[species_number] = current_state[species_number];
+      }
+      for(unsigned int reaction_number = 0; reaction_number < model -> number_reactions; reaction_number++){
+	leap_firings[reaction_number] = 0;
+	if(propensity_values[reaction_number] <= 0){
+	  continue;
+	}
+	std :: poisson_distribution<long long> firings(propensity_values[reaction_number] * tau_step);
+	long long reaction_count = firings(rng);
+	leap_firings[reaction_number] = reaction_count;
+	if(reaction_count == 0){
+	  continue;
+	}
+	for(const SpeciesCount* change = model -> species_changes.begin(reaction_number); change != model -> species_changes.end(reaction_number); change++){
+	  leap_state[change -> species] += reaction_count * change -> count;
+	}
+      }
+      for(unsigned int species_number = 0; species_number < model -> number_species; species_number++){
+	if(leap_state[species_number] < 0){
+	  return false;
+	}
+      }
+      return true;
+    }
+
+    Simulation* simulation;
+    EngineProfiler profiler;
+    PropensityFunction* propensity_function;
+    double tau_tol;
+    TauArgs tau_args;
+    //Current state
+    std :: unique_ptr<unsigned int[]> current_state;
+    //State after a proposed leap, signed so rejected leaps can be detected
+    std :: unique_ptr<long long[]> leap_state;
+    //Calculated propensity values for current state
+    std :: unique_ptr<double[]> propensity_values;
+    //Times each reaction fired in the last proposed leap
+    std :: unique_ptr<long long[]> leap_firings;
+  };
+
+  //Tau-leaping method, fires a Poisson number of each reaction over steps chosen by Cao et al. tau selection
+  //tau_tol bounds the relative change in each reactant's population over a step
+  template<typename PropensityFunction = IPropensityFunction>
+  void tau_leaper(Simulation* simulation, double tau_tol){
+    simulate_trajectories<TauLeapingMethod<PropensityFunction>>(simulation, tau_tol);
+  }//end tau_leaper
+}
+#endif
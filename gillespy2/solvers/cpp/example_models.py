@@ -1,5 +1,6 @@
 from gillespy2.core import Model, Species, Reaction, Parameter
 import numpy as np
+import random
 
 
 class Example(Model):
@@ -22,5 +23,86 @@ class Example(Model):
         self.timespan(np.linspace(0, 20, 101))
 
 
-__all__ = ['Trichloroethylene', 'LacOperon', 'Schlogl', 'MichaelisMenten',
-           'ToggleSwitch', 'Example', 'Tyson2StateOscillator', 'Oregonator']
+class Dimerization(Model):
+    """
+    Reversible dimerization of a monomer, a small and fast network.
+    """
+
+    def __init__(self, parameter_values=None):
+        Model.__init__(self, name="Dimerization")
+        # Parameters
+        k_c = Parameter(name='k_c', expression=0.005)
+        k_d = Parameter(name='k_d', expression=0.08)
+        self.add_parameter([k_c, k_d])
+        # Species
+        m = Species(name='monomer', initial_value=30)
+        d = Species(name='dimer', initial_value=0)
+        self.add_species([m, d])
+        # Reactions
+        r_creation = Reaction(name="r_creation", rate=k_c, reactants={m: 2}, products={d: 1})
+        r_dissociation = Reaction(name="r_dissociation", rate=k_d, reactants={d: 1}, products={m: 2})
+        self.add_reaction([r_creation, r_dissociation])
+        self.timespan(np.linspace(0, 100, 101))
+
+
+class MichaelisMenten(Model):
+    """
+    Enzyme kinetics of substrate A and enzyme B forming complex C and product D.
+    """
+
+    def __init__(self, parameter_values=None):
+        Model.__init__(self, name="Michaelis_Menten")
+        # Parameters
+        rate1 = Parameter(name='rate1', expression=0.0017)
+        rate2 = Parameter(name='rate2', expression=0.5)
+        rate3 = Parameter(name='rate3', expression=0.1)
+        self.add_parameter([rate1, rate2, rate3])
+        # Species
+        A = Species(name='A', initial_value=301)
+        B = Species(name='B', initial_value=120)
+        C = Species(name='C', initial_value=0)
+        D = Species(name='D', initial_value=0)
+        self.add_species([A, B, C, D])
+        # Reactions
+        r1 = Reaction(name="r1", reactants={A: 1, B: 1}, products={C: 1}, rate=rate1)
+        r2 = Reaction(name="r2", reactants={C: 1}, products={A: 1, B: 1}, rate=rate2)
+        r3 = Reaction(name="r3", reactants={C: 1}, products={B: 1, D: 1}, rate=rate3)
+        self.add_reaction([r1, r2, r3])
+        self.timespan(np.linspace(0, 100, 101))
+
+
+class SparseNetwork(Model):
+    """
+    Large network in which each species takes part in only a few reactions: every species converts into a
+    randomly chosen one, and random pairs of species exchange into other pairs. The total population is
+    conserved, so the network keeps firing for the whole simulation.
+
+    :param number_species: Number of species in the network
+    :param seed: Seed of the random choice of reactions, so the same network is built each time
+    """
+
+    def __init__(self, parameter_values=None, number_species=1000, seed=0):
+        Model.__init__(self, name="Sparse_Network_{}".format(number_species))
+        chooser = random.Random(seed)
+        # Parameters
+        k_convert = Parameter(name='k_convert', expression=0.05)
+        k_exchange = Parameter(name='k_exchange', expression=0.0005)
+        self.add_parameter([k_convert, k_exchange])
+        # Species
+        species = [Species(name='S{}'.format(i), initial_value=100) for i in range(number_species)]
+        self.add_species(species)
+        # Reactions
+        reactions = []
+        for i in range(number_species):
+            target = species[chooser.randrange(number_species)]
+            if target is not species[i]:
+                reactions.append(Reaction(name='convert{}'.format(i), rate=k_convert,
+                                          reactants={species[i]: 1}, products={target: 1}))
+            first, second, third, fourth = chooser.sample(species, 4)
+            reactions.append(Reaction(name='exchange{}'.format(i), rate=k_exchange,
+                                      reactants={first: 1, second: 1}, products={third: 1, fourth: 1}))
+        self.add_reaction(reactions)
+        self.timespan(np.linspace(0, 20, 101))
+
+
+__all__ = ['Example', 'Dimerization', 'MichaelisMenten', 'SparseNetwork']
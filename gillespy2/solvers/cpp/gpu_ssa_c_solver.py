@@ -0,0 +1,61 @@
+from gillespy2.core import gillespyError
+from gillespy2.solvers.cpp.ssa_c_solver import SSACSolver
+
+
+class GPUSSASolver(SSACSolver):
+    """
+    A CUDA SSA Solver for GillesPy2 models.  The model is compiled with nvcc into a simulation running the direct method
+    with one GPU thread per trajectory, so large ensembles are simulated together.  Trajectories are drawn from a
+    Philox generator on the device, so they are not those of the SSACSolver run with the same seed.  Ensembles larger
+    than the device's memory are simulated in chunks, copied into the results, or into the summary statistics of
+    run_statistics, as each chunk finishes.  Requires an NVIDIA GPU and the CUDA toolkit, with nvcc on the path or
+    named by the NVCC environment variable.  Assignment rules, events and rate rules are not supported.
+    """
+    name = "GPUSSASolver"
+    algorithms = ('gpu_direct',)
+    rule_algorithms = ()
+    target = 'UserSimulationGPU'
+    checkpoints = False
+    generic = False
+
+    def get_solver_settings(self):
+        """
+        :return: Tuple of strings, denoting all keyword argument for this solvers run() method.
+        """
+        return ('model', 't', 'number_of_trajectories', 'timeout', 'increment', 'seed', 'debug', 'species',
+                'timeline')
+
+    def run(self=None, model=None, t=20, number_of_trajectories=1, timeout=0, increment=0.05, seed=None,
+            debug=False, profile=False, number_of_threads=1, algorithm='gpu_direct', resume=None,
+            sparse_output=False, record_every=None, **kwargs):
+        """
+        Function calling simulation of the model. This is typically called by the run function in GillesPy2 model
+        objects and will inherit those parameters which are passed with the model as the arguments this run function.
+
+        :param model: GillesPy2 model object to simulate
+        :type model: gillespy2.Model
+        :param t: Simulation run time
+        :type t: int
+        :param number_of_trajectories: Number of trajectories to simulate, one GPU thread each
+        :type number_of_trajectories: int
+        :param timeout: Seconds to run before stopping the simulation, 0 for no limit
+        :type timeout: int
+        :param increment: Save point increment for recording data
+        :type increment: float
+        :param seed: The random seed for the simulation. Optional, defaults to None
+        :type seed: int
+        :param species: Names of the species to output, in order. Optional, defaults to every species
+        :type species: list
+        :param timeline: Sorted times from 0 to output at, in place of t and increment. Optional, a non-uniform
+        model.tspan is used as given.
+        :type timeline: list
+        """
+        if profile or sparse_output or record_every is not None or resume is not None:
+            raise gillespyError.SimulationError('{} does not support profile, sparse_output, record_every or resume.'
+                                                .format(GPUSSASolver.name))
+        if self is None or self.model is None:
+            self = GPUSSASolver(model)
+
+        return SSACSolver.run(self, model=model, t=t, number_of_trajectories=number_of_trajectories,
+                              timeout=timeout, increment=increment, seed=seed, debug=debug,
+                              number_of_threads=number_of_threads, algorithm=algorithm, **kwargs)
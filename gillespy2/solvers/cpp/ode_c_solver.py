@@ -0,0 +1,74 @@
+from gillespy2.core import gillespyError, log
+from gillespy2.solvers.cpp.ssa_c_solver import SSACSolver
+
+
+class ODECSolver(SSACSolver):
+    """
+    A C++ ODE Solver for GillesPy2 models.  Like the ODESolver, it produces the deterministic continuous solution of
+    the reactions' ODE propensity functions.  Steps are taken by a stiff Rosenbrock method whose Jacobian is assembled
+    from the partial derivatives of each reaction's rate, differentiated analytically when the model is compiled.  Rate
+    rules of species are integrated along with the reactions.  The model is compiled once, as for the SSACSolver, and
+    may be run repeatedly.
+    """
+    name = "ODECSolver"
+    algorithms = ('ode',)
+    continuous = True
+    rule_algorithms = ()
+    rate_rule_algorithms = ('ode',)
+    generic = False
+
+    def get_solver_settings(self):
+        """
+        :return: Tuple of strings, denoting all keyword argument for this solvers run() method.
+        """
+        return ('model', 't', 'number_of_trajectories', 'timeout', 'increment', 'debug', 'species', 'timeline',
+                'rtol', 'atol')
+
+    def _algorithm_args(self, algorithm, kwargs):
+        rtol = kwargs.pop('rtol', 1e-6)
+        atol = kwargs.pop('atol', 1e-9)
+        for tolerance in (rtol, atol):
+            if not isinstance(tolerance, (int, float)) or tolerance <= 0:
+                raise gillespyError.SimulationError('rtol and atol must be positive numbers.')
+        return super(ODECSolver, self)._algorithm_args(algorithm, kwargs) + ['-rtol', repr(float(rtol)), '-atol',
+                                                                             repr(float(atol))]
+
+    def run(self=None, model=None, t=20, number_of_trajectories=1, timeout=0, increment=0.05, seed=None,
+            debug=False, profile=False, number_of_threads=1, algorithm='ode', resume=None, rtol=1e-6, atol=1e-9,
+            sparse_output=False, record_every=None, **kwargs):
+        """
+        Function calling simulation of the model. This is typically called by the run function in GillesPy2 model
+        objects and will inherit those parameters which are passed with the model as the arguments this run function.
+
+        :param model: GillesPy2 model object to simulate
+        :type model: gillespy2.Model
+        :param t: Simulation run time
+        :type t: int
+        :param number_of_trajectories: Should be 1. The solution is deterministic, every trajectory is the same.
+        :type number_of_trajectories: int
+        :param timeout: Seconds to run before stopping the simulation, 0 for no limit
+        :type timeout: int
+        :param increment: Save point increment for recording data
+        :type increment: float
+        :param rtol: Relative error tolerance of each step
+        :type rtol: float
+        :param atol: Absolute error tolerance of each step
+        :type atol: float
+        :param species: Names of the species to output, in order. Optional, defaults to every species
+        :type species: list
+        :param timeline: Sorted times from 0 to output at, in place of t and increment. Optional, a non-uniform
+        model.tspan is used as given.
+        :type timeline: list
+        """
+        if profile or sparse_output or record_every is not None or resume is not None:
+            raise gillespyError.SimulationError('{} does not support profile, sparse_output, record_every or resume.'
+                                                .format(ODECSolver.name))
+        if number_of_trajectories > 1:
+            log.warning("Generating duplicate trajectories for model with ODE Solver. "
+                        "Consider running with only 1 trajectory.")
+        if self is None or self.model is None:
+            self = ODECSolver(model)
+
+        return SSACSolver.run(self, model=model, t=t, number_of_trajectories=number_of_trajectories,
+                              timeout=timeout, increment=increment, debug=debug, algorithm=algorithm, rtol=rtol,
+                              atol=atol, **kwargs)
@@ -1,5 +1,6 @@
 import gillespy2
 from gillespy2.core import gillespyError, GillesPySolver, log
+from gillespy2.core.results import Trajectory
 from gillespy2.solvers.utilities import solverutils as cutils
 import signal, time #for solver timeout implementation
 import os #for getting directories for C++ files
@@ -7,6 +8,7 @@ import shutil #for deleting/copying files
 import subprocess #For calling make and executing c solver
 import inspect #for finding the Gillespy2 module path
 import tempfile #for temporary directories
+import random #for seeding the shards of distributed runs
 import numpy as np
 
 GILLESPY_PATH = os.path.dirname(inspect.getfile(gillespy2))
@@ -58,19 +60,46 @@ def _write_constants(outfile, model, reactions, species, parameter_mappings, res
             outfile.write('"{}", '.format(reactions[i]))
         outfile.write('"{}"'.format(reactions[-1]))
         outfile.write("};\n")
+    # Parameters set by assignment rules and events are variables of each simulation thread, reset by ModelEvents
+    assigned = cutils._assigned_parameters(model)
     for param in model.listOfParameters:
-        outfile.write("const double {0} = {1};\n".format(parameter_mappings[param], model.listOfParameters[param].value)
+        outfile.write("{0} double {1} = {2};\n".format('thread_local' if param in assigned else 'const',
+                                                      parameter_mappings[param], model.listOfParameters[param].value)
 
                       )
 
 
 class SSACSolver(GillesPySolver):
     name = "SSACSolver"
+    # SSA engines of the C++ simulation, selected with run(algorithm=...)
+    algorithms = ('direct', 'next_reaction', 'composition_rejection', 'batch_direct')
+    # Whether the algorithms output continuous concentrations, which are never written in place or checkpointed
+    continuous = False
+    # Algorithms carrying out assignment rules and events, and integrating rate rules
+    rule_algorithms = ('direct',)
+    rate_rule_algorithms = ()
+    # Makefile target building the simulation, and whether its trajectories save checkpoints they can be resumed from
+    target = 'UserSimulation'
+    checkpoints = True
+    # Whether models of mass-action reactions alone are simulated by the generic simulation, which loads them from a
+    # description at runtime, so every such model shares one build of it instead of being compiled
+    generic = True
     """TODO"""
 
-    def __init__(self, model=None, output_directory=None, delete_directory=True, resume=None):
+    def __init__(self, model=None, output_directory=None, delete_directory=True, resume=None, build='default'):
+        """
+        :param build: Build profile the simulation is compiled with, one of 'fast', quickest to build, for short runs;
+        'default'; 'native', fastest to run on this host; or 'pgo', native and optimized by a training run of the model
+        :type build: str
+        """
         super(SSACSolver, self).__init__()
+        if build not in cutils.BUILD_PROFILES:
+            raise gillespyError.SimulationError('build must be one of {}.'.format(sorted(cutils.BUILD_PROFILES)))
+        self.build = build
         self.__compiled = False
+        self.__profile_compiled = False
+        self.__generic = False
+        self.__model_args = []
         self.delete_directory = False
         self.model = model
         self.resume = resume
@@ -101,8 +130,13 @@ class SSACSolver(GillesPySolver):
                 raise gillespyError.DirectoryError("Errors encountered while setting up directory for Solver C++ files."
                                                    )
             cutils._copy_files(self.output_directory, GILLESPY_C_DIRECTORY)
+            self.__generic = self.generic and self.resume is None and cutils._generic_model(self.model)
+            if self.__generic:
+                model_path = os.path.join(self.output_directory, 'UserSimulation.model')
+                cutils._write_model_description(model_path, self.model, self.species, self.reactions)
+                self.__model_args = ['-model', model_path]
             self.__write_template()
-            self.__compile()
+            self.__compile(self.target)
 
     def __del__(self):
         if self.delete_directory and os.path.isdir(self.output_directory):
@@ -118,94 +152,240 @@ class SSACSolver(GillesPySolver):
                 for line in template:
                     if line.startswith(template_keyword):
                         line = line[len(template_keyword):]
+                        # The generic simulation is written the same for every model, which it reads at runtime
+                        if self.__generic and not line.startswith(cutils._RULE_SECTIONS):
+                            outfile.write(cutils._GENERIC_SECTIONS.get(line.split('__')[0], ''))
+                            continue
                         if line.startswith("CONSTANTS"):
                             _write_constants(outfile, self.model, self.reactions, self.species, self.parameter_mappings
                                              ,self.resume)
                         if line.startswith("PROPENSITY"):
                             cutils._write_propensity(outfile, self.model, self.species_mappings, self.parameter_mappings
                                                      , self.reactions)
+                        if line.startswith("BATCH_PROPENSITY"):
+                            cutils._write_batch_propensity(outfile, self.model, self.species_mappings,
+                                                           self.parameter_mappings, self.reactions)
+                        if line.startswith("ODE_PROPENSITY"):
+                            cutils._write_ode_propensity(outfile, self.model, self.species_mappings,
+                                                         self.parameter_mappings, self.reactions)
+                        if line.startswith("ODE_JACOBIAN"):
+                            cutils._write_ode_jacobian(outfile, self.model, self.species_mappings,
+                                                       self.parameter_mappings, self.reactions, self.species)
                         if line.startswith("REACTIONS"):
                             cutils._write_reactions(outfile, self.model, self.reactions, self.species)
+                        if line.startswith(cutils._RULE_SECTIONS):
+                            try:
+                                cutils._write_rules(outfile, self.model, line.split('__')[0], self.species_mappings,
+                                                    self.parameter_mappings, self.reactions, self.species)
+                            except ValueError as e:
+                                raise gillespyError.ModelError('Could not write the model as C++: {}'.format(e))
                     else:
                         outfile.write(line)
 
-    def __compile(self):
-        # Use makefile.
+    def __compile(self, target='UserSimulation'):
         if self.resume:
             if self.resume[0].model != self.model:
                 raise gillespyError.ModelError('When resuming, one must not alter the model being resumed.')
-            else:
-                built = subprocess.run(["make", "-C", self.output_directory, 'UserSimulation'],
-                    stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-        else:
-             try:
-                 cleaned = subprocess.run(
-                     ["make", "-C", self.output_directory, '-f', MAKE_FILE,
-                      'cleanSimulation'],
-                     stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-                 built = subprocess.run(
-                     ["make", "-C", self.output_directory, '-f', MAKE_FILE,
-                      'UserSimulation'], stdout=subprocess.PIPE,
-                     stderr=subprocess.PIPE)
-             except KeyboardInterrupt:
-                 log.warning(
-                     "Solver has been interrupted during compile time, unexpected behavior may occur.")
+        try:
+            # Built simulations are cached by their generated source, so a model compiled before is not rebuilt
+            built = cutils._build_simulation(self.output_directory, GILLESPY_C_DIRECTORY, MAKE_FILE, target,
+                                             self.build, self._training_args())
+        except KeyboardInterrupt:
+            log.warning("Solver has been interrupted during compile time, unexpected behavior may occur.")
+            raise
 
         if built.returncode == 0:
-            self.__compiled = True
+            if target == 'UserSimulationProfile':
+                self.__profile_compiled = True
+            else:
+                self.__compiled = True
         else:
             raise gillespyError.BuildError("Error encountered while compiling file:\nReturn code: "
                                            "{0}.\nError:\n{1}\n{2}\n".format(built.returncode,
                                                                              built.stdout.decode('utf-8'),
                                                                              built.stderr.decode('utf-8')))
 
+    def _training_args(self):
+        """
+        Builds the command line arguments of the training run of a pgo build, a few trajectories over model.tspan.
+        :return: List of command line arguments
+        """
+        return ['-trajectories', '4', '-timesteps', str(len(self.model.tspan)), '-end', str(self.model.tspan[-1]),
+                '-seed', '1', '-algorithm', self.algorithms[0]] + self.__model_args
+
     def get_solver_settings(self):
         """
         :return: Tuple of strings, denoting all keyword argument for this solvers run() method.
         """
-        return ('model', 't', 'number_of_trajectories', 'timeout', 'increment', 'seed', 'debug', 'profile')
+        return ('model', 't', 'number_of_trajectories', 'timeout', 'increment', 'seed', 'debug', 'profile', 'number_of_threads', 'algorithm',
+                'sparse_output', 'species', 'record_every', 'timeline', 'shards', 'launcher')
+
+    def _algorithm_args(self, algorithm, kwargs):
+        """
+        Builds the command line arguments selecting the simulation engine.
+        :param algorithm: Name of the engine, one of self.algorithms
+        :param kwargs: Keyword arguments passed to run(), arguments of the engine are removed from it
+        :return: List of command line arguments
+        """
+        if algorithm not in self.algorithms:
+            raise gillespyError.SimulationError('algorithm must be one of {}.'.format(self.algorithms))
+        return ['-algorithm', algorithm]
+
+    def _check_model_features(self, model, algorithm):
+        """
+        Raises a ModelError if the algorithm does not simulate the models SBML features. Function definitions are
+        compiled into every algorithm, assignment rules and events are carried out by rule_algorithms, and rate rules
+        of species are integrated by rate_rule_algorithms.
+        :param model: Model being simulated
+        :param algorithm: Name of the engine, one of self.algorithms
+        """
+        detected_features = []
+        if algorithm not in self.rule_algorithms:
+            detected_features += [feature for feature, items in (('Assignment Rules', model.listOfAssignmentRules),
+                                                                 ('Events', model.listOfEvents)) if items]
+        if model.listOfRateRules and (algorithm not in self.rate_rule_algorithms or any(
+                cutils._variable_name(rule.variable) not in model.listOfSpecies
+                for rule in model.listOfRateRules.values())):
+            detected_features.append('Rate Rules')
+        if detected_features:
+            raise gillespyError.ModelError('Could not run Model.  SBML Feature: {} not supported by {} algorithm {}.'
+                                           .format(detected_features, self.name, algorithm))
+
+    def _observe_args(self, species):
+        """
+        Builds the command line arguments selecting the species the simulation outputs.
+        :param species: Names or Species of the species to output, in order, or None for every species
+        :return: List of command line arguments, and the names of the species output
+        """
+        if species is None:
+            return [], self.species
+        if isinstance(species, str):
+            species = [species]
+        names = [getattr(name, 'name', name) for name in species]
+        for name in names:
+            if name not in self.species:
+                raise gillespyError.SimulationError('species {} is not a species of the model.'.format(name))
+        if not names:
+            raise gillespyError.SimulationError('species must name at least one species of the model.')
+        return ['-observe', ','.join(str(self.species.index(name)) for name in names)], names
+
+    def _timeline_args(self, model, t, increment, resume, timeline=None):
+        """
+        Builds the command line arguments giving the simulation a non-uniform timeline to output at, either the one
+        given or a non-uniform model.tspan. Uniform spans, and runs whose end time or increment do not come from
+        model.tspan, are output at increments from 0 to t.
+        :param timeline: Sorted times starting at 0 to output at, optional
+        :return: Command line arguments, the path of the timeline file they name or None, and the number of timesteps
+        """
+        if timeline is None:
+            timeline = np.asarray(model.tspan, dtype=np.float64)
+            if resume is not None or len(timeline) < 2 or timeline[-1] != t or timeline[-1] - timeline[-2] != increment \
+                    or np.allclose(np.diff(timeline), increment):
+                return [], None, int(round(t/increment + 1))
+        timeline = np.asarray(timeline, dtype=np.float64)
+        if resume is not None or len(timeline) < 2 or timeline[0] != 0 or np.any(np.diff(timeline) < 0):
+            raise gillespyError.SimulationError('A timeline must hold two or more sorted times from 0, and cannot be '
+                                                'resumed.')
+        descriptor, path = tempfile.mkstemp(suffix='.timeline', dir=self.output_directory)
+        with os.fdopen(descriptor, 'wb') as timeline_file:
+            timeline_file.write(timeline.tobytes())
+        return ['-timeline', path], path, len(timeline)
+
+    def _shard_commands(self, args, number_of_trajectories, shards, launcher):
+        """
+        Splits a simulation's command line into those of shards simulating consecutive trajectories of its ensemble.
+        Each shard numbers its trajectories within the ensemble with -first_trajectory, so they draw from the same
+        random streams of the seed as one simulation of every trajectory would.
+        :param args: Command line of the simulation, with its -trajectories
+        :param number_of_trajectories: Number of trajectories of the ensemble
+        :param shards: Number of shards to split the ensemble into, at most one per trajectory
+        :param launcher: Command line words each shard's command line is started with, such as ['srun', '-N1', '-n1']
+        or ['ssh', 'host'], or a function from the shard's number to them. Optional, shards otherwise run locally.
+        The simulation's directory must then be on a file system the shards' hosts share.
+        :return: List of each shard's command line
+        """
+        if not isinstance(shards, int) or shards < 1:
+            raise gillespyError.SimulationError('shards must be a positive integer.')
+        shards = min(shards, number_of_trajectories)
+        index = args.index('-trajectories') + 1
+        commands = []
+        first_trajectory = 0
+        for shard in range(shards):
+            shard_trajectories = number_of_trajectories // shards
+            if shard < number_of_trajectories % shards:
+                shard_trajectories += 1
+            command = list(args)
+            command[index] = str(shard_trajectories)
+            command += ['-first_trajectory', str(first_trajectory)]
+            prefix = launcher(shard) if callable(launcher) else launcher
+            commands.append(list(prefix or []) + command)
+            first_trajectory += shard_trajectories
+        return commands
 
     def run(self=None, model=None, t=20, number_of_trajectories=1, timeout=0,
-            increment=0.05, seed=None, debug=False, profile=False, resume=None, **kwargs):
+            increment=0.05, seed=None, debug=False, profile=False, number_of_threads=1, algorithm='direct', resume=None,
+            sparse_output=False, species=None, record_every=None, timeline=None, shards=None, launcher=None,
+            resumable=False, **kwargs):
 
-        pause = False
         if resume is not None:
             if t < resume['time'][-1]:
                 raise gillespyError.ExecutionError(
                     "'t' must be greater than previous simulations end time, or set in the run() method as the "
                     "simulations next end time")
 
+        # Results which saved a checkpoint are resumed by the same build of the simulation, without recompiling it, when
+        # the resuming simulation's timesteps are spaced as theirs were
+        checkpoint_resume = resume is not None and getattr(resume, 'checkpoint', None) is not None \
+            and cutils._checkpoint_resumable(resume.checkpoint, t, increment)
         if self is None or self.model is None:
-            self = SSACSolver(model, resume=resume)
+            self = SSACSolver(model, resume=None if checkpoint_resume else resume)
+        if checkpoint_resume and resume[0].model != self.model:
+            raise gillespyError.ModelError('When resuming, one must not alter the model being resumed.')
 
+        engine_args = self._algorithm_args(algorithm, kwargs)
+        observe_args, observed_species = self._observe_args(species)
         if len(kwargs) > 0:
             for key in kwargs:
                 log.warning('Unsupported keyword argument to {0} solver: {1}'.format(self.name, key))
         
-        unsupported_sbml_features = {
-                        'Rate Rules': len(model.listOfRateRules),
-                        'Assignment Rules': len(model.listOfAssignmentRules), 
-                        'Events': len(model.listOfEvents),
-                        'Function Definitions': len(model.listOfFunctionDefinitions)
-                        }
-        detected_features = []
-        for feature, count in unsupported_sbml_features.items():
-            if count:
-                detected_features.append(feature)
+        self._check_model_features(model, algorithm)
 
-        if len(detected_features):
-            raise gillespyError.ModelError('Could not run Model.  SBML Feature: {} not supported by SSACSolver.'
-                                           .format(detected_features))
+        if not isinstance(number_of_threads, int) or number_of_threads < 1:
+            raise gillespyError.SimulationError('number_of_threads must be a positive integer.')
+        if record_every is not None and (not isinstance(record_every, int) or record_every < 1 or resume is not None):
+            raise gillespyError.SimulationError('record_every must be a positive integer, and cannot be resumed.')
+        if shards is not None and (profile or sparse_output or record_every is not None or resume is not None):
+            raise gillespyError.SimulationError('shards cannot be combined with profile, sparse_output, record_every '
+                                                'or resume.')
 
+        profile_data = None
+        checkpoint = None
         if self.__compiled:
             self.simulation_data = None
-            if resume is not None:
+            if checkpoint_resume:
+                # Resumed trajectories continue on the timeline from 0 to t, after the timesteps of their checkpoints
+                number_of_trajectories = len(resume)
+            elif resume is not None:
                 t = abs(t - resume['time'][-1])
 
-            number_timesteps = int(round(t/increment + 1))
+            # Profiled runs use a second build of the simulation with the engines' profiling compiled in
+            if profile and not self.__profile_compiled:
+                self.__compile('UserSimulationProfile')
+            executable = 'UserSimulationProfile' if profile else self.target
+
+            # Trajectories recorded every record_every events only need the end time from their timeline
+            if record_every is None:
+                timeline_args, timeline_path, number_timesteps = self._timeline_args(model, t, increment, resume,
+                                                                                     timeline)
+            else:
+                timeline_args, timeline_path, number_timesteps = ['-record_every', str(record_every)], None, 2
             # Execute simulation.
-            args = [os.path.join(self.output_directory, 'UserSimulation'), '-trajectories', str(number_of_trajectories),
-                    '-timesteps', str(number_timesteps), '-end', str(t)]
+            args = [os.path.join(self.output_directory, executable), '-trajectories', str(number_of_trajectories),
+                    '-timesteps', str(number_timesteps), '-end', str(t), '-threads', str(number_of_threads),
+                    '-binary'] + engine_args + observe_args + timeline_args + self.__model_args
+            # Every shard must draw from the same seed, so one is chosen for them
+            if seed is None and shards is not None:
+                seed = random.randint(1, 2 ** 31 - 1)
             if seed is not None:
                 if isinstance(seed, int):
                     args.append('-seed')
@@ -218,49 +398,257 @@ class SSACSolver(GillesPySolver):
                     else:
                         raise gillespyError.ModelError("seed must be a positive integer")
 
+            # Have the simulation write its results in place, so they are never copied through a pipe.
+            # A profile extends the results header, and sparse results are only sized once simulated, so both are
+            # written to stdout instead. Sparse results hold only the populations changed at each timestep.
+            # Results recorded every record_every events, and continuous results, are written to stdout as well, as are
+            # those of shards, which may run on other hosts and are gathered once they finish.
+            if profile or sparse_output or record_every is not None or self.continuous or shards is not None:
+                results_args, results_path = [], None
+                if profile:
+                    results_args.append('-profile')
+                if sparse_output:
+                    results_args.append('-changes')
+            else:
+                results_args, results_path = cutils._results_file_args(self.output_directory, number_of_trajectories,
+                                                                       number_timesteps, len(observed_species))
+            args += results_args
+
+            # Trajectories output at every timestep of a uniform timeline can save a checkpoint to be resumed from. It is
+            # saved when asked for, or when a timeout may pause the run or it continues a checkpoint, whose paused first
+            # trajectory is cut at the timesteps it reached. Runs resuming results without a checkpoint are completed
+            # by c_solver_resume instead. Checkpoints do not hold the state of rules and events.
+            checkpoint_path = resume_path = None
+            if (resumable or timeout > 0 or checkpoint_resume) and (resume is None or checkpoint_resume) \
+                    and not sparse_output and record_every is None \
+                    and species is None and not timeline_args and not self.continuous and self.checkpoints \
+                    and shards is None and not model.listOfAssignmentRules and not model.listOfEvents:
+                descriptor, checkpoint_path = tempfile.mkstemp(suffix='.checkpoint', dir=self.output_directory)
+                os.close(descriptor)
+                args += ['-checkpoint', checkpoint_path]
+            if checkpoint_resume:
+                descriptor, resume_path = tempfile.mkstemp(suffix='.checkpoint', dir=self.output_directory)
+                with os.fdopen(descriptor, 'wb') as resume_file:
+                    resume_file.write(resume.checkpoint)
+                args += ['-resume', resume_path]
+
             # begin subprocess c simulation with timeout (default timeout=0 will not timeout)
-            with subprocess.Popen(args, stdout=subprocess.PIPE, start_new_session=True) as simulation:
-                return_code = 0
-                try:
-                    if timeout > 0:
-                        stdout, stderr = simulation.communicate(timeout=timeout)
-                    else:
-                        stdout, stderr = simulation.communicate()
-                    return_code = simulation.wait()
-                except KeyboardInterrupt:
-                    os.killpg(simulation.pid, signal.SIGINT)  # send signal to the process group
-                    stdout, stderr = simulation.communicate()
-                    pause = True
-                    return_code = 33
-                except subprocess.TimeoutExpired:
-                        os.killpg(simulation.pid, signal.SIGINT)  # send signal to the process group
-                        stdout, stderr = simulation.communicate()
-                        pause = True
-                        return_code = 33
-
-            # Decode from byte, split by comma into array
-            stdout = stdout.decode('utf-8').split(',')
-            # Parse/return results
+            if shards is None:
+                stdout, return_code, pause = cutils._run_simulation(args, timeout)
+            else:
+                stdout, return_code, pause = cutils._run_shards(
+                    self._shard_commands(args, number_of_trajectories, shards, launcher),
+                    cutils._gather_binary_results, timeout)
+            if timeline_path is not None:
+                os.remove(timeline_path)
+            if resume_path is not None:
+                os.remove(resume_path)
+            if checkpoint_path is not None:
+                with open(checkpoint_path, 'rb') as checkpoint_file:
+                    checkpoint = checkpoint_file.read() if return_code in [0, 33] else None
+                os.remove(checkpoint_path)
 
-            if return_code in [0, 33]:
-                trajectory_base, timeStopped = cutils._parse_binary_output(stdout, number_of_trajectories,
-                                                                           number_timesteps, len(model.listOfSpecies), stdout,
-                                                                           pause=pause)
+            # Parse/return results
+            if return_code in [0, 33] and record_every is not None:
+                # Each trajectory has its own times, those of its start and every record_every-th event
+                if profile:
+                    profile_data = cutils._parse_binary_profile(stdout, self.reactions)
+                self.simulation_data = []
+                for times, populations in cutils._parse_binary_events(stdout):
+                    data = {'time': times}
+                    for i in range(len(observed_species)):
+                        data[observed_species[i]] = populations[:, i]
+                    self.simulation_data.append(data)
+                timeStopped = 0
+            elif return_code in [0, 33]:
+                timeline, trajectories, timeStopped = cutils._read_binary_results(stdout, results_path, pause=pause)
+                if profile:
+                    profile_data = cutils._parse_binary_profile(stdout, self.reactions)
                 if model.tspan[1] - model.tspan[0] == 1:
                     timeStopped = int(timeStopped)
-                # Format results
+
+                # Format results, each species is a view into one float array converted from the simulation
+                # output in a single pass, so counts behave as they do for every other solver
+                timeline = np.array(timeline)
+                trajectories = trajectories.astype(np.float64)
                 self.simulation_data = []
                 for trajectory in range(number_of_trajectories):
-                    data = {'time': trajectory_base[trajectory, :, 0]}
-                    for i in range(len(self.species)):
-                        data[self.species[i]] = trajectory_base[trajectory, :, i + 1]
+                    data = {'time': timeline}
+                    for i in range(len(observed_species)):
+                        data[observed_species[i]] = trajectories[trajectory, :, i]
                     self.simulation_data.append(data)
             else:
+                cutils._remove_results_file(results_path)
                 raise gillespyError.ExecutionError("Error encountered while running simulation C++ file:"
-                                                   "\nReturn code: {0}.\nError:\n{1}\n".
-                                                   format(simulation.returncode, simulation.stderr))
-            if resume is not None or timeStopped != 0:
+                                                   "\nReturn code: {0}.\n".format(return_code))
+            if checkpoint is not None:
+                self.simulation_data = cutils.c_solver_checkpoint_resume(self.simulation_data, checkpoint, pause,
+                                                                         resume=resume if checkpoint_resume else None)
+            elif resume is not None or timeStopped != 0:
                 self.simulation_data = cutils.c_solver_resume(timeStopped, self.simulation_data, t, resume=resume)
 
+        # The checkpoint is returned only when asked for with resumable, the profile when asked for with profile
+        if resumable:
+            return self.simulation_data, return_code, profile_data, checkpoint
+        if profile:
+            return self.simulation_data, return_code, profile_data
         return self.simulation_data, return_code
 
+    def run_statistics(self, t=20, number_of_trajectories=1, increment=0.05, timeout=0, seed=None,
+                       number_of_threads=1, algorithm=None, quantiles=(), species=None, shards=None, launcher=None,
+                       **kwargs):
+        """
+        Simulates the model and returns summary statistics of the ensemble at each timestep, accumulated as each
+        trajectory finishes so memory use does not grow with the number of trajectories. Trajectories interrupted
+        by a timeout are left out.
+
+        :param t: Simulation run time
+        :type t: int
+        :param number_of_trajectories: Number of trajectories to summarize
+        :type number_of_trajectories: int
+        :param increment: Save point increment for recording data
+        :type increment: float
+        :param timeout: Seconds to run before stopping the simulation, 0 for no limit
+        :type timeout: int
+        :param seed: The random seed for the simulation. Optional, defaults to None
+        :type seed: int
+        :param number_of_threads: Number of threads trajectories are simulated on
+        :type number_of_threads: int
+        :param algorithm: Engine to simulate with, one of this solver's algorithms, defaults to the first
+        :type algorithm: str
+        :param quantiles: Probabilities of the population quantiles to compute. Populations below 256 are counted
+        exactly, larger ones are binned into at most 256 bins per species and timestep.
+        :type quantiles: list
+        :param species: Names of the species to summarize, in order. Optional, defaults to every species
+        :type species: list
+        :param shards: Number of simulations to split the trajectories between, run at once, whose statistics are
+        reduced into those of the ensemble. They draw the same random numbers as one simulation of every trajectory.
+        Optional, quantiles are not reduced and cannot be combined with it
+        :type shards: int
+        :param launcher: Command line words each shard is started with, such as ['srun', '-N1', '-n1'] to run them on
+        the nodes of a cluster, or a function from the shard's number to them. Optional, shards otherwise run locally
+        :type launcher: list
+        :return: Dictionary holding the 'time' array, the number of 'trajectories' summarized, 'mean' and 'variance'
+        dictionaries of arrays for each species, and 'quantiles', a dictionary of the same for each probability
+        """
+        if self.model is None or not self.__compiled:
+            raise gillespyError.SimulationError('run_statistics requires a solver constructed with a model.')
+        if not isinstance(number_of_threads, int) or number_of_threads < 1:
+            raise gillespyError.SimulationError('number_of_threads must be a positive integer.')
+        quantiles = list(quantiles)
+        for probability in quantiles:
+            if not isinstance(probability, (int, float)) or not 0 <= probability <= 1:
+                raise gillespyError.SimulationError('quantiles must be probabilities between 0 and 1.')
+        if quantiles and shards is not None:
+            raise gillespyError.SimulationError('quantiles cannot be reduced from shards.')
+        algorithm = self.algorithms[0] if algorithm is None else algorithm
+        engine_args = self._algorithm_args(algorithm, kwargs)
+        self._check_model_features(self.model, algorithm)
+        observe_args, observed_species = self._observe_args(species)
+        for key in kwargs:
+            log.warning('Unsupported keyword argument to {0} solver: {1}'.format(self.name, key))
+
+        number_timesteps = int(round(t/increment + 1))
+        args = [os.path.join(self.output_directory, self.target), '-trajectories', str(number_of_trajectories),
+                '-timesteps', str(number_timesteps), '-end', str(t), '-threads', str(number_of_threads),
+                '-statistics'] + engine_args + observe_args + self.__model_args
+        if quantiles:
+            args += ['-quantiles', ','.join(repr(float(probability)) for probability in quantiles)]
+        if seed is None and shards is not None:
+            seed = random.randint(1, 2 ** 31 - 1)
+        if seed is not None:
+            if not isinstance(seed, int) and int(seed) <= 0:
+                raise gillespyError.ModelError("seed must be a positive integer")
+            args += ['-seed', str(int(seed))]
+
+        if shards is None:
+            stdout, return_code, pause = cutils._run_simulation(args, timeout)
+        else:
+            stdout, return_code, pause = cutils._run_shards(
+                self._shard_commands(args, number_of_trajectories, shards, launcher),
+                cutils._gather_binary_statistics, timeout)
+        if return_code not in [0, 33]:
+            raise gillespyError.ExecutionError("Error encountered while running simulation C++ file:"
+                                               "\nReturn code: {0}.\n".format(return_code))
+        if pause:
+            log.warning('GillesPy2 simulation exceeded timeout.')
+        timeline, count, mean, variance, quantile_values = cutils._parse_binary_statistics(stdout, len(quantiles))
+        return {
+            'time': np.array(timeline),
+            'trajectories': count,
+            'mean': {species: mean[:, i] for i, species in enumerate(observed_species)},
+            'variance': {species: variance[:, i] for i, species in enumerate(observed_species)},
+            'quantiles': {probability: {species: quantile_values[q, :, i] for i, species in enumerate(observed_species)}
+                          for q, probability in enumerate(quantiles)}
+        }
+
+    def run_iter(self, t=20, number_of_trajectories=1, increment=0.05, timeout=0, seed=None, number_of_threads=1,
+                 algorithm=None, species=None, timeline=None, progress=None, **kwargs):
+        """
+        Simulates the model and yields each trajectory as soon as it is simulated, so trajectories can be analyzed
+        while the rest of the ensemble is still running. Trajectories simulated on several threads finish, and are
+        yielded, out of order. On timeout or KeyboardInterrupt the simulation is stopped and the trajectories it
+        finished are still yielded, closing the generator early stops the simulation.
+
+        :param t: Simulation run time
+        :type t: int
+        :param number_of_trajectories: Number of trajectories to simulate
+        :type number_of_trajectories: int
+        :param increment: Save point increment for recording data
+        :type increment: float
+        :param timeout: Seconds to run before stopping the simulation, 0 for no limit
+        :type timeout: int
+        :param seed: The random seed for the simulation. Optional, defaults to None
+        :type seed: int
+        :param number_of_threads: Number of threads trajectories are simulated on
+        :type number_of_threads: int
+        :param algorithm: Engine to simulate with, one of this solver's algorithms, defaults to the first
+        :type algorithm: str
+        :param species: Names of the species to output, in order. Optional, defaults to every species
+        :type species: list
+        :param timeline: Sorted times from 0 to output at, in place of t and increment. Optional
+        :type timeline: list
+        :param progress: Function called with the number of trajectories finished and the number of trajectories, as
+        the simulation reports them while the generator waits for the next trajectory. Optional
+        :type progress: callable
+        :return: Generator of (trajectory number, Trajectory) pairs, in the order trajectories finish
+        """
+        if self.model is None or not self.__compiled:
+            raise gillespyError.SimulationError('run_iter requires a solver constructed with a model.')
+        if self.continuous:
+            raise gillespyError.SimulationError('{} does not stream trajectories.'.format(self.name))
+        if not isinstance(number_of_threads, int) or number_of_threads < 1:
+            raise gillespyError.SimulationError('number_of_threads must be a positive integer.')
+        algorithm = self.algorithms[0] if algorithm is None else algorithm
+        engine_args = self._algorithm_args(algorithm, kwargs)
+        self._check_model_features(self.model, algorithm)
+        observe_args, observed_species = self._observe_args(species)
+        for key in kwargs:
+            log.warning('Unsupported keyword argument to {0} solver: {1}'.format(self.name, key))
+
+        if seed is not None:
+            if not isinstance(seed, int) and int(seed) <= 0:
+                raise gillespyError.ModelError("seed must be a positive integer")
+            engine_args += ['-seed', str(int(seed))]
+        if progress is not None:
+            engine_args.append('-progress')
+
+        timeline_args, timeline_path, number_timesteps = self._timeline_args(self.model, t, increment, None, timeline)
+        args = [os.path.join(self.output_directory, self.target), '-trajectories', str(number_of_trajectories),
+                '-timesteps', str(number_timesteps), '-end', str(t), '-threads', str(number_of_threads),
+                '-stream'] + engine_args + observe_args + timeline_args + self.__model_args
+        return self.__stream(args, timeout, progress, timeline_path, observed_species)
+
+    def __stream(self, args, timeout, progress, timeline_path, observed_species):
+        # Generator of run_iter, which validates its arguments as it is called
+        try:
+            for timeline, trajectory_number, populations in cutils._stream_simulation(args, timeout, progress):
+                # Counts are converted to floats, as for every other solver's results
+                populations = populations.astype(np.float64)
+                data = {'time': timeline}
+                for i in range(len(observed_species)):
+                    data[observed_species[i]] = populations[:, i]
+                yield trajectory_number, Trajectory(data=data, model=self.model, solver_name=self.name)
+        finally:
+            if timeline_path is not None:
+                os.remove(timeline_path)
@@ -0,0 +1,83 @@
+from gillespy2.core import gillespyError
+from gillespy2.solvers.cpp.ssa_c_solver import SSACSolver
+
+
+class TauHybridCSolver(SSACSolver):
+    """
+    A C++ hybrid SSA/ODE Solver for GillesPy2 models.  As in the TauHybridSolver, each species is represented by its
+    mode, switch_tol and switch_min as discrete or continuous over every timestep.  Reactions whose reactants and
+    products are all continuous are integrated by the stiff Rosenbrock method of the ODECSolver, and every other
+    reaction fires discretely at the time its integrated propensity reaches an exponentially distributed target.
+    Species changed by rate rules are always continuous, and assignment rules and events are carried out after every
+    step.  Populations are returned as floating point values.  The model is compiled once, as for the SSACSolver, and may
+    be run repeatedly.
+    """
+    name = "TauHybridCSolver"
+    algorithms = ('hybrid',)
+    continuous = True
+    rule_algorithms = ('hybrid',)
+    rate_rule_algorithms = ('hybrid',)
+    generic = False
+    modes = {'discrete': 0, 'continuous': 1, 'dynamic': 2, None: 2}
+
+    def get_solver_settings(self):
+        """
+        :return: Tuple of strings, denoting all keyword argument for this solvers run() method.
+        """
+        return ('model', 't', 'number_of_trajectories', 'timeout', 'increment', 'seed', 'debug',
+                'number_of_threads', 'integrator_options', 'species', 'timeline')
+
+    def _algorithm_args(self, algorithm, kwargs):
+        integrator_options = kwargs.pop('integrator_options', None) or {}
+        rtol = integrator_options.get('rtol', 1e-6)
+        atol = integrator_options.get('atol', 1e-9)
+        for tolerance in (rtol, atol):
+            if not isinstance(tolerance, (int, float)) or tolerance <= 0:
+                raise gillespyError.SimulationError('integrator_options rtol and atol must be positive numbers.')
+        species = [self.model.listOfSpecies[name] for name in self.species]
+        return super(TauHybridCSolver, self)._algorithm_args(algorithm, kwargs) + [
+            '-modes', ','.join(str(self.modes[s.mode]) for s in species),
+            '-switch_tol', ','.join(repr(float(s.switch_tol)) for s in species),
+            '-switch_min', ','.join(repr(float(s.switch_min)) for s in species),
+            '-rtol', repr(float(rtol)), '-atol', repr(float(atol))]
+
+    def run(self=None, model=None, t=20, number_of_trajectories=1, timeout=0, increment=0.05, seed=None,
+            debug=False, profile=False, number_of_threads=1, algorithm='hybrid', resume=None, integrator_options=None,
+            sparse_output=False, record_every=None, **kwargs):
+        """
+        Function calling simulation of the model. This is typically called by the run function in GillesPy2 model
+        objects and will inherit those parameters which are passed with the model as the arguments this run function.
+
+        :param model: GillesPy2 model object to simulate
+        :type model: gillespy2.Model
+        :param t: Simulation run time
+        :type t: int
+        :param number_of_trajectories: Number of trajectories to simulate
+        :type number_of_trajectories: int
+        :param timeout: Seconds to run before stopping the simulation, 0 for no limit
+        :type timeout: int
+        :param increment: Save point increment for recording data
+        :type increment: float
+        :param seed: The random seed for the simulation. Optional, defaults to None
+        :type seed: int
+        :param number_of_threads: Number of threads trajectories are simulated on
+        :type number_of_threads: int
+        :param integrator_options: Error tolerances 'rtol' and 'atol' of the continuous species' integration.
+        Optional, defaults to 1e-6 and 1e-9.
+        :type integrator_options: dict
+        :param species: Names of the species to output, in order. Optional, defaults to every species
+        :type species: list
+        :param timeline: Sorted times from 0 to output at, in place of t and increment. Optional, a non-uniform
+        model.tspan is used as given.
+        :type timeline: list
+        """
+        if profile or sparse_output or record_every is not None or resume is not None:
+            raise gillespyError.SimulationError('{} does not support profile, sparse_output, record_every or resume.'
+                                                .format(TauHybridCSolver.name))
+        if self is None or self.model is None:
+            self = TauHybridCSolver(model)
+
+        return SSACSolver.run(self, model=model, t=t, number_of_trajectories=number_of_trajectories,
+                              timeout=timeout, increment=increment, seed=seed, debug=debug,
+                              number_of_threads=number_of_threads, algorithm=algorithm,
+                              integrator_options=integrator_options, **kwargs)
@@ -0,0 +1,77 @@
+from gillespy2.core import gillespyError
+from gillespy2.solvers.cpp.ssa_c_solver import SSACSolver
+
+
+class TauLeapingCSolver(SSACSolver):
+    """
+    A C++ Tau Leaping Solver for GillesPy2 models.  Like the TauLeapingSolver, each step fires a Poisson
+    distributed number of every reaction over a step size tau, chosen as in Cao, Gillespie and Petzold (2006) so the
+    relative change in each reactant's population stays bounded by tau_tol.  The model is compiled once, as for the
+    SSACSolver, and may be run repeatedly.
+    """
+    name = "TauLeapingCSolver"
+    algorithms = ('tau_leaping',)
+
+    def get_solver_settings(self):
+        """
+        :return: Tuple of strings, denoting all keyword argument for this solvers run() method.
+        """
+        return ('model', 't', 'number_of_trajectories', 'timeout', 'increment', 'seed', 'debug', 'profile',
+                'number_of_threads', 'tau_tol', 'sparse_output', 'species',
+                'record_every', 'timeline')
+
+    def _algorithm_args(self, algorithm, kwargs):
+        tau_tol = kwargs.pop('tau_tol', 0.03)
+        if not isinstance(tau_tol, (int, float)) or not 0 < tau_tol < 1:
+            raise gillespyError.SimulationError('tau_tol must be a number between 0 and 1.')
+        return super(TauLeapingCSolver, self)._algorithm_args(algorithm, kwargs) + ['-tau_tol', repr(float(tau_tol))]
+
+    def run(self=None, model=None, t=20, number_of_trajectories=1, timeout=0, increment=0.05, seed=None,
+            debug=False, profile=False, number_of_threads=1, algorithm='tau_leaping', resume=None, tau_tol=0.03,
+            **kwargs):
+        """
+        Function calling simulation of the model. This is typically called by the run function in GillesPy2 model
+        objects and will inherit those parameters which are passed with the model as the arguments this run function.
+
+        :param model: GillesPy2 model object to simulate
+        :type model: gillespy2.Model
+        :param t: Simulation run time
+        :type t: int
+        :param number_of_trajectories: Number of trajectories to simulate
+        :type number_of_trajectories: int
+        :param timeout: Seconds to run before stopping the simulation, 0 for no limit
+        :type timeout: int
+        :param increment: Save point increment for recording data
+        :type increment: float
+        :param seed: The random seed for the simulation. Optional, defaults to None
+        :type seed: int
+        :param profile: Also return the engine's profile, counted by a build of the simulation with profiling
+        compiled in. Model.run exposes it as Results.profile.
+        :type profile: bool
+        :param number_of_threads: Number of threads trajectories are simulated on
+        :type number_of_threads: int
+        :param tau_tol: Relative error tolerance bounding each reactant's change over a step
+        :type tau_tol: float
+        :param sparse_output: Have the simulation output only the populations changed at each timestep, which are
+        expanded into the same results. Smaller and faster for fine increments over models with many species.
+        :type sparse_output: bool
+        :param species: Names of the species to output, in order. Optional, defaults to every species
+        :type species: list
+        :param record_every: Record each trajectory at its start and after every record_every-th leap, at the leap's
+        time, instead of at the model's tspan. Each trajectory then has its own 'time'.
+        :type record_every: int
+        :param timeline: Sorted times from 0 to output at, in place of t and increment. Optional, a non-uniform
+        model.tspan is used as given.
+        :type timeline: list
+        :param resumable: Save a checkpoint the trajectories can be resumed from with resume=, and return it after the
+        profile, as (results, return code, profile, checkpoint). Model.run sets it for runs with a timeout or resume.
+        :type resumable: bool
+        """
+        if self is None or self.model is None:
+            # Results which saved a checkpoint are resumed without recompiling, see SSACSolver.run
+            self = TauLeapingCSolver(model, resume=None if getattr(resume, 'checkpoint', None) is not None else resume)
+
+        return SSACSolver.run(self, model=model, t=t, number_of_trajectories=number_of_trajectories,
+                              timeout=timeout, increment=increment, seed=seed, debug=debug, profile=profile,
+                              number_of_threads=number_of_threads, algorithm=algorithm, resume=resume,
+                              tau_tol=tau_tol, **kwargs)
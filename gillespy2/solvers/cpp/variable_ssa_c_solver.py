@@ -1,5 +1,5 @@
 import gillespy2
-from gillespy2.core import Model, Reaction, gillespyError, GillesPySolver, log
+from gillespy2.core import Model, Reaction, gillespyError, GillesPySolver, log, Results, Trajectory
 from gillespy2.solvers.utilities import solverutils as cutils
 import signal # for solver timeout implementation
 import os  #for getting directories for C++ files
@@ -26,7 +26,6 @@ def _write_variables(outfile, model, reactions, species, parameters, parameter_m
     Else, it is defaulted to None.
    """
 
-    outfile.write("double V = {};\n".format(model.volume))
     outfile.write("std :: string s_names[] = {")
     if len(species) > 0:
         # Write model species names.
@@ -59,9 +58,20 @@ def _write_variables(outfile, model, reactions, species, parameters, parameter_m
             outfile.write('"{}", '.format(reactions[i]))
         outfile.write('"{}"'.format(reactions[-1]))
         outfile.write("};\n")
+
+
+def _write_parameters(outfile, model, parameters, parameter_mappings):
+    """
+    This function writes the members of the simulation's Parameters struct, holding the models volume and parameters
+    :param outfile: CPP file, used for simulating a model
+    :param model: The model that is being simulated
+    :param parameters: List of the models parameter names, including 'vol'
+    :param parameter_mappings: Dictionary of sanitized parameter names
+    """
+    outfile.write("  double V = {};\n".format(model.volume))
     for param in parameters:
         if param != 'vol':
-            outfile.write("double {0} = {1};\n".format(parameter_mappings[param], model.listOfParameters[param].value))
+            outfile.write("  double {0} = {1};\n".format(parameter_mappings[param], model.listOfParameters[param].value))
 
 
 def _update_parameters(outfile, model, parameters, parameter_mappings):
@@ -82,9 +92,19 @@ def _write_propensity(outfile, model, species_mappings, parameter_mappings, reac
 
 class VariableSSACSolver(GillesPySolver):
     name = "VariableSSACSolver"
-    def __init__(self, model=None, output_directory=None, delete_directory=True, resume=None):
+    # SSA engines of the C++ simulation, selected with run(algorithm=...)
+    algorithms = ('direct', 'next_reaction', 'composition_rejection')
+    def __init__(self, model=None, output_directory=None, delete_directory=True, resume=None, build='default'):
+        """
+        :param build: Build profile the simulation is compiled with, one of those of the SSACSolver
+        :type build: str
+        """
         super(VariableSSACSolver, self).__init__()
+        if build not in cutils.BUILD_PROFILES:
+            raise gillespyError.SimulationError('build must be one of {}.'.format(sorted(cutils.BUILD_PROFILES)))
+        self.build = build
         self.__compiled = False
+        self.__server = None
         self.delete_directory = False
         self.model = model
         self.resume = resume
@@ -118,9 +138,18 @@ class VariableSSACSolver(GillesPySolver):
             self.__compile()
         
     def __del__(self):
+        self.close()
         if self.delete_directory and os.path.isdir(self.output_directory):
             shutil.rmtree(self.output_directory)
         
+    def close(self):
+        """
+        Stops the simulation server running this solver's model, if one was started.  It is started again by the
+        next run.
+        """
+        if getattr(self, '_VariableSSACSolver__server', None) is not None:
+            self.__server.close()
+
     def __write_template(self, template_file='VariableSimulationTemplate.cpp'):
         # Open up template file for reading.
         with open(os.path.join(self.output_directory, template_file), 'r') as template:
@@ -139,36 +168,32 @@ class VariableSSACSolver(GillesPySolver):
                                                      , self.reactions)
                         if line.startswith("REACTIONS"):
                            cutils._write_reactions(outfile, self.model, self.reactions, self.species)
+                        if line.startswith("PARAMETERS"):
+                            _write_parameters(outfile, self.model, self.parameters, self.parameter_mappings)
                         if line.startswith("PARAMETER_UPDATES"):
                             _update_parameters(outfile, self.model, self.parameters, self.parameter_mappings)
                     else:
                         outfile.write(line)
 
     def __compile(self):
-        # Use makefile.
         if self.resume:
             if self.resume[0].model != self.model:
                 raise gillespyError.ModelError('When resuming, one must not alter the model being resumed.')
-            else:
-                built = subprocess.run(
-                    ["make", "-C", self.output_directory, 'UserSimulation'],
-                    stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-        else:
-            try:
-                cleaned = subprocess.run(
-                    ["make", "-C", self.output_directory, '-f', MAKE_FILE,
-                     'cleanSimulation'],
-                    stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-                built = subprocess.run(
-                    ["make", "-C", self.output_directory, '-f', MAKE_FILE,
-                     'UserSimulation'], stdout=subprocess.PIPE,
-                    stderr=subprocess.PIPE)
-            except KeyboardInterrupt:
-                log.warning(
-                    "Solver has been interrupted during compile time, unexpected behavior may occur.")
+        try:
+            # Built simulations are cached by their generated source, so a model compiled before is not rebuilt
+            # A pgo build is trained on a few trajectories over model.tspan, at the model's parameters
+            training_args = ['-trajectories', '4', '-timesteps', str(len(self.model.tspan)), '-end',
+                             str(self.model.tspan[-1]), '-seed', '1']
+            built = cutils._build_simulation(self.output_directory, GILLESPY_C_DIRECTORY, MAKE_FILE, build=self.build,
+                                             training_args=training_args)
+        except KeyboardInterrupt:
+            log.warning("Solver has been interrupted during compile time, unexpected behavior may occur.")
+            raise
 
         if built.returncode == 0:
             self.__compiled = True
+            if cutils._SimulationServer.supported:
+                self.__server = cutils._SimulationServer(os.path.join(self.output_directory, 'UserSimulation'))
         else:
             raise gillespyError.BuildError("Error encountered while compiling file:\nReturn code: {0}."
                                            "\nError:\n{1}\n{2}\n".format(built.returncode, built.stdout.decode
@@ -178,11 +203,10 @@ class VariableSSACSolver(GillesPySolver):
         """
         :return: Tuple of strings, denoting all keyword argument for this solvers run() method.
         """
-        return ('model', 't', 'number_of_trajectories', 'timeout', 'increment', 'seed', 'debug', 'profile', 'variables')
+        return ('model', 't', 'number_of_trajectories', 'timeout', 'increment', 'seed', 'debug', 'profile', 'number_of_threads', 'algorithm', 'variables')
 
     def run(self=None, model=None, t=20, number_of_trajectories=1, timeout=0,
-            increment=0.05, seed=None, debug=False, profile=False, variables={}, resume=None, **kwargs):
-        pause = False
+            increment=0.05, seed=None, debug=False, profile=False, number_of_threads=1, algorithm='direct', variables={}, resume=None, **kwargs):
         if resume is not None:
             if t < resume['time'][-1]:
                 raise gillespyError.ExecutionError(
@@ -211,6 +235,164 @@ class VariableSSACSolver(GillesPySolver):
                 raise gillespyError.ModelError(
                 'Could not run Model.  SBML Feature: {} not supported by SSACSolver.'.format(detected_features))
 
+        self.__check_variables(variables)
+
+        if not isinstance(number_of_threads, int) or number_of_threads < 1:
+            raise gillespyError.SimulationError('number_of_threads must be a positive integer.')
+        if algorithm not in self.algorithms:
+            raise gillespyError.SimulationError('algorithm must be one of {}.'.format(self.algorithms))
+
+        return_code = 0
+        if self.__compiled:
+            populations, parameter_values = self.__variable_values(model, variables, resume)
+            self.simulation_data = None
+
+            if resume is not None:
+                t = abs(t - int(resume['time'][-1]))
+
+            number_timesteps = int(round(t/increment + 1))
+            options = [('-trajectories', str(number_of_trajectories)),
+                       ('-timesteps', str(number_timesteps)),
+                       ('-end', str(t)),
+                       ('-initial_values', populations),
+                       ('-parameters', parameter_values),
+                       ('-threads', str(number_of_threads)), ('-algorithm', algorithm), ('-binary', '')]
+            timeline, trajectories, timeStopped, return_code = self.__simulate(options, number_of_trajectories,
+                                                                            number_timesteps, seed, timeout)
+            if model.tspan[1] - model.tspan[0] == 1:
+                timeStopped = int(timeStopped)
+            self.simulation_data = self.__trajectory_data(timeline, trajectories)
+
+            if resume is not None or timeStopped != 0:
+                self.simulation_data = cutils.c_solver_resume(timeStopped, self.simulation_data, t, resume=resume)
+
+        return self.simulation_data, return_code
+
+
+    def run_sweep(self, points, t=20, number_of_trajectories=1, increment=0.05, timeout=0, seed=None,
+                  number_of_threads=1, algorithm='direct'):
+        """
+        Simulates the model at every point of a parameter sweep in one run of the compiled simulation, spreading the
+        trajectories of all points across its threads.
+
+        :param points: Species initial values and parameter values of each point, as dictionaries passed to
+        run(variables=...). Model values are used for those not given.
+        :type points: list
+        :param t: Simulation run time
+        :type t: int
+        :param number_of_trajectories: Number of trajectories to simulate at each point
+        :type number_of_trajectories: int
+        :param timeout: Seconds to run before stopping the simulation, 0 for no limit
+        :type timeout: int
+        :param increment: Save point increment for recording data
+        :type increment: float
+        :param seed: The random seed for the simulation. Optional, defaults to None
+        :type seed: int
+        :param number_of_threads: Number of threads trajectories are simulated on
+        :type number_of_threads: int
+        :param algorithm: SSA engine to simulate with, one of VariableSSACSolver.algorithms
+        :type algorithm: str
+        :return: A Results object for each point, in order
+        """
+        if self.model is None or not self.__compiled:
+            raise gillespyError.SimulationError('run_sweep requires a solver constructed with a model.')
+        if not isinstance(points, (list, tuple)) or len(points) == 0:
+            raise gillespyError.SimulationError('points must be a non-empty list of dictionaries.')
+        for variables in points:
+            self.__check_variables(variables)
+        if not isinstance(number_of_threads, int) or number_of_threads < 1:
+            raise gillespyError.SimulationError('number_of_threads must be a positive integer.')
+        if algorithm not in self.algorithms:
+            raise gillespyError.SimulationError('algorithm must be one of {}.'.format(self.algorithms))
+
+        # Each row of the batch file holds a point's initial populations followed by its parameter values
+        batch_path = os.path.join(self.output_directory, 'sweep_{}.txt'.format(os.getpid()))
+        with open(batch_path, 'w') as batch:
+            for variables in points:
+                batch.write('{} {}\n'.format(*self.__variable_values(self.model, variables)))
+
+        number_timesteps = int(round(t/increment + 1))
+        options = [('-trajectories', str(number_of_trajectories)),
+                   ('-timesteps', str(number_timesteps)),
+                   ('-end', str(t)),
+                   ('-batch', batch_path),
+                   ('-threads', str(number_of_threads)), ('-algorithm', algorithm), ('-binary', '')]
+        try:
+            timeline, trajectories, timeStopped, return_code = self.__simulate(
+                options, number_of_trajectories * len(points), number_timesteps, seed, timeout)
+        finally:
+            os.remove(batch_path)
+        if return_code == 33:
+            log.warning('GillesPy2 simulation exceeded timeout.')
+
+        # Trajectories of the block are indexed by (point, trajectory, timestep, species)
+        trajectories = trajectories.reshape((len(points), number_of_trajectories) + trajectories.shape[1:])
+        results = []
+        for point in range(len(points)):
+            point_data = self.__trajectory_data(timeline, trajectories[point])
+            if timeStopped != 0:
+                point_data = cutils.c_solver_resume(timeStopped, point_data, t)
+            results.append(Results([Trajectory(data=data, model=self.model, solver_name=self.name, rc=return_code)
+                                    for data in point_data]))
+        return results
+
+    def run_sensitivity(self, perturbed, variables={}, t=20, number_of_trajectories=1, increment=0.05, timeout=0,
+                        seed=None, number_of_threads=1):
+        """
+        Simulates the difference made by perturbing species initial values or parameters, for finite difference
+        estimates of parameter sensitivities. Each trajectory simulates the model at variables and at the perturbed
+        values together, coupled by Anderson's split propensity scheme so the two share most of their reaction events.
+        The differences have a far lower variance than those of independent runs, so far fewer trajectories estimate
+        a sensitivity to a given accuracy.
+
+        :param perturbed: Species initial values and parameter values to perturb, replacing those of variables
+        :type perturbed: dict
+        :param variables: Species initial values and parameter values of the base run, as passed to run(variables=...)
+        :type variables: dict
+        :param t: Simulation run time
+        :type t: int
+        :param number_of_trajectories: Number of coupled trajectories to simulate
+        :type number_of_trajectories: int
+        :param increment: Save point increment for recording data
+        :type increment: float
+        :param timeout: Seconds to run before stopping the simulation, 0 for no limit
+        :type timeout: int
+        :param seed: The random seed for the simulation. Optional, defaults to None
+        :type seed: int
+        :param number_of_threads: Number of threads trajectories are simulated on
+        :type number_of_threads: int
+        :return: A Results object whose trajectories hold the perturbed minus the base species counts
+        """
+        if self.model is None or not self.__compiled:
+            raise gillespyError.SimulationError('run_sensitivity requires a solver constructed with a model.')
+        self.__check_variables(variables)
+        self.__check_variables(perturbed)
+        if not isinstance(number_of_threads, int) or number_of_threads < 1:
+            raise gillespyError.SimulationError('number_of_threads must be a positive integer.')
+
+        populations, parameter_values = self.__variable_values(self.model, variables)
+        perturbed_values = '{} {}'.format(*self.__variable_values(self.model, dict(variables, **perturbed)))
+        number_timesteps = int(round(t/increment + 1))
+        options = [('-trajectories', str(number_of_trajectories)),
+                   ('-timesteps', str(number_timesteps)),
+                   ('-end', str(t)),
+                   ('-initial_values', populations),
+                   ('-parameters', parameter_values),
+                   ('-perturbed', perturbed_values),
+                   ('-threads', str(number_of_threads)), ('-binary', '')]
+        timeline, trajectories, timeStopped, return_code = self.__simulate(options, number_of_trajectories,
+                                                                        number_timesteps, seed, timeout)
+        if return_code == 33:
+            log.warning('GillesPy2 simulation exceeded timeout.')
+
+        # Differences are written as int32 counts in the unsigned population slots
+        simulation_data = self.__trajectory_data(timeline, trajectories.view(np.int32))
+        if timeStopped != 0:
+            simulation_data = cutils.c_solver_resume(timeStopped, simulation_data, t)
+        return Results([Trajectory(data=data, model=self.model, solver_name=self.name, rc=return_code)
+                        for data in simulation_data])
+
+    def __check_variables(self, variables):
         if not isinstance(variables, dict):
             raise gillespyError.SimulationError(
                 'argument to variables must be a dictionary.')
@@ -219,110 +401,79 @@ class VariableSSACSolver(GillesPySolver):
                 raise gillespyError.SimulationError('Argument to variable "{}" \
                 is not a valid variable.  Variables must be model species or parameters.'.format(v))
 
-        if self.__compiled:
-            populations = ''
-            parameter_values = ''
-            # Update Species Initial Values
-            for i in range(len(self.species) - 1):
-                if self.species[i] in variables:
-                    populations += '{} '.format(int(variables[self.species[i]]))
-                else:
-                    if resume is not None:
-                        populations += '{} '.format(int(resume[self.species[i]][-1]))
-                    else:
-                        populations += '{} '.format(int(model.listOfSpecies[self.species[i]].initial_value))
-            if self.species[-1] in variables:
-                populations += '{}'.format(int(variables[self.species[-1]]))
+    def __variable_values(self, model, variables, resume=None):
+        """
+        :return: The species initial values and parameter values given to the simulation, as space separated strings
+        in the orders of self.species and self.parameters. Values in variables replace the models or resumed values.
+        """
+        populations = []
+        for species in self.species:
+            if species in variables:
+                populations.append(int(variables[species]))
+            elif resume is not None:
+                populations.append(int(resume[species][-1]))
             else:
-                if resume is not None:
-                    populations += '{} '.format(int(resume[self.species[-1]][-1]))
-                else:
-                    populations += '{}'.format(int(model.listOfSpecies[self.species[-1]].initial_value))
-            # Update Parameter Values
-            for i in range(len(self.parameters) - 1):
-                if self.parameters[i] in variables:
-                    parameter_values += '{} '.format(variables[self.parameters[i]])
-                else:
-                    if self.parameters[i] == 'vol':
-                        parameter_values += '{} '.format(model.volume)
-                    else:
-                        parameter_values += '{} '.format(model.listOfParameters[self.parameters[i]].expression)
-            if self.parameters[-1] in variables:
-                parameter_values += '{}'.format(variables[self.parameters[-1]])
+                populations.append(int(model.listOfSpecies[species].initial_value))
+        parameter_values = []
+        for parameter in self.parameters:
+            if parameter in variables:
+                parameter_values.append(variables[parameter])
+            elif parameter == 'vol':
+                parameter_values.append(model.volume)
             else:
-                if self.parameters[-1] == 'vol':
-                    parameter_values += '{}'.format(model.volume)
-                else:
-                    parameter_values += '{}'.format(model.listOfParameters[self.parameters[-1]].expression)
-            self.simulation_data = None
+                parameter_values.append(model.listOfParameters[parameter].expression)
+        return ' '.join(str(value) for value in populations), ' '.join(str(value) for value in parameter_values)
 
-            if resume is not None:
-                t = abs(t - int(resume['time'][-1]))
-
-            number_timesteps = int(round(t/increment + 1))
-            # Execute simulation.
-            args = [os.path.join(self.output_directory, 'UserSimulation'),
-                    '-trajectories', str(number_of_trajectories),
-                    '-timesteps', str(number_timesteps),
-                    '-end', str(t),
-                    '-initial_values', populations,
-                    '-parameters', parameter_values]
-            if seed is not None:
-                if isinstance(seed, int):
-                    args.append('-seed')
-                    args.append(str(seed))
-                else:
-                    seed_int = int(seed)
-                    if seed_int > 0:
-                        args.append('-seed')
-                        args.append(str(seed_int))
-                    else:
-                        raise gillespyError.ModelError("seed must be a positive integer")
-
-            # begin subprocess c simulation with timeout (default timeout=0 will not timeout)
-            with subprocess.Popen(args, stdout=subprocess.PIPE, start_new_session=True) as simulation:
-                try:
-                    if timeout > 0:
-                        stdout, stderr = simulation.communicate(timeout=timeout)
-                    else:
-                        stdout, stderr = simulation.communicate()
-                    return_code = simulation.wait()
-                except KeyboardInterrupt:
-                    os.killpg(simulation.pid, signal.SIGINT)  # send signal to the process group
-                    stdout, stderr = simulation.communicate()
-                    pause = True
-                    return_code = 33
-                except subprocess.TimeoutExpired:
-                    os.killpg(simulation.pid, signal.SIGINT)  # send signal to the process group
-                    stdout, stderr = simulation.communicate()
-                    pause = True
-                    return_code = 33
-            # Decode from byte, split by comma into array
-            stdout = stdout.decode('utf-8').split(',')
-            # Parse/return results.
-
-            if return_code in [0, 33]:
-                trajectory_base, timeStopped = cutils._parse_binary_output(stdout, number_of_trajectories,
-                                                                           number_timesteps, len(model.listOfSpecies),
-                                                                           stdout, pause=pause)
-                if model.tspan[1] - model.tspan[0] == 1:
-                    timeStopped = int(timeStopped)
-
-                # Format results
-                self.simulation_data = []
-                for trajectory in range(number_of_trajectories):
-                    data = {'time': trajectory_base[trajectory, :, 0]}
-                    for i in range(len(self.species)):
-                        data[self.species[i]] = trajectory_base[trajectory, :, i + 1]
-
-                    self.simulation_data.append(data)
+    def __simulate(self, options, number_of_trajectories, number_timesteps, seed, timeout):
+        """
+        Runs the compiled simulation with the given options, on the simulation server when there is one.
+        :param number_of_trajectories: Total number of trajectories the options simulate
+        :return: Timeline, read-only trajectories indexed by (trajectory, timestep, species), the time the simulation
+        stopped at if it was interrupted and the return code, 33 if it was interrupted
+        """
+        options = list(options)
+        if seed is not None:
+            if isinstance(seed, int):
+                options.append(('-seed', str(seed)))
             else:
-                raise gillespyError.ExecutionError("Error encountered while running simulation C++ file:"
-                                                   "\nReturn code: {0}.\nError:\n{1}\n".
-                                                   format(simulation.returncode, simulation.stderr))
+                seed_int = int(seed)
+                if seed_int > 0:
+                    options.append(('-seed', str(seed_int)))
+                else:
+                    raise gillespyError.ModelError("seed must be a positive integer")
 
-            if resume is not None or timeStopped != 0:
-                self.simulation_data = cutils.c_solver_resume(timeStopped, self.simulation_data, t, resume=resume)
+        # Have the simulation write its results in place, so they are never copied through a pipe
+        results_args, results_path = cutils._results_file_args(self.output_directory, number_of_trajectories,
+                                                               number_timesteps, len(self.species))
+        options += list(zip(results_args[::2], results_args[1::2]))
 
-        return self.simulation_data, return_code
+        if self.__server is not None:
+            # The simulation server keeps the model loaded between runs
+            stdout, pause = self.__server.run(options, mapped=results_path is not None, timeout=timeout)
+            status = int(np.frombuffer(stdout, dtype=cutils.BINARY_HEADER, count=1)[0]['status'])
+            return_code = 33 if pause else status
+        else:
+            args = [os.path.join(self.output_directory, 'UserSimulation')]
+            for option, value in options:
+                args += [option, value] if value else [option]
+            # begin subprocess c simulation with timeout (default timeout=0 will not timeout)
+            stdout, return_code, pause = cutils._run_simulation(args, timeout)
+        if return_code not in [0, 33]:
+            cutils._remove_results_file(results_path)
+            raise gillespyError.ExecutionError("Error encountered while running simulation C++ file:"
+                                               "\nReturn code: {0}.\n".format(return_code))
+        timeline, trajectories, timeStopped = cutils._read_binary_results(stdout, results_path, pause=pause)
+        return timeline, trajectories, timeStopped, return_code
 
+    def __trajectory_data(self, timeline, trajectories):
+        # Format results, each species is a view into one float array converted from the simulation
+        # output in a single pass, so counts behave as they do for every other solver
+        timeline = np.array(timeline)
+        trajectories = trajectories.astype(np.float64)
+        simulation_data = []
+        for trajectory in range(trajectories.shape[0]):
+            data = {'time': timeline}
+            for i in range(len(self.species)):
+                data[self.species[i]] = trajectories[trajectory, :, i]
+            simulation_data.append(data)
+        return simulation_data
@@ -1,8 +1,19 @@
 import os  # for getting directories for C++ files
 import shutil  # for deleting/copying files
 import ast  # for dependency graphing
+import re  # for indexing batch propensities by lane
+import uuid  # for naming results files
+import hashlib  # for keying the compiled simulation cache
+import subprocess  # for calling make and querying the compiler
+import tempfile  # for building cache entries before publishing them
+import select  # for timing out reads from simulation servers
+import signal  # for interrupting simulations
+import struct  # for writing model descriptions of the generic simulation
+import threading  # for serializing requests to simulation servers
+import time  # for simulation server timeouts
 import numpy as np
 from gillespy2.core import log, Species
+from gillespy2.core.gillespyError import ExecutionError
 
 
 """
@@ -34,6 +45,207 @@ def _copy_files(destination, GILLESPY_C_DIRECTORY):
             shutil.copy(src_file, destination)
 
 
+# Library and precompiled header shared by every simulation, built by the makefile's cbase target
+CBASE_FILES = ('libgillespy_cbase.a', 'simulation.h.gch')
+# Optimization flags of each build profile: fast builds quickest, for short runs, default is the -O3 build, and native
+# runs fastest on the host that built it, optimizing the c_base library along with the simulation. pgo builds as native,
+# then rebuilds the simulation optimized by the profile of a training run.
+BUILD_PROFILES = {'fast': '-O1', 'default': '-O3', 'native': '-O3 -march=native -flto -ffat-lto-objects',
+                  'pgo': '-O3 -march=native -flto -ffat-lto-objects'}
+# Seconds the training run of a pgo build may take
+PGO_TRAINING_TIMEOUT = 60
+_compiler_identity = None
+_host_identity = None
+_nvcc_identities = {}
+
+
+def _cache_directory():
+    """
+    This function finds the directory compiled simulations are cached in. It is $GILLESPY2_CACHE_DIR if set, else
+    gillespy2 in the user cache directory. Setting GILLESPY2_CACHE_DIR to an empty string disables the cache.
+    :return: Path of the cache directory, or None if caching is disabled
+    """
+    directory = os.environ.get('GILLESPY2_CACHE_DIR')
+    if directory is None:
+        directory = os.path.join(os.environ.get('XDG_CACHE_HOME', os.path.join(os.path.expanduser('~'), '.cache')),
+                                 'gillespy2')
+    return directory or None
+
+
+def _compiler_hash():
+    """
+    This function identifies the C++ compiler used by the makefile, so cached builds are not reused across compilers
+    :return: Bytes of the compiler's version and target
+    """
+    global _compiler_identity
+    if _compiler_identity is None:
+        version = subprocess.run(['g++', '--version'], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        target = subprocess.run(['g++', '-dumpmachine'], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        _compiler_identity = version.stdout + target.stdout
+    return _compiler_identity
+
+
+def _host_hash():
+    """
+    This function identifies the instruction set -march=native targets, so cached native builds are only reused on
+    hosts they run on
+    :return: Bytes of the compiler's target options for the host
+    """
+    global _host_identity
+    if _host_identity is None:
+        options = subprocess.run(['g++', '-march=native', '-Q', '--help=target'], stdout=subprocess.PIPE,
+                                 stderr=subprocess.PIPE)
+        _host_identity = options.stdout
+    return _host_identity
+
+
+def _nvcc_hash():
+    """
+    This function identifies the CUDA compiler the makefile builds UserSimulationGPU with, nvcc or $NVCC, so cached GPU
+    builds are not reused across CUDA toolkits
+    :return: Bytes of the compiler's version, or empty if it cannot be run
+    """
+    nvcc = os.environ.get('NVCC', 'nvcc')
+    if nvcc not in _nvcc_identities:
+        try:
+            version = subprocess.run([nvcc, '--version'], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+            _nvcc_identities[nvcc] = nvcc.encode('utf-8') + version.stdout
+        except OSError:
+            _nvcc_identities[nvcc] = b''
+    return _nvcc_identities[nvcc]
+
+
+def _publish(source, destination):
+    """
+    This function moves a finished cache entry into place. Entries are only ever published whole, so concurrent
+    workers either see a complete entry or none. If another worker published the same entry first, source is removed.
+    """
+    try:
+        os.rename(source, destination)
+    except OSError:
+        if os.path.isdir(source):
+            shutil.rmtree(source, ignore_errors=True)
+        elif os.path.exists(source):
+            os.remove(source)
+
+
+def _cbase_objects(cache_directory, c_base_directory, make_file, build='default'):
+    """
+    This function finds or builds the c_base library and precompiled header in the cache, keyed by the c_base sources,
+    makefile, compiler and build profile.
+    :param cache_directory: Root of the simulation cache
+    :param c_base_directory: Directory of the c_base sources
+    :param make_file: Makefile the objects are built with
+    :param build: Build profile, one of BUILD_PROFILES
+    :return: Directory holding the c_base sources and objects, and its key; or (None, None) if they could not be built
+    """
+    flags = BUILD_PROFILES[build]
+    key = hashlib.sha256(_compiler_hash() + flags.encode('utf-8'))
+    if '-march=native' in flags:
+        key.update(_host_hash())
+    for name in sorted(os.listdir(c_base_directory)) + [make_file]:
+        path = os.path.join(c_base_directory, name)
+        if os.path.isfile(path):
+            key.update(name.encode('utf-8'))
+            with open(path, 'rb') as source:
+                key.update(source.read())
+    key = key.hexdigest()
+    objects_directory = os.path.join(cache_directory, key)
+    if all(os.path.isfile(os.path.join(objects_directory, name)) for name in CBASE_FILES):
+        return objects_directory, key
+
+    os.makedirs(cache_directory, exist_ok=True)
+    build_directory = tempfile.mkdtemp(prefix='.build-', dir=cache_directory)
+    _copy_files(build_directory, c_base_directory)
+    built = subprocess.run(['make', '-C', build_directory, '-f', make_file, 'cbase', 'OPTFLAGS={}'.format(flags)],
+                           stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if built.returncode != 0:
+        shutil.rmtree(build_directory, ignore_errors=True)
+        return None, None
+    _publish(build_directory, objects_directory)
+    return objects_directory, key
+
+
+def _make_simulation(output_directory, make_file, target, make_args, build, training_args):
+    """
+    This function runs make to build a simulation. A pgo build of UserSimulation is built instrumented, trained, and
+    rebuilt optimized by the profile of its training run.
+    :return: subprocess.CompletedProcess of the build
+    """
+    def make(*args):
+        return subprocess.run(['make', '-C', output_directory, '-f', make_file, target] + make_args + list(args),
+                              stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+
+    if build != 'pgo' or target != 'UserSimulation' or training_args is None:
+        return make()
+    built = make('PGOFLAGS=-fprofile-generate')
+    if built.returncode != 0:
+        return built
+    # The profile is written to UserSimulation.gcda as the training run exits, a run cut short leaves none to use
+    try:
+        subprocess.run([os.path.join(output_directory, target)] + list(training_args), stdout=subprocess.DEVNULL,
+                       stderr=subprocess.DEVNULL, timeout=PGO_TRAINING_TIMEOUT)
+    except subprocess.TimeoutExpired:
+        log.warning('The training run of a pgo build exceeded {} seconds, the simulation is built without its profile.'
+                    .format(PGO_TRAINING_TIMEOUT))
+    os.remove(os.path.join(output_directory, 'UserSimulation.o'))
+    # Trajectories run on several threads update the profile's counters concurrently, so it is corrected when read
+    return make('PGOFLAGS=-fprofile-use -fprofile-correction -Wno-missing-profile')
+
+
+def _build_simulation(output_directory, c_base_directory, make_file, target='UserSimulation', build='default',
+                      training_args=None):
+    """
+    This function builds output_directory/UserSimulation from the UserSimulation.cpp written there. Built simulations
+    are cached on disk keyed by their source, the c_base sources, makefile, compiler and build profile, and nvcc for
+    UserSimulationGPU, so a cache hit skips compilation entirely. The c_base library and precompiled header are cached and reused by every simulation
+    rather than rebuilt.
+    :param output_directory: Directory holding UserSimulation.cpp and the copied c_base files
+    :param c_base_directory: Directory of the c_base sources
+    :param make_file: Makefile the simulation is built with
+    :param target: Makefile target to build, UserSimulationProfile builds the simulation with profiling compiled in
+    :param build: Build profile, one of BUILD_PROFILES
+    :param training_args: Command line arguments of the simulation's training run, for a pgo build of UserSimulation
+    :return: subprocess.CompletedProcess of the build
+    """
+    make_args = ['OPTFLAGS={}'.format(BUILD_PROFILES[build])]
+    cache_directory = _cache_directory()
+    try:
+        objects_directory, objects_key = (None, None) if cache_directory is None else \
+            _cbase_objects(cache_directory, c_base_directory, make_file, build)
+    except OSError as e:
+        log.debug('Compiled simulation cache unavailable: {}'.format(e))
+        objects_directory = None
+    if objects_directory is None:
+        return _make_simulation(output_directory, make_file, target, make_args, build, training_args)
+
+    with open(os.path.join(output_directory, 'UserSimulation.cpp'), 'rb') as source:
+        key = hashlib.sha256(objects_key.encode('utf-8') + source.read())
+    if target == 'UserSimulationGPU':
+        key.update(_nvcc_hash())
+    key = key.hexdigest()
+    for suffix in (target, build):
+        if suffix not in ('UserSimulation', 'default'):
+            key = '{}-{}'.format(key, suffix)
+    cached_simulation = os.path.join(objects_directory, 'simulations', key)
+    simulation = os.path.join(output_directory, target)
+    if os.path.isfile(cached_simulation):
+        shutil.copy2(cached_simulation, simulation)
+        return subprocess.CompletedProcess(args=[], returncode=0, stdout=b'', stderr=b'')
+
+    built = _make_simulation(output_directory, make_file, target, make_args + ['OBJ_DIR={}'.format(objects_directory)],
+                             build, training_args)
+    if built.returncode == 0:
+        try:
+            os.makedirs(os.path.dirname(cached_simulation), exist_ok=True)
+            staged_simulation = '{}.{}'.format(cached_simulation, uuid.uuid4().hex)
+            shutil.copy2(simulation, staged_simulation)
+            _publish(staged_simulation, cached_simulation)
+        except OSError as e:
+            log.debug('Could not cache compiled simulation: {}'.format(e))
+    return built
+
+
 def _write_propensity(outfile, model, species_mappings, parameter_mappings, reactions):
     """
     This functions writes a models propensity functions to a cpp user simulation template, for the SSACSolvers.
@@ -53,26 +265,520 @@ def _write_propensity(outfile, model, species_mappings, parameter_mappings, reac
                                                                                         parameter_mappings)))
 
 
+def _write_batch_propensity(outfile, model, species_mappings, parameter_mappings, reactions):
+    """
+    This function writes a models propensity functions as loops over the lanes of a batch of trajectories, for the
+    batch_direct engine. Each species population S[i] is read as S[i][lane], so the compiler can vectorize the loops.
+    :param outfile: File where the propensity function will be written to
+    :param model: Model used to access species, reactions
+    :param species_mappings: Sanitized species names
+    :param parameter_mappings: Sanitized parameter names
+    :param reactions: Names of reactions
+    """
+    for i in range(len(reactions)):
+        propensity = model.listOfReactions[reactions[i]].sanitized_propensity_function(species_mappings,
+                                                                                       parameter_mappings)
+        outfile.write("""
+        case {0}:
+            for(unsigned int lane = 0; lane < batch_width; lane++){{
+                propensities[lane] = {1};
+            }}
+            break;
+        """.format(i, re.sub(r'\bS\[(\d+)\]', r'S[\1][lane]', propensity)))
+
+
+def _expression_names(expression, model=None):
+    """
+    This function finds the names an expression reads. Names of the models function definitions and assignment rule
+    variables are expanded to the names their bodies and formulas read, so species read through them are found.
+    :param expression: Expression string, such as a propensity function
+    :param model: Model whose function definitions and assignment rules are expanded, or None to expand neither
+    :return: Set of names
+    """
+    functions, rules = {}, {}
+    if model is not None:
+        functions = {name: function.function_string for name, function in model.listOfFunctionDefinitions.items()}
+        for rule in model.listOfAssignmentRules.values():
+            rules.setdefault(_variable_name(rule.variable), []).append(rule.formula)
+    names, expressions = set(), [expression]
+    while expressions:
+        for node in ast.walk(ast.parse(expressions.pop(), mode='eval')):
+            if not isinstance(node, ast.Name) or node.id in names:
+                continue
+            names.add(node.id)
+            if node.id in functions:
+                expressions.append(functions[node.id])
+            expressions.extend(rules.get(node.id, ()))
+    return names
+
+
+def _propensity_species(reaction, species, model=None):
+    """
+    This function finds which species a reactions propensity function reads, directly or through the models function
+    definitions and assignment rules
+    :param reaction: Reaction whose propensity function is parsed
+    :param species: Ordered list of species names, as used by the C++ simulation
+    :param model: Model whose function definitions and assignment rules are expanded
+    :return: Sorted list of indices into species
+    """
+    names = _expression_names(reaction.propensity_function, model)
+    return [j for j in range(len(species)) if species[j] in names]
+
+
+def _rate_species(reaction, species, model=None):
+    """
+    This function finds which species a reactions ODE propensity function, its deterministic rate, reads, directly or
+    through the models function definitions and assignment rules
+    :param reaction: Reaction whose ODE propensity function is parsed
+    :param species: Ordered list of species names, as used by the C++ simulation
+    :param model: Model whose function definitions and assignment rules are expanded
+    :return: Sorted list of indices into species
+    """
+    names = _expression_names(reaction.ode_propensity_function, model)
+    return [j for j in range(len(species)) if species[j] in names]
+
+
+# C++ names of the functions and constants expressions may use
+_CPP_FUNCTIONS = {'abs': 'fabs', 'exp': 'exp', 'log': 'log', 'sqrt': 'sqrt', 'pow': 'pow', 'sin': 'sin', 'cos': 'cos',
+                  'tan': 'tan', 'floor': 'floor', 'ceil': 'ceil'}
+_CPP_CONSTANTS = {'pi': 'M_PI', 'e': 'M_E'}
+
+
+def _cpp_expression(node, names, functions=()):
+    """
+    This function writes a parsed ODE propensity function, rule, or event expression as a C++ expression. Numbers are
+    written as doubles, so divisions of integers are not truncated, and powers are written with pow. Comparisons and
+    boolean operators are written for event triggers.
+    :param node: ast node of the expression
+    :param names: Dictionary of the C++ expression of each species and parameter name
+    :param functions: Names of the model's function definitions, which are called as written
+    :return: C++ expression
+    """
+    if isinstance(node, ast.Expression):
+        return _cpp_expression(node.body, names, functions)
+    if isinstance(node, ast.Name):
+        return names.get(node.id, _CPP_CONSTANTS.get(node.id, node.id))
+    if isinstance(node, ast.Constant) and isinstance(node.value, bool):
+        return 'true' if node.value else 'false'
+    if isinstance(node, ast.Constant) and isinstance(node.value, (int, float)):
+        return repr(float(node.value))
+    if isinstance(node, ast.UnaryOp) and isinstance(node.op, (ast.USub, ast.UAdd)):
+        return '({}{})'.format('-' if isinstance(node.op, ast.USub) else '+',
+                               _cpp_expression(node.operand, names, functions))
+    if isinstance(node, ast.UnaryOp) and isinstance(node.op, ast.Not):
+        return '(!{})'.format(_cpp_expression(node.operand, names, functions))
+    if isinstance(node, ast.BinOp):
+        left, right = _cpp_expression(node.left, names, functions), _cpp_expression(node.right, names, functions)
+        if isinstance(node.op, ast.Pow):
+            return 'pow({}, {})'.format(left, right)
+        operators = {ast.Add: '+', ast.Sub: '-', ast.Mult: '*', ast.Div: '/'}
+        if type(node.op) in operators:
+            return '({} {} {})'.format(left, operators[type(node.op)], right)
+    if isinstance(node, ast.BoolOp):
+        operator = ' && ' if isinstance(node.op, ast.And) else ' || '
+        return '({})'.format(operator.join(_cpp_expression(value, names, functions) for value in node.values))
+    if isinstance(node, ast.Compare):
+        # Chained comparisons hold when each comparison does
+        operators = {ast.Lt: '<', ast.LtE: '<=', ast.Gt: '>', ast.GtE: '>=', ast.Eq: '==', ast.NotEq: '!='}
+        comparisons = []
+        left = node.left
+        for operator, right in zip(node.ops, node.comparators):
+            if type(operator) not in operators:
+                break
+            comparisons.append('({} {} {})'.format(_cpp_expression(left, names, functions), operators[type(operator)],
+                                                   _cpp_expression(right, names, functions)))
+            left = right
+        else:
+            return '({})'.format(' && '.join(comparisons))
+    if isinstance(node, ast.Call) and isinstance(node.func, ast.Name) and not node.keywords \
+            and (node.func.id in _CPP_FUNCTIONS or node.func.id in functions):
+        return '{}({})'.format(node.func.id if node.func.id in functions else _CPP_FUNCTIONS[node.func.id],
+                               ', '.join(_cpp_expression(argument, names, functions) for argument in node.args))
+    raise ValueError('Cannot write {} as C++'.format(ast.dump(node)))
+
+
+def _derivative(node, variable):
+    """
+    This function differentiates a parsed ODE propensity function by one of its names.
+    :param node: ast node of the expression
+    :param variable: Name differentiated by
+    :return: ast node of the derivative, or None where it is 0. Raises ValueError for expressions with no rule here.
+    """
+    if isinstance(node, ast.Expression):
+        return _derivative(node.body, variable)
+    if isinstance(node, ast.Name):
+        return ast.Constant(1.0) if node.id == variable else None
+    if isinstance(node, ast.Constant):
+        return None
+
+    def product(left, right):
+        if left is None or right is None:
+            return None
+        for factor, other in ((left, right), (right, left)):
+            if isinstance(factor, ast.Constant) and factor.value == 1:
+                return other
+        return ast.BinOp(left, ast.Mult(), right)
+
+    def total(left, right, operator=ast.Add):
+        if left is None:
+            return right if right is None or operator is ast.Add else ast.UnaryOp(ast.USub(), right)
+        return left if right is None else ast.BinOp(left, operator(), right)
+
+    if isinstance(node, ast.UnaryOp) and isinstance(node.op, (ast.USub, ast.UAdd)):
+        derivative = _derivative(node.operand, variable)
+        return derivative if derivative is None or isinstance(node.op, ast.UAdd) else ast.UnaryOp(ast.USub(),
+                                                                                                   derivative)
+    if isinstance(node, ast.Call) and isinstance(node.func, ast.Name) and node.func.id == 'pow' \
+            and len(node.args) == 2 and not node.keywords:
+        node = ast.BinOp(node.args[0], ast.Pow(), node.args[1])
+    if isinstance(node, ast.BinOp):
+        left, right = _derivative(node.left, variable), _derivative(node.right, variable)
+        if isinstance(node.op, (ast.Add, ast.Sub)):
+            return total(left, right, type(node.op))
+        if isinstance(node.op, ast.Mult):
+            return total(product(left, node.right), product(node.left, right))
+        if isinstance(node.op, ast.Div):
+            return total(None if left is None else ast.BinOp(left, ast.Div(), node.right),
+                         None if right is None else ast.BinOp(product(node.left, right), ast.Div(),
+                                                              ast.BinOp(node.right, ast.Mult(), node.right)),
+                         ast.Sub)
+        if isinstance(node.op, ast.Pow):
+            if right is None:
+                # d(u^n) = n u^(n-1) du
+                exponent = ast.BinOp(node.right, ast.Sub(), ast.Constant(1.0))
+                return product(product(node.right, ast.BinOp(node.left, ast.Pow(), exponent)), left)
+            # d(u^v) = u^v (dv log(u) + v du / u)
+            logarithm = ast.Call(ast.Name('log', ast.Load()), [node.left], [])
+            return product(node, total(product(right, logarithm),
+                                       None if left is None else ast.BinOp(product(node.right, left), ast.Div(),
+                                                                           node.left)))
+    if isinstance(node, ast.Call) and isinstance(node.func, ast.Name) and len(node.args) == 1 and not node.keywords:
+        argument = node.args[0]
+        inner = _derivative(argument, variable)
+        if inner is None:
+            return None
+        call = lambda name, value: ast.Call(ast.Name(name, ast.Load()), [value], [])
+        outer = {
+            'exp': lambda: node,
+            'log': lambda: ast.BinOp(ast.Constant(1.0), ast.Div(), argument),
+            'sqrt': lambda: ast.BinOp(ast.Constant(0.5), ast.Div(), node),
+            'sin': lambda: call('cos', argument),
+            'cos': lambda: ast.UnaryOp(ast.USub(), call('sin', argument)),
+        }.get(node.func.id)
+        if outer is not None:
+            return product(outer(), inner)
+    raise ValueError('Cannot differentiate {}'.format(ast.dump(node)))
+
+
+def _write_ode_propensity(outfile, model, species_mappings, parameter_mappings, reactions):
+    """
+    This function writes a models ODE propensity functions, the deterministic rate of each reaction, to a cpp user
+    simulation template, for the ODECSolver.
+    :param outfile: File where the propensity function will be written to
+    :param model: Model used to access species, reactions
+    :param species_mappings: Sanitized species names
+    :param parameter_mappings: Sanitized parameter names
+    :param reactions: Names of reactions
+    """
+    names = dict(parameter_mappings)
+    names.update(species_mappings)
+    functions = set(model.listOfFunctionDefinitions)
+    for i in range(len(reactions)):
+        reaction = model.listOfReactions[reactions[i]]
+        try:
+            rate = _cpp_expression(ast.parse(reaction.ode_propensity_function, mode='eval'), names, functions)
+        except ValueError:
+            # Written as the propensity function is, which compiles as written
+            rate = reaction.sanitized_propensity_function(species_mappings, parameter_mappings)
+        outfile.write("""
+        case {0}:
+            return {1};
+        """.format(i, rate))
+
+
+def _write_ode_jacobian(outfile, model, species_mappings, parameter_mappings, reactions, species):
+    """
+    This function writes the partial derivatives of each reactions ODE propensity function by the species it reads,
+    in the order of _rate_species, to a cpp user simulation template, for the ODECSolver. Derivatives are taken
+    analytically, a rate with a term that cannot be differentiated here is differentiated by central differences.
+    :param outfile: File where the partial derivatives will be written to
+    :param model: Model used to access species, reactions
+    :param species_mappings: Sanitized species names
+    :param parameter_mappings: Sanitized parameter names
+    :param reactions: Names of reactions
+    :param species: Names of species
+    """
+    names = dict(parameter_mappings)
+    names.update(species_mappings)
+    functions = set(model.listOfFunctionDefinitions)
+    for i in range(len(reactions)):
+        reaction = model.listOfReactions[reactions[i]]
+        expression = ast.parse(reaction.ode_propensity_function, mode='eval')
+        outfile.write("        case {0}:\n".format(i))
+        for k, j in enumerate(_rate_species(reaction, species, model)):
+            try:
+                derivative = _derivative(expression, species[j])
+                partial = '0.0' if derivative is None else _cpp_expression(derivative, names, functions)
+            except ValueError:
+                partial = 'difference({0}, S, {1})'.format(i, j)
+            outfile.write("            P[{0}] = {1};\n".format(k, partial))
+        outfile.write("            break;\n")
+
+
 def _write_reactions(outfile, model, reactions, species):
-    customrxns = {}
+    """
+    This function writes each reactions species changes, reactant counts, and the species its propensity function
+    and ODE propensity function read, to a cpp user simulation template. Model::build lays these out and builds the
+    reaction dependency graph.
+    :param outfile: File where the reactions will be written to
+    :param model: Model used to access species, reactions
+    :param reactions: Names of reactions
+    :param species: Names of species
+    """
     for i in range(len(reactions)):
         reaction = model.listOfReactions[reactions[i]]
-        if reaction.type == 'customized':
-            customrxns[i] = species_parse(model, reaction.propensity_function)
         for j in range(len(species)):
             change = (reaction.products.get(model.listOfSpecies[species[j]], 0)) - (reaction.reactants.get
                                                                                     (model.listOfSpecies[species[j]], 0)
                                                                                     )
             if change != 0:
-                outfile.write("model.reactions[{0}].species_change[{1}] = {2};\n".format(i, j, change))
+                outfile.write("model.species_changes.add({0}, {{{1}, {2}}});\n".format(i, j, change))
+            consumed = reaction.reactants.get(model.listOfSpecies[species[j]], 0)
+            if consumed != 0:
+                outfile.write("model.reactants.add({0}, {{{1}, {2}}});\n".format(i, j, consumed))
+        for j in _propensity_species(reaction, species, model):
+            outfile.write("model.propensity_species.add({0}, {1});\n".format(i, j))
+        for j in _rate_species(reaction, species, model):
+            outfile.write("model.rate_species.add({0}, {1});\n".format(i, j))
+
+
+def _variable_name(variable):
+    """
+    This function finds the name of the species or parameter a rule or event assignment sets
+    :param variable: Species, Parameter, or name
+    :return: Name of the variable
+    """
+    return getattr(variable, 'name', variable)
+
+
+def _assigned_parameters(model):
+    """
+    This function finds which parameters a models assignment rules and events set. These are written as variables of
+    each simulation thread instead of constants.
+    :param model: Model whose rules and events are searched
+    :return: Set of parameter names
+    """
+    variables = {_variable_name(rule.variable) for rule in model.listOfAssignmentRules.values()}
+    for event in model.listOfEvents.values():
+        variables.update(_variable_name(assignment.variable) for assignment in event.assignments)
+    return variables & set(model.listOfParameters)
+
+
+def _mass_action_terms(model, reaction):
+    """
+    This function finds the terms of a reactions mass-action propensity function, in the order it multiplies them
+    :param model: Model the reaction belongs to
+    :param reaction: Reaction whose propensity function is parsed
+    :return: Name of the rate parameter and list of (reactant name, stoichiometry) pairs, or None if the propensity
+    function is not the mass-action propensity of the reactions rate and reactants
+    """
+    if not reaction.massaction or getattr(reaction, 'marate', None) is None:
+        return None
+    rate = _variable_name(reaction.marate)
+    reactants = [(_variable_name(reactant), reaction.reactants[reactant]) for reactant in sorted(reaction.reactants)]
+    if rate not in model.listOfParameters or sum(count for name, count in reactants) > 2:
+        return None
+    # Written as Reaction writes it, so a propensity function changed since is not mistaken for it
+    propensity = rate
+    for name, count in reactants:
+        propensity += '*{0}*({0}-1)/vol'.format(name) if count == 2 else '*{}'.format(name)
+    if len(reactants) == 2:
+        propensity += '/vol'
+    elif not reactants:
+        propensity += '*vol'
+    if propensity != reaction.propensity_function:
+        return None
+    return rate, reactants
 
-    for i in customrxns.keys():
-        for j in range(len(reactions)):
-            if i == j:
-                continue
-            if any(elem in customrxns[i] for elem in list(model.listOfReactions[reactions[j]].reactants)) or \
-                    any(elem in customrxns[i] for elem in list(model.listOfReactions[reactions[j]].products)):
-                outfile.write("model.reactions[{0}].affected_reactions.push_back({1});\n".format(i, j))
+
+def _generic_model(model):
+    """
+    This function finds whether a model is simulated by the generic simulation, which loads models of mass-action
+    reactions at runtime from their description, so they are never compiled
+    :param model: Model to be simulated
+    :return: True if the model has no function definitions, rules or events, and every reaction is mass-action
+    """
+    if model.listOfFunctionDefinitions or model.listOfAssignmentRules or model.listOfEvents or model.listOfRateRules:
+        return False
+    return all(_mass_action_terms(model, reaction) is not None for reaction in model.listOfReactions.values())
+
+
+# Sections of the generic simulation, the same for every model, by the name of their template section
+_GENERIC_SECTIONS = {
+    'CONSTANTS': '//Loaded from the model description named by -model, see generic.h\n'
+                 'GenericModel generic_model;\n'
+                 'const std :: vector<std :: string>& s_names = generic_model.species_names;\n'
+                 'const std :: vector<unsigned int>& populations = generic_model.populations;\n'
+                 'const std :: vector<std :: string>& r_names = generic_model.reaction_names;\n',
+    'GENERIC_PROPENSITY': '      return generic_model.propensity(reaction_number, S);\n',
+    'GENERIC_BATCH_PROPENSITY': '      generic_model.propensity_batch<batch_width>(reaction_number, S, propensities);\n',
+    'GENERIC_MODEL': '  if(!generic_model.load(argc, argv)){\n    return 1;\n  }\n',
+    'GENERIC_REACTIONS': '  generic_model.build(model);\n'
+}
+
+
+def _write_model_description(path, model, species, reactions):
+    """
+    This function writes the description of a mass-action model the generic simulation loads, in the format read by
+    GenericModel::load of generic.h
+    :param path: Path of the description file
+    :param model: Model described, for which _generic_model is True
+    :param species: Names of species
+    :param reactions: Names of reactions
+    """
+    def name_bytes(name):
+        encoded = name.encode('utf-8')
+        return struct.pack('=I', len(encoded)) + encoded
+
+    def counts_bytes(counts):
+        return struct.pack('=I', len(counts)) + b''.join(struct.pack('=Ii', j, count) for j, count in counts)
+
+    description = [struct.pack('=4sIId', b'GPYM', len(species), len(reactions), float(model.volume))]
+    for name in species:
+        description.append(struct.pack('=I', int(model.listOfSpecies[name].initial_value)) + name_bytes(name))
+    for name in reactions:
+        reaction = model.listOfReactions[name]
+        rate, terms = _mass_action_terms(model, reaction)
+        # Forms of GenericModel::Form, reading the reactants in the order the propensity function multiplies them
+        readers = [species.index(term) for term, count in terms] + [0, 0]
+        form = 0 if not terms else 3 if len(terms) == 2 else terms[0][1]
+        description.append(name_bytes(name) + struct.pack('=dIII', float(model.listOfParameters[rate].value), form,
+                                                          readers[0], readers[1]))
+        changes, reactants = [], []
+        for j in range(len(species)):
+            consumed = reaction.reactants.get(model.listOfSpecies[species[j]], 0)
+            change = reaction.products.get(model.listOfSpecies[species[j]], 0) - consumed
+            if consumed != 0:
+                reactants.append((j, consumed))
+            if change != 0:
+                changes.append((j, change))
+        description.append(counts_bytes(reactants) + counts_bytes(changes))
+    with open(path, 'wb') as description_file:
+        description_file.write(b''.join(description))
+
+
+# Template sections of a models function definitions, rules, and events, written by _write_rules
+_RULE_SECTIONS = ('FUNCTIONS', 'ASSIGNMENT_RULES', 'EVENT_', 'RATE_RULE')
+
+
+def _write_rules(outfile, model, section, species_mappings, parameter_mappings, reactions, species):
+    """
+    This function writes a section of a models function definitions, assignment rules, events, and rate rules to a
+    cpp user simulation template. Function definitions are written as C++ functions of doubles, which every other
+    expression may call. Assignment rules and events are written for the ModelEvents class of the template, and
+    evaluated over populations read as doubles and the time t. Rate rules are written for its ODEFunction.
+    :param outfile: File where the section will be written to
+    :param model: Model used to access its function definitions, rules, and events
+    :param section: Name of the template section, one starting with one of _RULE_SECTIONS
+    :param species_mappings: Sanitized species names
+    :param parameter_mappings: Sanitized parameter names
+    :param reactions: Names of reactions
+    :param species: Names of species
+    """
+    functions = set(model.listOfFunctionDefinitions)
+    names = dict(parameter_mappings)
+    names.update({name: '((double) {})'.format(species_mappings[name]) for name in species})
+    names.update({'t': 't', 'time': 't'})
+    targets = dict(parameter_mappings)
+    targets.update(species_mappings)
+    events = list(model.listOfEvents.values())
+
+    def expression(text):
+        return _cpp_expression(ast.parse(str(text), mode='eval'), names, functions)
+
+    if section == 'FUNCTIONS':
+        # Declared first, so function definitions may call each other in any order
+        definitions = []
+        for name, definition in model.listOfFunctionDefinitions.items():
+            code = definition.function.__code__
+            arguments = code.co_varnames[:code.co_argcount]
+            body = _cpp_expression(ast.parse(definition.function_string, mode='eval'),
+                                   dict(parameter_mappings, **{argument: argument for argument in arguments}),
+                                   functions)
+            # Callable from the propensities of GPU engines as well
+            signature = 'GILLESPY_DEVICE double {0}({1})'.format(name, ', '.join('double ' + argument
+                                                                                 for argument in arguments))
+            outfile.write('{};\n'.format(signature))
+            definitions.append('{0}{{\n  return {1};\n}}\n'.format(signature, body))
+        outfile.write(''.join(definitions))
+    elif section == 'ASSIGNMENT_RULES':
+        for rule in model.listOfAssignmentRules.values():
+            outfile.write('    changed = assign_value({0}, {1}) || changed;\n'.format(
+                targets[_variable_name(rule.variable)], expression(rule.formula)))
+    elif section == 'EVENT_CONSTANTS':
+        assigned = {_variable_name(rule.variable) for rule in model.listOfAssignmentRules.values()}
+        for event in events:
+            assigned.update(_variable_name(assignment.variable) for assignment in event.assignments)
+        readers = [i for i in range(len(reactions)) if assigned & {node.id for node in ast.walk(ast.parse(
+            model.listOfReactions[reactions[i]].propensity_function, mode='eval')) if isinstance(node, ast.Name)}]
+        outfile.write('  static const unsigned int number_events = {};\n'.format(len(events)))
+        outfile.write('  static const bool active = {};\n'.format(
+            'true' if events or model.listOfAssignmentRules else 'false'))
+        outfile.write('  std :: vector<unsigned int> target_readers = {{{}}};\n'.format(
+            ', '.join(str(i) for i in readers)))
+    elif section == 'EVENT_RESET':
+        for name in sorted(_assigned_parameters(model)):
+            outfile.write('    {0} = {1};\n'.format(parameter_mappings[name], model.listOfParameters[name].value))
+    elif section == 'EVENT_SETTINGS':
+        for i, event in enumerate(events):
+            outfile.write('    case {0}:\n      return {{{1}, {2}, {3}, {4}, {5}}};\n'.format(
+                i, str(event.trigger.value).lower(), str(event.trigger.persistent).lower(),
+                str(event.use_values_from_trigger_time).lower(), str(event.delay is not None).lower(),
+                len(event.assignments)))
+    elif section in ('EVENT_TRIGGERS', 'EVENT_DELAYS', 'EVENT_PRIORITIES'):
+        for i, event in enumerate(events):
+            text = {'EVENT_TRIGGERS': event.trigger.expression, 'EVENT_DELAYS': event.delay or 0,
+                    'EVENT_PRIORITIES': event.priority or 0}[section]
+            outfile.write('    case {0}:\n      return {1};\n'.format(i, expression(text)))
+    elif section == 'EVENT_VALUES':
+        for i, event in enumerate(events):
+            outfile.write('    case {0}:\n'.format(i))
+            for k, assignment in enumerate(event.assignments):
+                outfile.write('      V[{0}] = {1};\n'.format(k, expression(assignment.expression)))
+            outfile.write('      break;\n')
+    elif section == 'EVENT_ASSIGNMENTS':
+        for i, event in enumerate(events):
+            outfile.write('    case {0}:\n'.format(i))
+            for k, assignment in enumerate(event.assignments):
+                outfile.write('      changed = assign_value({0}, V[{1}]) || changed;\n'.format(
+                    targets[_variable_name(assignment.variable)], k))
+            outfile.write('      break;\n')
+    elif section.startswith('RATE_RULE'):
+        # Only rate rules of species are integrated, the solvers refuse models with rate rules of parameters
+        rules = [rule for rule in model.listOfRateRules.values() if _variable_name(rule.variable) in species]
+        ode_names = dict(parameter_mappings)
+        ode_names.update(species_mappings)
+        if section == 'RATE_RULE_SPECIES':
+            outfile.write('  std :: vector<unsigned int> rate_rule_species = {{{}}};\n'.format(
+                ', '.join(str(species.index(_variable_name(rule.variable))) for rule in rules)))
+        for i, rule in enumerate(rules):
+            formula = ast.parse(rule.formula, mode='eval')
+            if section == 'RATE_RULES':
+                outfile.write('    case {0}:\n      return {1};\n'.format(
+                    i, _cpp_expression(formula, ode_names, functions)))
+            elif section == 'RATE_RULE_JACOBIAN':
+                outfile.write('    case {0}:\n'.format(i))
+                read = {node.id for node in ast.walk(formula) if isinstance(node, ast.Name)}
+                for j in range(len(species)):
+                    if species[j] not in read:
+                        continue
+                    try:
+                        derivative = _derivative(formula, species[j])
+                        partial = '0.0' if derivative is None else _cpp_expression(derivative, ode_names, functions)
+                    except ValueError:
+                        partial = 'rate_rule_difference({0}, S, {1})'.format(i, j)
+                    outfile.write('      P[{0}] = {1};\n'.format(j, partial))
+                outfile.write('      break;\n')
 
 
 def _parse_binary_output(results_buffer, number_of_trajectories, number_timesteps, number_species, data, pause=False):
@@ -105,6 +811,687 @@ def _parse_binary_output(results_buffer, number_of_trajectories, number_timestep
     return trajectory_base, timeStopped
 
 
+# Layout of Gillespy::OutputHeader, written ahead of results by simulations run with -binary
+BINARY_HEADER = np.dtype([('magic', 'S4'), ('header_size', np.uint32), ('number_trajectories', np.uint32),
+                          ('number_timesteps', np.uint32), ('number_species', np.uint32), ('status', np.uint32),
+                          ('end_time', np.float64), ('current_time', np.float64)])
+
+
+def _parse_binary_results(results_buffer, pause=False):
+    """
+    This function wraps the binary output of a CPP simulation run with -binary, without parsing or copying it
+    :param results_buffer: stdout of the CPP simulation ran
+    :type results_buffer: bytes or numpy.memmap
+    :param pause: Whether or not a model was paused, set to true when simulation was sent a KeyBoardInterrupt or
+    timeout.
+    :return: Timeline, read-only trajectories indexed by (trajectory, timestep, species), and time that simulation
+    was stopped, if sent a keyboardinterrupt or timeout.
+    """
+    if len(results_buffer) < BINARY_HEADER.itemsize:
+        raise ExecutionError('Simulation output was truncated, expected a {} byte header but received {} bytes.'
+                             .format(BINARY_HEADER.itemsize, len(results_buffer)))
+    header = np.frombuffer(results_buffer, dtype=BINARY_HEADER, count=1)[0]
+    if header['magic'] == b'GPYC':
+        return _parse_binary_changes(results_buffer, header, pause=pause)
+    if header['magic'] not in (b'GPY2', b'GPYF'):
+        raise ExecutionError('Simulation output is not in the GillesPy2 binary results format.')
+    # The ODE engine's concentrations are laid out as trajectories are, as doubles
+    value_type = np.float64 if header['magic'] == b'GPYF' else np.uint32
+    number_trajectories = int(header['number_trajectories'])
+    number_timesteps = int(header['number_timesteps'])
+    number_species = int(header['number_species'])
+    offset = int(header['header_size'])
+    expected = offset + 8 * number_timesteps + np.dtype(value_type).itemsize * number_trajectories * number_timesteps \
+        * number_species
+    if len(results_buffer) < expected:
+        raise ExecutionError('Simulation output was truncated, expected {} bytes but received {} bytes.'
+                             .format(expected, len(results_buffer)))
+
+    timeline = np.frombuffer(results_buffer, dtype=np.float64, count=number_timesteps, offset=offset)
+    offset += timeline.nbytes
+    trajectories = np.frombuffer(results_buffer, dtype=value_type,
+                                 count=number_trajectories * number_timesteps * number_species, offset=offset)
+    trajectories = trajectories.reshape((number_trajectories, number_timesteps, number_species))
+
+    timeStopped = int(header['current_time']) if pause else 0
+    return timeline, trajectories, timeStopped
+
+
+# Layout of Gillespy::PopulationChange, entries of the results of simulations run with -changes
+POPULATION_CHANGE = np.dtype([('timestep', np.uint32), ('species', np.uint32), ('population', np.uint32)])
+
+
+def _parse_binary_changes(results_buffer, header, pause=False):
+    """
+    This function expands the binary output of a CPP simulation run with -changes, which holds only the populations
+    that changed at each timestep, into dense trajectories
+    :param results_buffer: stdout of the CPP simulation ran
+    :param header: BINARY_HEADER read from the start of results_buffer
+    :param pause: Whether or not a model was paused, set to true when simulation was sent a KeyBoardInterrupt or
+    timeout.
+    :return: Timeline, trajectories indexed by (trajectory, timestep, species), and time that simulation was stopped,
+    if sent a keyboardinterrupt or timeout. Timesteps a trajectory did not reach are 0.
+    """
+    number_trajectories = int(header['number_trajectories'])
+    number_timesteps = int(header['number_timesteps'])
+    number_species = int(header['number_species'])
+    offset = int(header['header_size'])
+    expected = offset + 8 * number_timesteps + 12 * number_trajectories
+    if len(results_buffer) < expected:
+        raise ExecutionError('Simulation output was truncated, expected at least {} bytes but received {} bytes.'
+                             .format(expected, len(results_buffer)))
+
+    timeline = np.frombuffer(results_buffer, dtype=np.float64, count=number_timesteps, offset=offset)
+    offset += timeline.nbytes
+    reached = np.frombuffer(results_buffer, dtype=np.uint32, count=number_trajectories, offset=offset)
+    offset += reached.nbytes
+    counts = np.frombuffer(results_buffer, dtype=np.uint64, count=number_trajectories, offset=offset)
+    offset += counts.nbytes
+    number_changes = int(counts.sum())
+    if len(results_buffer) < offset + POPULATION_CHANGE.itemsize * number_changes:
+        raise ExecutionError('Simulation output was truncated, expected {} bytes but received {} bytes.'
+                             .format(offset + POPULATION_CHANGE.itemsize * number_changes, len(results_buffer)))
+    changes = np.frombuffer(results_buffer, dtype=POPULATION_CHANGE, count=number_changes, offset=offset)
+
+    # Each trajectory's changes are in timestep order, so a stable sort by species keeps them in order within a species
+    # and each change can be turned into the difference from the one before it
+    trajectory = np.repeat(np.arange(number_trajectories), counts.astype(np.int64))
+    species = changes['species'].astype(np.int64)
+    order = np.argsort(trajectory * number_species + species, kind='stable')
+    trajectory, species = trajectory[order], species[order]
+    timestep = changes['timestep'][order].astype(np.int64)
+    population = changes['population'][order].astype(np.int64)
+    delta = population.copy()
+    same_species = (trajectory[1:] == trajectory[:-1]) & (species[1:] == species[:-1])
+    delta[1:][same_species] -= population[:-1][same_species]
+
+    trajectories = np.zeros((number_trajectories, number_timesteps, number_species), dtype=np.int64)
+    trajectories[trajectory, timestep, species] = delta
+    np.cumsum(trajectories, axis=1, out=trajectories)
+    trajectories[np.arange(number_timesteps)[np.newaxis, :] >= reached[:, np.newaxis]] = 0
+
+    timeStopped = int(header['current_time']) if pause else 0
+    return timeline, trajectories, timeStopped
+
+
+def _parse_binary_events(results_buffer):
+    """
+    This function reads the binary output of a CPP simulation run with -record_every, which records each trajectory at
+    its start and after every record_every-th event
+    :param results_buffer: stdout of the CPP simulation ran
+    :return: List holding the times and float populations, indexed by (record, species), of each trajectory
+    """
+    if len(results_buffer) < BINARY_HEADER.itemsize:
+        raise ExecutionError('Simulation output was truncated, expected a {} byte header but received {} bytes.'
+                             .format(BINARY_HEADER.itemsize, len(results_buffer)))
+    header = np.frombuffer(results_buffer, dtype=BINARY_HEADER, count=1)[0]
+    if header['magic'] != b'GPYE':
+        raise ExecutionError('Simulation output is not in the GillesPy2 binary event format.')
+    number_trajectories = int(header['number_trajectories'])
+    number_species = int(header['number_species'])
+    offset = int(header['header_size']) + 8 * int(header['number_timesteps'])
+    counts = np.frombuffer(results_buffer, dtype=np.uint64, count=number_trajectories, offset=offset)
+    offset += counts.nbytes
+    expected = offset + int(counts.sum()) * (8 + 4 * number_species)
+    if len(results_buffer) < expected:
+        raise ExecutionError('Simulation output was truncated, expected {} bytes but received {} bytes.'
+                             .format(expected, len(results_buffer)))
+
+    trajectories = []
+    for count in counts.astype(np.int64):
+        times = np.frombuffer(results_buffer, dtype=np.float64, count=count, offset=offset)
+        offset += times.nbytes
+        populations = np.frombuffer(results_buffer, dtype=np.uint32, count=count * number_species, offset=offset)
+        offset += populations.nbytes
+        trajectories.append((times.copy(), populations.reshape((count, number_species)).astype(np.float64)))
+    return trajectories
+
+
+# Layout of Gillespy::ProfileHeader, which follows the binary header of simulations run with -profile
+PROFILE_HEADER = np.dtype([('magic', 'S4'), ('number_reactions', np.uint32), ('profiled', np.uint32),
+                           ('reserved', np.uint32), ('events', np.uint64), ('propensity_evaluations', np.uint64),
+                           ('fan_out', np.uint64), ('selection_seconds', np.float64), ('update_seconds', np.float64),
+                           ('output_seconds', np.float64)])
+
+
+def _parse_binary_profile(results_buffer, reactions):
+    """
+    This function reads the engine profile written into the binary header of a CPP simulation run with -profile
+    :param results_buffer: stdout of the CPP simulation ran
+    :param reactions: Names of the model's reactions, in the order they were written to the simulation
+    :return: Dictionary of the profile, or None if the output holds none. 'events', reactions fired or leaps taken for
+    tau-leaping, 'events_per_trajectory' and 'propensity_evaluations' are always counted. Simulations built with
+    profiling, for which 'profiled' is True, also count 'firings' of each reaction, the 'fan_out' of propensities
+    re-evaluated through the dependency graph after firings, and the seconds spent in 'selection' of the next event,
+    its 'update' of the state and propensities, and 'output' of the state into trajectories, summed over threads.
+    """
+    header = np.frombuffer(results_buffer, dtype=BINARY_HEADER, count=1)[0]
+    offset = BINARY_HEADER.itemsize
+    if int(header['header_size']) < offset + PROFILE_HEADER.itemsize:
+        return None
+    profile = np.frombuffer(results_buffer, dtype=PROFILE_HEADER, count=1, offset=offset)[0]
+    if profile['magic'] != b'GPYP':
+        return None
+    offset += PROFILE_HEADER.itemsize
+    number_reactions = int(profile['number_reactions'])
+    firings = np.frombuffer(results_buffer, dtype=np.uint64, count=number_reactions, offset=offset)
+    offset += firings.nbytes
+    events = np.frombuffer(results_buffer, dtype=np.uint64, count=int(header['number_trajectories']), offset=offset)
+    return {
+        'profiled': bool(profile['profiled']),
+        'events': int(profile['events']),
+        'events_per_trajectory': events.astype(np.int64),
+        'propensity_evaluations': int(profile['propensity_evaluations']),
+        'fan_out': int(profile['fan_out']),
+        'firings': {reaction: int(count) for reaction, count in zip(reactions, firings)},
+        'selection_seconds': float(profile['selection_seconds']),
+        'update_seconds': float(profile['update_seconds']),
+        'output_seconds': float(profile['output_seconds'])
+    }
+
+
+CHECKPOINT_HEADER = np.dtype([('magic', 'S4'), ('number_trajectories', np.uint32), ('number_species', np.uint32),
+                              ('number_reactions', np.uint32), ('rng_size', np.uint32),
+                              ('number_timesteps', np.uint32), ('end_time', np.float64)])
+CHECKPOINT_ENTRY = np.dtype([('time', np.float64), ('entry_count', np.uint32), ('flags', np.uint32)])
+
+
+def _checkpoint_resumable(checkpoint, t, increment):
+    """
+    This function checks whether a simulation from 0 to t, output every increment, can resume a checkpoint. Its
+    timesteps must be spaced as those of the simulation which saved the checkpoint, and end no earlier. Results whose
+    checkpoint cannot be resumed are resumed by c_solver_resume instead.
+    :param checkpoint: Contents of the checkpoint file, saved by a CPP simulation run with -checkpoint
+    :param t: End time of the resuming simulation
+    :param increment: Time between the resuming simulation's timesteps
+    :return: Whether the checkpoint can be resumed
+    """
+    if len(checkpoint) < CHECKPOINT_HEADER.itemsize:
+        return False
+    header = np.frombuffer(checkpoint, dtype=CHECKPOINT_HEADER, count=1)[0]
+    if header['magic'] != b'GPYK' or header['number_timesteps'] < 2 or header['end_time'] > t:
+        return False
+    return bool(np.isclose(header['end_time'] / (int(header['number_timesteps']) - 1), increment, rtol=1e-9, atol=0))
+
+
+def _checkpoint_entry_counts(checkpoint):
+    """
+    This function reads how many timesteps each trajectory had recorded when its checkpoint was saved, by a CPP
+    simulation run with -checkpoint
+    :param checkpoint: Contents of the checkpoint file
+    :return: Array of each trajectory's entry count, 0 for trajectories which had not started
+    """
+    if len(checkpoint) < CHECKPOINT_HEADER.itemsize:
+        raise ExecutionError('Simulation checkpoint was truncated.')
+    header = np.frombuffer(checkpoint, dtype=CHECKPOINT_HEADER, count=1)[0]
+    if header['magic'] != b'GPYK':
+        raise ExecutionError('Simulation checkpoint is not in the GillesPy2 checkpoint format.')
+    # Entries are followed by the trajectory's state, generator and, if flagged, its reactions' firing times
+    state_size = 4 * int(header['number_species']) + int(header['rng_size'])
+    firing_times_size = 8 * int(header['number_reactions'])
+    entry_counts = np.zeros(int(header['number_trajectories']), dtype=np.int64)
+    offset = CHECKPOINT_HEADER.itemsize
+    for trajectory in range(len(entry_counts)):
+        if len(checkpoint) < offset + CHECKPOINT_ENTRY.itemsize:
+            raise ExecutionError('Simulation checkpoint was truncated.')
+        entry = np.frombuffer(checkpoint, dtype=CHECKPOINT_ENTRY, count=1, offset=offset)[0]
+        if entry['flags'] & 1:
+            entry_counts[trajectory] = entry['entry_count']
+        offset += CHECKPOINT_ENTRY.itemsize + state_size + (firing_times_size if entry['flags'] & 2 else 0)
+    return entry_counts
+
+
+def _results_file_args(output_directory, number_of_trajectories, number_timesteps, number_species):
+    """
+    This function chooses where a CPP simulation writes its memory mapped binary results. A POSIX shared memory segment
+    is used when /dev/shm has room for the results, otherwise a file in the solvers output directory.
+    :param output_directory: Directory of the compiled simulation
+    :param number_of_trajectories: Total number of trajectories for a simulation
+    :param number_timesteps: How many steps for a given simulation
+    :param number_species: Total number of species in a model
+    :return: Command line arguments for the simulation, and the path its results can be mapped from. When memory
+    mapped results are not supported the arguments are empty and the path is None, results are then read from stdout.
+    """
+    if os.name == 'nt':
+        return [], None
+    size = BINARY_HEADER.itemsize + 8 * number_timesteps + 4 * number_of_trajectories * number_timesteps * number_species
+    name = 'gillespy2_{}'.format(uuid.uuid4().hex)
+    shm_directory = '/dev/shm'
+    if os.path.isdir(shm_directory):
+        # Leave headroom, tmpfs mounts are often small and a full one faults on write rather than on creation
+        shm_stat = os.statvfs(shm_directory)
+        if shm_stat.f_bavail * shm_stat.f_frsize > 2 * size:
+            return ['-shm', '/' + name], os.path.join(shm_directory, name)
+    path = os.path.join(output_directory, name + '.bin')
+    return ['-output_file', path], path
+
+
+def _read_binary_results(results_buffer, results_path=None, pause=False):
+    """
+    This function reads the binary results of a CPP simulation, from its memory mapped results file if it was given
+    one, or else from its stdout. The results file is unlinked once mapped, it is freed with the last returned view.
+    :param results_buffer: stdout of the CPP simulation ran
+    :param results_path: Path of the results file, as returned by _results_file_args
+    :param pause: Whether or not a model was paused, set to true when simulation was sent a KeyBoardInterrupt or
+    timeout.
+    :return: Timeline, trajectories indexed by (trajectory, timestep, species), and time that simulation was stopped.
+    """
+    if results_path is None:
+        return _parse_binary_results(results_buffer, pause=pause)
+    try:
+        results_buffer = np.memmap(results_path, dtype=np.uint8, mode='r')
+    except (OSError, ValueError) as e:
+        raise ExecutionError('Could not map simulation results file {}: {}'.format(results_path, e))
+    _remove_results_file(results_path)
+    return _parse_binary_results(results_buffer, pause=pause)
+
+
+def _run_simulation(args, timeout=0):
+    """
+    This function runs a compiled CPP simulation in its own process group. On timeout or KeyboardInterrupt the
+    simulation is sent SIGINT, it then stops and outputs the results simulated so far.
+    :param args: Command line of the simulation
+    :param timeout: Seconds to run before interrupting the simulation, 0 for no limit
+    :return: stdout of the simulation, its return code, 33 if it was interrupted, and whether it was interrupted
+    """
+    with subprocess.Popen(args, stdout=subprocess.PIPE, start_new_session=True) as simulation:
+        try:
+            if timeout > 0:
+                stdout, stderr = simulation.communicate(timeout=timeout)
+            else:
+                stdout, stderr = simulation.communicate()
+            return stdout, simulation.wait(), False
+        except (KeyboardInterrupt, subprocess.TimeoutExpired):
+            os.killpg(simulation.pid, signal.SIGINT)  # send signal to the process group
+            stdout, stderr = simulation.communicate()
+            return stdout, 33, True
+
+
+# Trajectory number ending the output of simulations run with -stream, see Gillespy::TrajectoryStream
+END_OF_STREAM = 0xFFFFFFFF
+
+
+def _stream_simulation(args, timeout=0, progress=None):
+    """
+    This function runs a compiled CPP simulation with -stream in its own process group, and yields each trajectory as
+    soon as the simulation outputs it. On timeout or KeyboardInterrupt while waiting for a trajectory the simulation is
+    sent SIGINT, the trajectories it finished are still yielded. Closing the generator early stops the simulation.
+    :param args: Command line of the simulation, with -stream
+    :param timeout: Seconds to run before interrupting the simulation, 0 for no limit
+    :param progress: Function called with the number of trajectories finished and the number simulated, as the
+    simulation reports them on stderr when run with -progress. Optional, stderr is otherwise left to the simulation
+    :return: Generator of the timeline, each trajectory's number and its populations indexed by (timestep, species),
+    in the order the trajectories finish
+    """
+    simulation = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.PIPE if progress else None,
+                                  start_new_session=True)
+    output = simulation.stdout.fileno()
+    reports = simulation.stderr.fileno() if progress else None
+    buffer = bytearray()
+    report_buffer = bytearray()
+    deadline = time.monotonic() + timeout if timeout > 0 else None
+
+    def read(size):
+        # Reads until the buffer holds size bytes, reporting progress meanwhile, False if the simulation exited first
+        nonlocal deadline, reports, report_buffer
+        while len(buffer) < size:
+            try:
+                remaining = None if deadline is None else deadline - time.monotonic()
+                ready = [] if remaining is not None and remaining <= 0 else \
+                    select.select([output] + ([reports] if reports is not None else []), [], [], remaining)[0]
+                if not ready:
+                    raise subprocess.TimeoutExpired(args, timeout)
+            except (KeyboardInterrupt, subprocess.TimeoutExpired):
+                log.warning('GillesPy2 simulation exceeded timeout.')
+                os.killpg(simulation.pid, signal.SIGINT)
+                deadline = None
+                continue
+            if reports in ready:
+                data = os.read(reports, 1 << 16)
+                if not data:
+                    reports = None
+                report_buffer += data
+                *lines, report_buffer = report_buffer.split(b'\n')
+                for line in lines:
+                    words = line.split()
+                    if len(words) == 3 and words[0] == b'progress':
+                        progress(int(words[1]), int(words[2]))
+                    else:
+                        log.warning(line.decode('utf-8', 'replace'))
+            if output in ready:
+                data = os.read(output, 1 << 16)
+                if not data:
+                    return False
+                buffer.extend(data)
+        return True
+
+    def take(size):
+        data = bytes(buffer[:size])
+        del buffer[:size]
+        return data
+
+    try:
+        if not read(BINARY_HEADER.itemsize):
+            raise ExecutionError('Error encountered while running simulation C++ file:\nReturn code: {0}.\n'
+                                 .format(simulation.wait()))
+        header = np.frombuffer(bytes(buffer[:BINARY_HEADER.itemsize]), dtype=BINARY_HEADER)[0]
+        if header['magic'] != b'GPYT':
+            raise ExecutionError('Simulation output is not in the GillesPy2 binary stream format.')
+        number_timesteps = int(header['number_timesteps'])
+        number_species = int(header['number_species'])
+        read(int(header['header_size']) + 8 * number_timesteps)
+        take(int(header['header_size']))
+        timeline = np.frombuffer(take(8 * number_timesteps), dtype=np.float64)
+        size = 4 * number_timesteps * number_species
+        while True:
+            if not read(4):
+                raise ExecutionError('Simulation output was truncated, return code {}.'.format(simulation.wait()))
+            trajectory_number = int(np.frombuffer(take(4), dtype=np.uint32)[0])
+            if trajectory_number == END_OF_STREAM:
+                break
+            if not read(size):
+                raise ExecutionError('Simulation output was truncated, return code {}.'.format(simulation.wait()))
+            populations = np.frombuffer(take(size), dtype=np.uint32).reshape((number_timesteps, number_species))
+            yield timeline, trajectory_number, populations
+    finally:
+        if simulation.poll() is None:
+            os.killpg(simulation.pid, signal.SIGKILL)
+        simulation.wait()
+        simulation.stdout.close()
+        if simulation.stderr is not None:
+            simulation.stderr.close()
+
+
+def _run_shards(commands, gather, timeout=0):
+    """
+    This function runs the simulations of the shards of an ensemble at once, each in its own process group as
+    _run_simulation runs one, and gathers their binary output into that of the whole ensemble. On timeout or
+    KeyboardInterrupt every shard still running is sent SIGINT, and outputs the results simulated so far.
+    :param commands: Command line of each shard's simulation, in order of their trajectories
+    :param gather: Function gathering the stdout of every shard, _gather_binary_results or _gather_binary_statistics
+    :param timeout: Seconds to run before interrupting the simulations, 0 for no limit
+    :return: Gathered stdout of the simulations, the first failing return code, else 33 if any was interrupted,
+    and whether any was interrupted
+    """
+    simulations = [subprocess.Popen(command, stdout=subprocess.PIPE, start_new_session=True) for command in commands]
+    outputs = [b''] * len(simulations)
+
+    def read(shard):
+        outputs[shard] = simulations[shard].stdout.read()
+
+    readers = [threading.Thread(target=read, args=(shard,)) for shard in range(len(simulations))]
+    for reader in readers:
+        reader.start()
+    deadline = time.time() + timeout if timeout > 0 else None
+    pause = False
+    try:
+        for reader in readers:
+            reader.join(None if deadline is None else max(0, deadline - time.time()))
+            if reader.is_alive():
+                raise subprocess.TimeoutExpired(commands, timeout)
+    except (KeyboardInterrupt, subprocess.TimeoutExpired):
+        pause = True
+        for simulation in simulations:
+            if simulation.poll() is None:
+                os.killpg(simulation.pid, signal.SIGINT)
+        for reader in readers:
+            reader.join()
+    return_codes = [simulation.wait() for simulation in simulations]
+    for simulation in simulations:
+        simulation.stdout.close()
+    failed = [return_code for return_code in return_codes if return_code not in [0, 33]]
+    if failed and not pause:
+        return b'', failed[0], False
+    return gather(outputs), 33 if pause or 33 in return_codes else 0, pause or 33 in return_codes
+
+
+def _gather_header(results_buffers, formats):
+    headers = []
+    for results_buffer in results_buffers:
+        if len(results_buffer) < BINARY_HEADER.itemsize:
+            raise ExecutionError('Simulation output was truncated, expected a {} byte header but received {} bytes.'
+                                 .format(BINARY_HEADER.itemsize, len(results_buffer)))
+        headers.append(np.frombuffer(results_buffer, dtype=BINARY_HEADER, count=1)[0])
+        if headers[-1]['magic'] not in formats or headers[-1]['magic'] != headers[0]['magic']:
+            raise ExecutionError('Shards of an ensemble must output the same GillesPy2 binary format, one of {}.'
+                                 .format(formats))
+    header = np.array(headers[0], dtype=BINARY_HEADER)
+    header['header_size'] = BINARY_HEADER.itemsize
+    header['number_trajectories'] = sum(int(shard['number_trajectories']) for shard in headers)
+    header['status'] = max(int(shard['status']) for shard in headers)
+    # Interrupted shards are resumed from the earliest time any of them stopped at
+    header['current_time'] = min(shard['current_time'] for shard in headers)
+    return header, headers
+
+
+def _gather_binary_results(results_buffers):
+    """
+    This function gathers the binary results of the shards of an ensemble, output to stdout, into the binary results
+    of one simulation of every trajectory, which _parse_binary_results reads.
+    :param results_buffers: stdout of each shard's simulation, in order of their trajectories
+    :return: Binary results of the ensemble
+    """
+    header, headers = _gather_header(results_buffers, (b'GPY2', b'GPYF'))
+    number_timesteps = int(header['number_timesteps'])
+    value_size = 8 if header['magic'] == b'GPYF' else 4
+    sizes = [int(shard['number_trajectories']) * number_timesteps * int(shard['number_species']) * value_size
+             for shard in headers]
+    gathered = bytearray(BINARY_HEADER.itemsize + 8 * number_timesteps + sum(sizes))
+    gathered[:BINARY_HEADER.itemsize] = header.tobytes()
+    offset = BINARY_HEADER.itemsize
+    for shard, (results_buffer, shard_header, size) in enumerate(zip(results_buffers, headers, sizes)):
+        start = int(shard_header['header_size'])
+        if shard == 0:
+            gathered[offset:offset + 8 * number_timesteps] = results_buffer[start:start + 8 * number_timesteps]
+            offset += 8 * number_timesteps
+        start += 8 * number_timesteps
+        if len(results_buffer) < start + size:
+            raise ExecutionError('Simulation output was truncated, expected {} bytes but received {} bytes.'
+                                 .format(start + size, len(results_buffer)))
+        gathered[offset:offset + size] = results_buffer[start:start + size]
+        offset += size
+    return bytes(gathered)
+
+
+def _gather_binary_statistics(results_buffers):
+    """
+    This function reduces the ensemble statistics of the shards of an ensemble, output without quantiles, into those
+    of the whole ensemble. The shards' exact sums of populations and of their squares are added, and the mean and
+    variance computed from them as the simulation computes them, so the statistics are those of one simulation of every
+    trajectory, to the bit.
+    :param results_buffers: stdout of each shard's simulation run with -statistics
+    :return: Binary statistics of the ensemble, which _parse_binary_statistics reads
+    """
+    header, headers = _gather_header(results_buffers, (b'GPYS',))
+    count = 0
+    timeline = sums = squared_sums = None
+    for results_buffer in results_buffers:
+        shard_timeline, shard_count, _, _, _ = _parse_binary_statistics(results_buffer, 0)
+        if shard_count == 0:
+            continue
+        shard_sums, shard_squared_sums = _parse_binary_sums(results_buffer, 0)
+        if count == 0:
+            timeline, sums, squared_sums = shard_timeline, shard_sums.copy(), shard_squared_sums
+        else:
+            sums += shard_sums
+            squared_sums = squared_sums + shard_squared_sums
+        count += shard_count
+    if count == 0:
+        return results_buffers[0]
+    mean = sums / float(count)
+    if count > 1:
+        deviations = count * squared_sums - sums.astype(object) ** 2
+        variance = np.array([float(value) for value in deviations.flat]).reshape(mean.shape) / \
+            (float(count) * (count - 1))
+    else:
+        variance = np.zeros_like(mean)
+    squared_words = np.array([[value & 0xFFFFFFFFFFFFFFFF, value >> 64] for value in squared_sums.flat],
+                             dtype=np.uint64)
+    header['number_trajectories'] = count
+    return header.tobytes() + timeline.tobytes() + mean.tobytes() + variance.tobytes() + sums.tobytes() + \
+        squared_words.tobytes()
+
+
+def _parse_binary_sums(results_buffer, number_quantiles):
+    """
+    This function reads the exact sums of populations and of their squares that follow the ensemble statistics output
+    by a CPP simulation run with -statistics
+    :param results_buffer: stdout of the CPP simulation ran
+    :param number_quantiles: Number of quantiles the simulation was given with -quantiles
+    :return: uint64 array of sums and object array of the squared sums as Python ints, indexed by (timestep, species)
+    """
+    header = np.frombuffer(results_buffer, dtype=BINARY_HEADER, count=1)[0]
+    number_timesteps = int(header['number_timesteps'])
+    number_species = int(header['number_species'])
+    number_entries = number_timesteps * number_species
+    offset = int(header['header_size']) + 8 * number_timesteps * (1 + (2 + number_quantiles) * number_species)
+    expected = offset + 24 * number_entries
+    if len(results_buffer) < expected:
+        raise ExecutionError('Simulation output was truncated, expected {} bytes but received {} bytes.'
+                             .format(expected, len(results_buffer)))
+    sums = np.frombuffer(results_buffer, dtype=np.uint64, count=number_entries, offset=offset)
+    words = np.frombuffer(results_buffer, dtype=np.uint64, count=2 * number_entries, offset=offset + 8 * number_entries)
+    squared_sums = words[0::2].astype(object) + (words[1::2].astype(object) << 64)
+    return sums.reshape((number_timesteps, number_species)), squared_sums.reshape((number_timesteps, number_species))
+
+
+def _parse_binary_statistics(results_buffer, number_quantiles):
+    """
+    This function reads the ensemble statistics output by a CPP simulation run with -statistics
+    :param results_buffer: stdout of the CPP simulation ran
+    :param number_quantiles: Number of quantiles the simulation was given with -quantiles
+    :return: Timeline, number of trajectories summarized, and mean, variance and quantiles arrays indexed by
+    (timestep, species), quantiles has one more leading axis for each requested probability
+    """
+    if len(results_buffer) < BINARY_HEADER.itemsize:
+        raise ExecutionError('Simulation output was truncated, expected a {} byte header but received {} bytes.'
+                             .format(BINARY_HEADER.itemsize, len(results_buffer)))
+    header = np.frombuffer(results_buffer, dtype=BINARY_HEADER, count=1)[0]
+    if header['magic'] != b'GPYS':
+        raise ExecutionError('Simulation output is not in the GillesPy2 binary statistics format.')
+    number_timesteps = int(header['number_timesteps'])
+    number_species = int(header['number_species'])
+    offset = int(header['header_size'])
+    expected = offset + 8 * number_timesteps * (1 + (2 + number_quantiles) * number_species)
+    if len(results_buffer) < expected:
+        raise ExecutionError('Simulation output was truncated, expected {} bytes but received {} bytes.'
+                             .format(expected, len(results_buffer)))
+
+    timeline = np.frombuffer(results_buffer, dtype=np.float64, count=number_timesteps, offset=offset)
+    offset += timeline.nbytes
+    blocks = np.frombuffer(results_buffer, dtype=np.float64, count=(2 + number_quantiles) * number_timesteps *
+                           number_species, offset=offset).reshape((2 + number_quantiles, number_timesteps,
+                                                                   number_species))
+    return timeline, int(header['number_trajectories']), blocks[0], blocks[1], blocks[2:]
+
+
+def _remove_results_file(results_path):
+    if results_path is None:
+        return
+    try:
+        os.remove(results_path)
+    except OSError:
+        pass
+
+
+class _SimulationServer:
+    """
+    A compiled simulation started with -serve, which keeps its model resident and simulates it once per request, so
+    repeated runs of a model do not each pay for starting a process and building the model.  Requests are the
+    simulation's command line options, written one "-option value" per line and ended by a "run" line.  Servers
+    are not used on Windows, where pipes can not be waited on with a timeout.
+    """
+    supported = os.name != 'nt'
+
+    def __init__(self, executable):
+        """
+        :param executable: Path of the compiled simulation
+        """
+        self.executable = executable
+        self.process = None
+        self.lock = threading.Lock()
+
+    def _start(self):
+        if self.process is None or self.process.poll() is not None:
+            self.process = subprocess.Popen([self.executable, '-serve'], stdin=subprocess.PIPE,
+                                            stdout=subprocess.PIPE, start_new_session=True)
+
+    def _read(self, response, size, deadline):
+        # Reads from the server's stdout until the response holds size bytes, raising TimeoutExpired at the deadline
+        fd = self.process.stdout.fileno()
+        while len(response) < size:
+            if deadline is not None:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0 or not select.select([fd], [], [], remaining)[0]:
+                    raise subprocess.TimeoutExpired(self.executable, 0)
+            data = os.read(fd, size - len(response))
+            if not data:
+                raise ExecutionError('Simulation server exited with return code {}.'.format(self.process.wait()))
+            response += data
+
+    def run(self, options, mapped=False, timeout=0):
+        """
+        Simulates one request, interrupting it with SIGINT on timeout or KeyboardInterrupt as a simulation run in
+        its own process would be, the results simulated so far are then returned.
+        :param options: (option, value) pairs of the request, value is '' for flags
+        :param mapped: Whether the options write the results to a results file, only their header is then returned
+        :param timeout: Seconds to run before interrupting the simulation, 0 for no limit
+        :return: Binary output of the simulation and whether it was interrupted
+        """
+        with self.lock:
+            self._start()
+            request = ''.join('{} {}\n'.format(option, value) for option, value in options) + 'run\n'
+            try:
+                self.process.stdin.write(request.encode('utf-8'))
+                self.process.stdin.flush()
+            except BrokenPipeError:
+                raise ExecutionError('Simulation server exited with return code {}.'.format(self.process.wait()))
+
+            response = bytearray()
+            deadline = time.monotonic() + timeout if timeout > 0 else None
+            pause = False
+            while True:
+                try:
+                    self._read(response, BINARY_HEADER.itemsize, deadline)
+                    header = np.frombuffer(bytes(response[:BINARY_HEADER.itemsize]), dtype=BINARY_HEADER)[0]
+                    size = BINARY_HEADER.itemsize
+                    if not mapped and header['status'] == 0:
+                        size = int(header['header_size']) + 8 * int(header['number_timesteps']) + \
+                               4 * int(header['number_trajectories']) * int(header['number_timesteps']) * \
+                               int(header['number_species'])
+                    self._read(response, size, deadline)
+                    return bytes(response), pause
+                except (KeyboardInterrupt, subprocess.TimeoutExpired):
+                    if pause:
+                        # The response was abandoned partway, the server can not be read from again
+                        self.process.kill()
+                        self.process.wait()
+                        self.process = None
+                        raise
+                    # The server answers an interrupted request with the results simulated so far
+                    os.killpg(self.process.pid, signal.SIGINT)
+                    pause = True
+                    deadline = None
+                except ExecutionError:
+                    self.process = None
+                    raise
+
+    def close(self):
+        """
+        Stops the server, it is started again by the next request.
+        """
+        if self.process is None:
+            return
+        try:
+            self.process.stdin.write(b'quit\n')
+            self.process.stdin.close()
+            self.process.wait(timeout=5)
+        except (OSError, ValueError, subprocess.TimeoutExpired):
+            self.process.kill()
+            self.process.wait()
+        self.process.stdout.close()
+        self.process = None
+
 
 def c_solver_resume(timeStopped, simulation_data, t, resume=None):
     """
@@ -134,6 +1521,10 @@ def c_solver_resume(timeStopped, simulation_data, t, resume=None):
     if resume is not None:
         resumeTime = float(resume['time'][-1])
         step = resumeTime - resume['time'][-2]
+        # The resuming simulation's timesteps may be spaced differently than those of the results it resumes
+        times = simulation_data[0]['time']
+        if len(times) > 1 and not np.isclose(times[1] - times[0], step):
+            step = times[1] - times[0]
         if timeStopped == 0:
             timeSpan = np.arange(resumeTime, t + resumeTime + step, step)
         else:
@@ -151,6 +1542,35 @@ def c_solver_resume(timeStopped, simulation_data, t, resume=None):
     return simulation_data
 
 
+def c_solver_checkpoint_resume(simulation_data, checkpoint, pause, resume=None):
+    """
+    Completes the results of a CPP simulation which saved a checkpoint, in place of c_solver_resume. Each trajectory
+    resumed from resume.checkpoint only simulated the timesteps after it, those before come from resume. A paused
+    simulation's first trajectory ends at the timesteps it reached.
+    :param simulation_data: The current simulation data, attained after parsing the results in the SSACSolver
+    :param checkpoint: Checkpoint the simulation saved
+    :param pause: Whether or not the simulation was paused by a KeyboardInterrupt or timeout
+    :param resume: The previous simulations data, with the checkpoint it saved
+    :type resume: gillespy2.core.result object
+    :return: Combined data of the previous simulation, and the current simulation
+    """
+    if resume is not None:
+        resumed_counts = _checkpoint_entry_counts(resume.checkpoint)
+        for trajectory, data in enumerate(simulation_data):
+            count = resumed_counts[trajectory]
+            for species in data:
+                if species != 'time':
+                    data[species][:count] = resume[trajectory][species][:count]
+    if pause:
+        reached = int(_checkpoint_entry_counts(checkpoint)[0])
+        if reached <= 1:
+            log.warning('You have paused the simulation too early, and no points have been calculated past'
+                        ' initial values. A graphic display will not produce expected results.')
+        for i in simulation_data[0]:
+            simulation_data[0][i] = simulation_data[0][i][:max(reached, 1)]
+    return simulation_data
+
+
 """
 NUMPY SOLVER UTILITIES BELOW
 """
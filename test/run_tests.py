@@ -24,6 +24,10 @@ if __name__ == '__main__':
     import test_simple_model
     import test_ssa_c_solver
     import test_variable_ssa_c_solver
+    import test_tau_leaping_c_solver
+    import test_ode_c_solver
+    import test_tau_hybrid_c_solver
+    import test_gpu_ssa_solver
     import test_SBML
     import test_example_models
     import test_all_solvers
@@ -41,6 +45,10 @@ if __name__ == '__main__':
         test_simple_model,
         test_ssa_c_solver,
         test_variable_ssa_c_solver,
+        test_tau_leaping_c_solver,
+        test_ode_c_solver,
+        test_tau_hybrid_c_solver,
+        test_gpu_ssa_solver,
         test_pause_resume,
         test_SBML,
         test_example_models,
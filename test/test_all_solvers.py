@@ -6,6 +6,7 @@ from example_models import Example, Oregonator, MichaelisMenten
 from gillespy2.core.results import Results, Trajectory
 from gillespy2 import SSACSolver
 from gillespy2 import VariableSSACSolver
+from gillespy2 import TauLeapingCSolver
 from gillespy2 import ODESolver
 from gillespy2 import NumPySSASolver
 from gillespy2 import TauLeapingSolver
@@ -14,7 +15,7 @@ from gillespy2 import TauHybridSolver
 
 class TestAllSolvers(unittest.TestCase):
 
-    solvers = [SSACSolver, VariableSSACSolver, ODESolver, NumPySSASolver, TauLeapingSolver, TauHybridSolver]
+    solvers = [SSACSolver, VariableSSACSolver, TauLeapingCSolver, ODESolver, NumPySSASolver, TauLeapingSolver, TauHybridSolver]
 
     model = Example()
     for sp in model.listOfSpecies.values():
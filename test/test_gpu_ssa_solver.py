@@ -0,0 +1,82 @@
+import os
+import shutil
+import subprocess
+import tempfile
+import unittest
+from unittest import mock
+import numpy as np
+import gillespy2
+from gillespy2.core.gillespyError import ModelError, SimulationError
+from example_models import Example
+from gillespy2 import GPUSSASolver, SSACSolver
+from gillespy2.solvers.cpp.ssa_c_solver import GILLESPY_C_DIRECTORY, MAKE_FILE
+from gillespy2.solvers.utilities import solverutils as cutils
+
+has_nvcc = shutil.which(os.environ.get('NVCC', 'nvcc')) is not None
+
+
+class TestGPUSSASolver(unittest.TestCase):
+    def test_unsupported_arguments(self):
+        model = Example()
+        # Rejected before the model is compiled, so no GPU is needed
+        for arguments in ({'profile': True}, {'sparse_output': True}, {'record_every': 1}):
+            with self.assertRaises(SimulationError):
+                GPUSSASolver.run(model=model, **arguments)
+
+    def test_cache_keyed_by_nvcc(self):
+        # The build is faked, so no CUDA toolkit is needed
+        def make_simulation(output_directory, make_file, target, make_args, build, training_args):
+            with open(os.path.join(output_directory, target), 'w') as simulation:
+                simulation.write('built')
+            return subprocess.CompletedProcess(args=[], returncode=0, stdout=b'', stderr=b'')
+
+        with tempfile.TemporaryDirectory() as cache_directory, tempfile.TemporaryDirectory() as output_directory, \
+                mock.patch.dict(os.environ, {'GILLESPY2_CACHE_DIR': cache_directory}), \
+                mock.patch.object(cutils, '_make_simulation', side_effect=make_simulation) as make:
+            with open(os.path.join(output_directory, 'UserSimulation.cpp'), 'w') as source:
+                source.write('int main(){ return 0; }')
+            for version in (b'release 11.8', b'release 11.8', b'release 12.2'):
+                with mock.patch.object(cutils, '_nvcc_hash', return_value=version):
+                    cutils._build_simulation(output_directory, GILLESPY_C_DIRECTORY, MAKE_FILE, 'UserSimulationGPU')
+            self.assertEqual(make.call_count, 2)
+
+    @unittest.skipIf(not has_nvcc, 'requires the CUDA toolkit')
+    def test_matches_ssa(self):
+        model = Example()
+        solver = GPUSSASolver(model)
+        results = model.run(solver=solver, number_of_trajectories=200, seed=1024)
+        expected = model.run(solver=SSACSolver(model), number_of_trajectories=200, seed=1024)
+        self.assertEqual(results[0].solver_name, 'GPUSSASolver')
+        mean = np.mean([trajectory['Sp'] for trajectory in results], axis=0)
+        expected_mean = np.mean([trajectory['Sp'] for trajectory in expected], axis=0)
+        self.assertTrue(np.allclose(mean, expected_mean, atol=5))
+
+    @unittest.skipIf(not has_nvcc, 'requires the CUDA toolkit')
+    def test_seed_reproducible(self):
+        model = Example()
+        solver = GPUSSASolver(model)
+        first = model.run(solver=solver, number_of_trajectories=4, seed=1024)
+        second = model.run(solver=solver, number_of_trajectories=4, seed=1024)
+        for first_trajectory, second_trajectory in zip(first, second):
+            self.assertTrue(np.array_equal(first_trajectory['Sp'], second_trajectory['Sp']))
+
+    @unittest.skipIf(not has_nvcc, 'requires the CUDA toolkit')
+    def test_statistics(self):
+        model = Example()
+        statistics = GPUSSASolver(model).run_statistics(t=20, number_of_trajectories=50, seed=1024)
+        self.assertEqual(statistics['trajectories'], 50)
+        self.assertEqual(statistics['mean']['Sp'][0], model.listOfSpecies['Sp'].initial_value)
+
+    @unittest.skipIf(not has_nvcc, 'requires the CUDA toolkit')
+    def test_events_unsupported(self):
+        model = Example()
+        trigger = gillespy2.EventTrigger(expression='Sp <= 90')
+        event = gillespy2.Event(name='event1', trigger=trigger)
+        event.add_assignment(gillespy2.EventAssignment(variable='Sp', expression='1000'))
+        model.add_event(event)
+        with self.assertRaises(ModelError):
+            model.run(solver=GPUSSASolver(model))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,55 @@
+import unittest
+import numpy as np
+import gillespy2
+from gillespy2.core.gillespyError import ModelError, SimulationError
+from example_models import Example, MichaelisMenten
+from gillespy2 import ODECSolver, ODESolver
+
+
+class TestODECSolver(unittest.TestCase):
+    def test_create(self):
+        model = Example()
+        solver = ODECSolver(model)
+
+    def test_exponential_decay(self):
+        model = Example()
+        results = model.run(solver=ODECSolver, rtol=1e-8, atol=1e-10)
+        self.assertEqual(results[0].solver_name, 'ODECSolver')
+        self.assertTrue(np.allclose(results[0]['time'], model.tspan))
+        self.assertTrue(np.allclose(results[0]['Sp'], 100 * np.exp(-3 * model.tspan), rtol=1e-5, atol=1e-6))
+
+    def test_matches_ode_solver(self):
+        model = MichaelisMenten()
+        results = model.run(solver=ODECSolver(model))
+        expected = model.run(solver=ODESolver)
+        for species in model.listOfSpecies:
+            self.assertTrue(np.allclose(results[0][species], expected[0][species], rtol=1e-3, atol=1e-3))
+
+    def test_unsupported_arguments(self):
+        model = Example()
+        solver = ODECSolver(model)
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, rtol=0)
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, sparse_output=True)
+
+    def test_rate_rule(self):
+        model = Example()
+        model.add_species([gillespy2.Species(name='R', initial_value=0, mode='continuous')])
+        model.add_rate_rule(gillespy2.RateRule(name='rule1', variable='R', formula='1 + 0 * Sp'))
+        results = model.run(solver=ODECSolver(model))
+        self.assertTrue(np.allclose(results[0]['R'], model.tspan, rtol=1e-5, atol=1e-6))
+        self.assertTrue(np.allclose(results[0]['Sp'], 100 * np.exp(-3 * model.tspan), rtol=1e-3, atol=1e-3))
+
+    def test_events_unsupported(self):
+        model = Example()
+        trigger = gillespy2.EventTrigger(expression='t >= 10')
+        event = gillespy2.Event(name='event1', trigger=trigger)
+        event.add_assignment(gillespy2.EventAssignment(variable='Sp', expression='1000'))
+        model.add_event(event)
+        with self.assertRaises(ModelError):
+            model.run(solver=ODECSolver(model))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,5 +1,6 @@
 import unittest
-from gillespy2.solvers.utilities.solverutils import dependency_grapher
+import io
+from gillespy2.solvers.utilities.solverutils import dependency_grapher, _propensity_species, _write_reactions
 from gillespy2.core import Reaction, Species
 
 s = Species(name='s', initial_value=0)
@@ -55,3 +56,58 @@ class TestPropensityFunctions(unittest.TestCase):
         correct_graph = {'r1': {'dependencies': ['r2', 'r3']}, 'r2': {'dependencies': ['r1', 'r3']},
                          'r3': {'dependencies': ['r1', 'r2']}}
         self.assertEqual(correct_graph, dependencies)
+
+    def test_propensity_species(self):
+        from example_models import ToggleSwitch, MichaelisMenten
+        model = ToggleSwitch()
+        species = list(model.sanitized_species_names().keys())
+        propensity_species = {name: _propensity_species(reaction, species)
+                              for name, reaction in model.listOfReactions.items()}
+        self.assertEqual({'cu': [1], 'cv': [0], 'du': [0], 'dv': [1]}, propensity_species)
+
+        model = MichaelisMenten()
+        species = list(model.sanitized_species_names().keys())
+        propensity_species = {name: _propensity_species(reaction, species)
+                              for name, reaction in model.listOfReactions.items()}
+        self.assertEqual({'r1': [0, 1], 'r2': [2], 'r3': [2]}, propensity_species)
+
+    def test_propensity_species_expanded(self):
+        import gillespy2
+        model = gillespy2.Model(name='Expanded')
+        A = gillespy2.Species(name='A', initial_value=10)
+        B = gillespy2.Species(name='B', initial_value=5)
+        C = gillespy2.Species(name='C', initial_value=0)
+        model.add_species([A, B, C])
+        model.add_parameter([gillespy2.Parameter(name='k', expression=0.1),
+                             gillespy2.Parameter(name='total', expression=0)])
+        model.add_function_definition(gillespy2.FunctionDefinition(name='hill', function='k * B / (1 + B)'))
+        model.add_assignment_rule(gillespy2.AssignmentRule(name='rule1', variable='total', formula='A + C'))
+        function_reaction = gillespy2.Reaction(name='function_reaction', reactants={A: 1}, products={},
+                                               propensity_function='A * hill()')
+        rule_reaction = gillespy2.Reaction(name='rule_reaction', reactants={}, products={C: 1},
+                                           propensity_function='k * total')
+        model.add_reaction([function_reaction, rule_reaction])
+        species = list(model.sanitized_species_names().keys())
+        with self.subTest(msg='Test species read through a function definition'):
+            self.assertEqual([0, 1], _propensity_species(function_reaction, species, model))
+        with self.subTest(msg='Test species read through an assignment rule'):
+            self.assertEqual([0, 2], _propensity_species(rule_reaction, species, model))
+        with self.subTest(msg='Test the dependency graph uses expanded species'):
+            outfile = io.StringIO()
+            _write_reactions(outfile, model, ['function_reaction', 'rule_reaction'], species)
+            lines = outfile.getvalue().splitlines()
+            self.assertIn('model.propensity_species.add(0, 1);', lines)
+            self.assertIn('model.propensity_species.add(1, 0);', lines)
+
+    def test_write_reactions(self):
+        from example_models import MichaelisMenten
+        model = MichaelisMenten()
+        species = list(model.sanitized_species_names().keys())
+        outfile = io.StringIO()
+        _write_reactions(outfile, model, ['r1'], species)
+        lines = outfile.getvalue().splitlines()
+        self.assertEqual(['model.species_changes.add(0, {0, -1});', 'model.reactants.add(0, {0, 1});',
+                          'model.species_changes.add(0, {1, -1});', 'model.reactants.add(0, {1, 1});',
+                          'model.species_changes.add(0, {2, 1});',
+                          'model.propensity_species.add(0, 0);', 'model.propensity_species.add(0, 1);',
+                          'model.rate_species.add(0, 0);', 'model.rate_species.add(0, 1);'], lines)
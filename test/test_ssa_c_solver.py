@@ -1,8 +1,15 @@
 import unittest
+import os
+import shutil
+import subprocess
 import tempfile
-from gillespy2.core.gillespyError import DirectoryError
-from example_models import Example
-from gillespy2.solvers.cpp.ssa_c_solver import SSACSolver
+from unittest import mock
+import numpy as np
+import gillespy2
+from gillespy2.core.gillespyError import DirectoryError, ModelError, SimulationError
+from example_models import Example, MichaelisMenten
+from gillespy2.solvers.cpp.ssa_c_solver import SSACSolver, GILLESPY_C_DIRECTORY
+from gillespy2.solvers.cpp.benchmark import ALGORITHMS, run_benchmark
 
 
 class TestSSACSolver(unittest.TestCase):
@@ -25,6 +32,378 @@ class TestSSACSolver(unittest.TestCase):
         model = Example()
         results = model.run(solver=SSACSolver)
 
+    def test_threads_reproducible(self):
+        model = Example()
+        solver = SSACSolver(model)
+        serial = model.run(solver=solver, number_of_trajectories=6, seed=1024)
+        threaded = model.run(solver=solver, number_of_trajectories=6, seed=1024, number_of_threads=4)
+        for serial_trajectory, threaded_trajectory in zip(serial, threaded):
+            self.assertTrue(np.array_equal(serial_trajectory['Sp'], threaded_trajectory['Sp']))
+
+    def test_binary_results(self):
+        model = Example()
+        results = model.run(solver=SSACSolver, number_of_trajectories=2, seed=1024)
+        for trajectory in results:
+            self.assertTrue(np.allclose(trajectory['time'], model.tspan))
+            self.assertEqual(trajectory['Sp'][0], model.listOfSpecies['Sp'].initial_value)
+            self.assertEqual(trajectory['Sp'].dtype, np.float64)
+
+    def test_results_file_removed(self):
+        model = Example()
+        solver = SSACSolver(model)
+
+        def results_files(directory):
+            if not os.path.isdir(directory):
+                return set()
+            return {name for name in os.listdir(directory) if name.startswith('gillespy2_')}
+
+        shm_before = results_files('/dev/shm')
+        results = model.run(solver=solver, number_of_trajectories=2)
+        self.assertEqual(len(results), 2)
+        with self.subTest(msg='Test shared memory results are removed'):
+            self.assertEqual(results_files('/dev/shm') - shm_before, set())
+        # Without room in /dev/shm the results are written to a file in the output directory
+        full = mock.Mock(f_bavail=0, f_frsize=0)
+        with mock.patch('gillespy2.solvers.utilities.solverutils.os.statvfs', return_value=full):
+            results = model.run(solver=solver, number_of_trajectories=2)
+        self.assertEqual(len(results), 2)
+        with self.subTest(msg='Test results files are removed'):
+            self.assertEqual(results_files(solver.output_directory), set())
+
+    def test_algorithms(self):
+        model = Example()
+        solver = SSACSolver(model)
+        for algorithm in SSACSolver.algorithms:
+            results = model.run(solver=solver, number_of_trajectories=2, seed=1024, algorithm=algorithm)
+            for trajectory in results:
+                self.assertEqual(trajectory['Sp'][0], 100)
+                self.assertLessEqual(trajectory['Sp'][-1], 100)
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, algorithm='gillespie')
+
+    def test_batch_direct_matches_direct(self):
+        model = MichaelisMenten()
+        solver = SSACSolver(model)
+        # More trajectories than one batch, the last batch only partly filled
+        batched = model.run(solver=solver, number_of_trajectories=11, seed=1024, algorithm='batch_direct')
+        direct = model.run(solver=solver, number_of_trajectories=11, seed=1024, algorithm='direct')
+        for batched_trajectory, trajectory in zip(batched, direct):
+            for species in model.listOfSpecies:
+                self.assertTrue(np.array_equal(batched_trajectory[species], trajectory[species]))
+
+    def test_run_statistics(self):
+        model = Example()
+        solver = SSACSolver(model)
+        increment = model.tspan[1] - model.tspan[0]
+        results = model.run(solver=solver, number_of_trajectories=20, seed=1024)
+        summary = solver.run_statistics(t=model.tspan[-1], increment=increment, number_of_trajectories=20, seed=1024,
+                                        number_of_threads=3, quantiles=[0, 0.5, 1])
+        populations = np.array([trajectory['Sp'] for trajectory in results])
+        self.assertEqual(summary['trajectories'], 20)
+        self.assertTrue(np.allclose(summary['time'], model.tspan))
+        self.assertTrue(np.allclose(summary['mean']['Sp'], populations.mean(axis=0)))
+        self.assertTrue(np.allclose(summary['variance']['Sp'], populations.var(axis=0, ddof=1)))
+        self.assertTrue(np.array_equal(summary['quantiles'][0]['Sp'], populations.min(axis=0)))
+        self.assertTrue(np.array_equal(summary['quantiles'][1]['Sp'], populations.max(axis=0)))
+        with self.subTest(msg='Test statistics do not depend on the number of threads'):
+            serial = solver.run_statistics(t=model.tspan[-1], increment=increment, number_of_trajectories=20,
+                                           seed=1024, number_of_threads=1, quantiles=[0, 0.5, 1])
+            self.assertTrue(np.array_equal(summary['mean']['Sp'], serial['mean']['Sp']))
+            self.assertTrue(np.array_equal(summary['variance']['Sp'], serial['variance']['Sp']))
+            for probability in (0, 0.5, 1):
+                self.assertTrue(np.array_equal(summary['quantiles'][probability]['Sp'],
+                                               serial['quantiles'][probability]['Sp']))
+        with self.assertRaises(SimulationError):
+            solver.run_statistics(quantiles=[2])
+
+    @unittest.skipIf(shutil.which('g++') is None, 'requires g++')
+    def test_random_samplers(self):
+        # Samplers are checked on generators returning the extreme bits, and on a fixed seed's stream
+        program = """
+#include <cstdio>
+#include "rng.h"
+using namespace Gillespy;
+template<uint64_t bits> struct Constant : public RandomSampler<Constant<bits>>{
+  uint64_t operator()(){ return bits; }
+};
+int main(){
+  Constant<0> zeros;
+  Constant<~(uint64_t) 0> ones;
+  TrajectoryRng rng = trajectory_rng(1024, 0);
+  double smallest = 1;
+  const int n = 1000000;
+  double sum = 0, squared_sum = 0;
+  for(int i = 0; i < n; i++){
+    double u = rng.uniform();
+    smallest = u < smallest ? u : smallest;
+    double x = rng.exponential();
+    sum += x;
+    squared_sum += x * x;
+  }
+  double mean = sum / n;
+  std :: printf("%.17g %.17g %.17g %.17g %.17g\\n", zeros.uniform(), ones.uniform(), smallest, mean, squared_sum / n - mean * mean);
+}
+"""
+        with tempfile.TemporaryDirectory() as directory:
+            with open(os.path.join(directory, 'samplers.cpp'), 'w') as source:
+                source.write(program)
+            executable = os.path.join(directory, 'samplers')
+            subprocess.run(['g++', '-std=c++14', '-O2', '-I', GILLESPY_C_DIRECTORY, '-o', executable,
+                            os.path.join(directory, 'samplers.cpp'), os.path.join(GILLESPY_C_DIRECTORY, 'rng.cpp')],
+                           check=True)
+            output = subprocess.run([executable], stdout=subprocess.PIPE, check=True).stdout
+        lowest, highest, smallest, mean, variance = (float(value) for value in output.split())
+        with self.subTest(msg='Test uniform is in (0, 1]'):
+            self.assertEqual(lowest, 2 ** -53)
+            self.assertEqual(highest, 1)
+            self.assertGreater(smallest, 0)
+        with self.subTest(msg='Test unit exponential mean and variance'):
+            self.assertAlmostEqual(mean, 1, delta=0.01)
+            self.assertAlmostEqual(variance, 1, delta=0.02)
+
+    def test_compiled_cache(self):
+        with tempfile.TemporaryDirectory() as cache_directory, \
+                mock.patch.dict(os.environ, {'GILLESPY2_CACHE_DIR': cache_directory}):
+            model = Example()
+            first = SSACSolver(model)
+            entries = os.listdir(cache_directory)
+            self.assertEqual(len(entries), 1)
+            simulations = os.listdir(os.path.join(cache_directory, entries[0], 'simulations'))
+            self.assertEqual(len(simulations), 1)
+            second = SSACSolver(model)
+            self.assertEqual(os.listdir(os.path.join(cache_directory, entries[0], 'simulations')), simulations)
+            results = model.run(solver=second, number_of_trajectories=2, seed=1024)
+            self.assertEqual(results[0]['Sp'][0], 100)
+
+    def test_generic_simulation(self):
+        class CompiledSSACSolver(SSACSolver):
+            generic = False
+
+        model = MichaelisMenten()
+        solver = SSACSolver(model)
+        compiled = CompiledSSACSolver(model)
+        for algorithm in SSACSolver.algorithms:
+            results = model.run(solver=solver, number_of_trajectories=3, seed=1024, algorithm=algorithm)
+            expected = model.run(solver=compiled, number_of_trajectories=3, seed=1024, algorithm=algorithm)
+            for trajectory, expected_trajectory in zip(results, expected):
+                for species in model.listOfSpecies:
+                    self.assertTrue(np.array_equal(trajectory[species], expected_trajectory[species]))
+        # Mass-action models share one build, a custom propensity function is compiled
+        with tempfile.TemporaryDirectory() as cache_directory, \
+                mock.patch.dict(os.environ, {'GILLESPY2_CACHE_DIR': cache_directory}):
+            SSACSolver(Example())
+            SSACSolver(MichaelisMenten())
+            simulations = os.path.join(cache_directory, os.listdir(cache_directory)[0], 'simulations')
+            self.assertEqual(len(os.listdir(simulations)), 1)
+            custom = MichaelisMenten()
+            custom.listOfReactions['r3'].propensity_function = 'rate3*C/(1+D)'
+            SSACSolver(custom)
+            self.assertEqual(len(os.listdir(simulations)), 2)
+
+    def test_build_profiles(self):
+        model = MichaelisMenten()
+        expected = model.run(solver=SSACSolver(model), number_of_trajectories=3, seed=1024)
+        results = model.run(solver=SSACSolver(model, build='fast'), number_of_trajectories=3, seed=1024)
+        for trajectory, expected_trajectory in zip(results, expected):
+            for species in model.listOfSpecies:
+                self.assertTrue(np.array_equal(trajectory[species], expected_trajectory[species]))
+        with self.assertRaises(SimulationError):
+            SSACSolver(model, build='O2')
+
+    def test_benchmark(self):
+        model = Example()
+        solver = SSACSolver(model)
+        for algorithm in ALGORITHMS:
+            report = run_benchmark(solver, algorithm, number_of_threads=2, number_of_trajectories=2)
+            self.assertEqual(report['trajectories'], 2)
+            self.assertGreater(report['events'], 0)
+            self.assertGreaterEqual(report['evaluations_per_event'], 1)
+            self.assertGreater(report['peak_resident_kb'], 0)
+
+    def test_profile(self):
+        model = Example()
+        solver = SSACSolver(model)
+        for algorithm in solver.algorithms:
+            results = model.run(solver=solver, number_of_trajectories=3, seed=1024, number_of_threads=2,
+                                algorithm=algorithm, profile=True)
+            profile = results.profile
+            self.assertEqual(len(results), 3)
+            self.assertTrue(profile['profiled'])
+            self.assertEqual(profile['events'], sum(profile['events_per_trajectory']))
+            self.assertEqual(profile['events'], sum(profile['firings'].values()))
+            self.assertEqual(profile['fan_out'], profile['propensity_evaluations'] - 3 * len(model.listOfReactions))
+            self.assertGreater(profile['selection_seconds'] + profile['update_seconds'], 0)
+        self.assertIsNone(model.run(solver=solver, seed=1024).profile)
+
+    def test_sparse_output(self):
+        model = Example()
+        solver = SSACSolver(model)
+        for algorithm in solver.algorithms:
+            dense = model.run(solver=solver, number_of_trajectories=3, seed=1024, number_of_threads=2,
+                              algorithm=algorithm)
+            sparse = model.run(solver=solver, number_of_trajectories=3, seed=1024, number_of_threads=2,
+                               algorithm=algorithm, sparse_output=True)
+            for dense_trajectory, sparse_trajectory in zip(dense, sparse):
+                self.assertTrue(np.array_equal(dense_trajectory['time'], sparse_trajectory['time']))
+                self.assertTrue(np.array_equal(dense_trajectory['Sp'], sparse_trajectory['Sp']))
+
+    def test_observed_species(self):
+        model = MichaelisMenten()
+        solver = SSACSolver(model)
+        full = model.run(solver=solver, number_of_trajectories=2, seed=1024)
+        for sparse_output in (False, True):
+            observed = model.run(solver=solver, number_of_trajectories=2, seed=1024, species=['D', 'A'],
+                                 sparse_output=sparse_output)
+            for full_trajectory, observed_trajectory in zip(full, observed):
+                self.assertEqual(list(observed_trajectory.keys()), ['time', 'D', 'A'])
+                self.assertTrue(np.array_equal(full_trajectory['D'], observed_trajectory['D']))
+                self.assertTrue(np.array_equal(full_trajectory['A'], observed_trajectory['A']))
+        summary = solver.run_statistics(t=100, increment=1, number_of_trajectories=2, seed=1024, species=['C'])
+        self.assertEqual(list(summary['mean'].keys()), ['C'])
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, species=['E'])
+
+    def test_nonuniform_timeline(self):
+        model = Example()
+        solver = SSACSolver(model)
+        uniform = model.run(solver=solver, number_of_trajectories=2, seed=1024)
+        indices = [0, 1, 2, 5, 10, 40, len(model.tspan) - 1]
+        nonuniform = model.run(solver=solver, number_of_trajectories=2, seed=1024, timeline=model.tspan[indices])
+        for uniform_trajectory, nonuniform_trajectory in zip(uniform, nonuniform):
+            self.assertTrue(np.array_equal(nonuniform_trajectory['time'], model.tspan[indices]))
+            self.assertTrue(np.array_equal(nonuniform_trajectory['Sp'], uniform_trajectory['Sp'][indices]))
+
+    def test_record_every(self):
+        model = Example()
+        solver = SSACSolver(model)
+        for algorithm in solver.algorithms:
+            results = model.run(solver=solver, number_of_trajectories=2, seed=1024, algorithm=algorithm,
+                                record_every=1)
+            for trajectory in results:
+                self.assertEqual(trajectory['time'][0], 0)
+                self.assertEqual(trajectory['Sp'][0], 100)
+                self.assertTrue(np.all(np.diff(trajectory['time']) > 0))
+                self.assertLessEqual(trajectory['time'][-1], model.tspan[-1])
+                # Each event of Example degrades one Sp
+                self.assertTrue(np.all(np.diff(trajectory['Sp']) == -1))
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, record_every=0)
+
+    def test_checkpoint_resume(self):
+        model = MichaelisMenten()
+        solver = SSACSolver(model)
+        end = model.tspan[-1]
+        increment = model.tspan[1] - model.tspan[0]
+        plain = model.run(solver=solver, seed=1024)
+        self.assertIsNone(plain.checkpoint)
+        self.assertEqual(len(solver.run(model=model, t=end, increment=increment, seed=1024)), 2)
+        for algorithm in ('direct', 'next_reaction'):
+            first = model.run(solver=solver, number_of_trajectories=3, seed=1024, algorithm=algorithm, resumable=True)
+            self.assertIsNotNone(first.checkpoint)
+            resumed = model.run(solver=solver, resume=first, t=2 * end, algorithm=algorithm)
+            # Resumed trajectories draw the random numbers they would have had they run to the later end time
+            uninterrupted = solver.run(model=model, t=2 * end, increment=increment, number_of_trajectories=3,
+                                       seed=1024, algorithm=algorithm)[0]
+            self.assertEqual(len(resumed), 3)
+            for resumed_trajectory, trajectory in zip(resumed, uninterrupted):
+                self.assertTrue(np.allclose(resumed_trajectory['time'], trajectory['time']))
+                for species in model.listOfSpecies:
+                    self.assertTrue(np.array_equal(resumed_trajectory[species], trajectory[species]))
+
+    def test_checkpoint_resume_increment(self):
+        model = MichaelisMenten()
+        solver = SSACSolver(model)
+        end = model.tspan[-1]
+        increment = model.tspan[1] - model.tspan[0]
+        first = model.run(solver=solver, seed=1024, resumable=True)
+        self.assertIsNotNone(first.checkpoint)
+        # A checkpoint's entries index timesteps of its increment, resuming at another is completed by c_solver_resume
+        resumed = SSACSolver.run(model=model, t=2 * end, increment=2 * increment, resume=first)[0][0]
+        count = len(first['time'])
+        self.assertTrue(np.array_equal(resumed['time'][:count], first['time']))
+        self.assertTrue(np.allclose(np.diff(resumed['time'][count:]), 2 * increment))
+        self.assertAlmostEqual(resumed['time'][-1], 2 * end)
+        for species in model.listOfSpecies:
+            self.assertEqual(len(resumed[species]), len(resumed['time']))
+            self.assertTrue(np.array_equal(resumed[species][:count], first[species]))
+            self.assertEqual(resumed[species][count], first[species][-1])
+
+    def test_event(self):
+        model = Example()
+        trigger = gillespy2.EventTrigger(expression='t >= 10', initial_value=True)
+        event = gillespy2.Event(name='event1', trigger=trigger)
+        event.add_assignment([gillespy2.EventAssignment(variable='Sp', expression='1000'),
+                              gillespy2.EventAssignment(variable='k1', expression='0')])
+        model.add_event(event)
+        solver = SSACSolver(model)
+        results = model.run(solver=solver, number_of_trajectories=2, seed=1024)
+        for trajectory in results:
+            self.assertEqual(trajectory['Sp'][-1], 1000)
+            self.assertIsNone(results.checkpoint)
+        with self.assertRaises(ModelError):
+            model.run(solver=solver, algorithm='next_reaction')
+
+    def test_assignment_rule_and_function_definition(self):
+        model = Example()
+        model.add_species([gillespy2.Species(name='twice_Sp', initial_value=0)])
+        model.add_function_definition(gillespy2.FunctionDefinition(name='twice', function='2 * x', args=['x']))
+        model.add_assignment_rule(gillespy2.AssignmentRule(name='rule1', variable='twice_Sp', formula='twice(Sp)'))
+        results = model.run(solver=SSACSolver(model), seed=1024)
+        self.assertTrue(np.array_equal(results[0]['twice_Sp'], 2 * results[0]['Sp']))
+
+    def test_rate_rule_unsupported(self):
+        model = Example()
+        model.add_species([gillespy2.Species(name='R', initial_value=0)])
+        model.add_rate_rule(gillespy2.RateRule(name='rule1', variable='R', formula='1'))
+        with self.assertRaises(ModelError):
+            model.run(solver=SSACSolver(model))
+
+    def test_shards_match_single_run(self):
+        model = MichaelisMenten()
+        solver = SSACSolver(model)
+        expected = model.run(solver=solver, number_of_trajectories=7, seed=1024)
+        # Shards of uneven sizes, one started through a launcher
+        sharded = model.run(solver=solver, number_of_trajectories=7, seed=1024, shards=3,
+                            launcher=lambda shard: ['env'] if shard == 1 else [])
+        self.assertEqual(len(sharded), 7)
+        for sharded_trajectory, trajectory in zip(sharded, expected):
+            for species in model.listOfSpecies:
+                self.assertTrue(np.array_equal(sharded_trajectory[species], trajectory[species]))
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, shards=0)
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, shards=2, sparse_output=True)
+
+    def test_shards_statistics(self):
+        model = Example()
+        solver = SSACSolver(model)
+        expected = solver.run_statistics(number_of_trajectories=20, seed=1024)
+        summary = solver.run_statistics(number_of_trajectories=20, seed=1024, shards=3)
+        self.assertEqual(summary['trajectories'], 20)
+        self.assertTrue(np.array_equal(summary['mean']['Sp'], expected['mean']['Sp']))
+        self.assertTrue(np.array_equal(summary['variance']['Sp'], expected['variance']['Sp']))
+        with self.assertRaises(SimulationError):
+            solver.run_statistics(shards=2, quantiles=[0.5])
+
+    def test_run_iter(self):
+        model = Example()
+        solver = SSACSolver(model)
+        t = model.tspan[-1]
+        increment = model.tspan[1] - model.tspan[0]
+        expected = model.run(solver=solver, number_of_trajectories=6, seed=1024)
+        reports = []
+        streamed = dict(solver.run_iter(t=t, increment=increment, number_of_trajectories=6, seed=1024,
+                                        number_of_threads=2, progress=lambda finished, total: reports.append(finished)))
+        self.assertEqual(sorted(streamed), list(range(6)))
+        self.assertEqual(sorted(reports), [1, 2, 3, 4, 5, 6])
+        for trajectory_number, trajectory in streamed.items():
+            self.assertTrue(np.allclose(trajectory['time'], model.tspan))
+            self.assertTrue(np.array_equal(trajectory['Sp'], expected[trajectory_number]['Sp']))
+        # Stopping early stops the simulation
+        trajectories = solver.run_iter(t=1000, number_of_trajectories=1000, seed=1024)
+        next(trajectories)
+        trajectories.close()
+
 
 if __name__ == '__main__':
     unittest.main()
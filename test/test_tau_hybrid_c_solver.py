@@ -0,0 +1,73 @@
+import unittest
+import numpy as np
+import gillespy2
+from gillespy2.core.gillespyError import SimulationError
+from example_models import Example, MichaelisMenten
+from gillespy2 import TauHybridCSolver, ODECSolver, SSACSolver
+
+
+class TestTauHybridCSolver(unittest.TestCase):
+    def test_create(self):
+        model = Example()
+        solver = TauHybridCSolver(model)
+
+    def test_continuous_matches_ode(self):
+        model = MichaelisMenten()
+        for species in model.listOfSpecies.values():
+            species.mode = 'continuous'
+        results = model.run(solver=TauHybridCSolver(model), seed=1024)
+        expected = model.run(solver=ODECSolver(model))
+        self.assertEqual(results[0].solver_name, 'TauHybridCSolver')
+        for species in model.listOfSpecies:
+            self.assertTrue(np.allclose(results[0][species], expected[0][species], rtol=1e-3, atol=1e-3))
+
+    def test_discrete_matches_ssa(self):
+        model = Example()
+        model.listOfSpecies['Sp'].mode = 'discrete'
+        results = model.run(solver=TauHybridCSolver(model), number_of_trajectories=200, seed=1024)
+        expected = model.run(solver=SSACSolver(model), number_of_trajectories=200, seed=1024)
+        for trajectory in results:
+            self.assertTrue(np.array_equal(trajectory['Sp'], np.round(trajectory['Sp'])))
+        mean = np.mean([trajectory['Sp'] for trajectory in results], axis=0)
+        expected_mean = np.mean([trajectory['Sp'] for trajectory in expected], axis=0)
+        self.assertTrue(np.allclose(mean, expected_mean, atol=5))
+
+    def test_threads_reproducible(self):
+        model = MichaelisMenten()
+        solver = TauHybridCSolver(model)
+        serial = model.run(solver=solver, number_of_trajectories=4, seed=1024)
+        threaded = model.run(solver=solver, number_of_trajectories=4, seed=1024, number_of_threads=2)
+        for serial_trajectory, threaded_trajectory in zip(serial, threaded):
+            for species in model.listOfSpecies:
+                self.assertTrue(np.array_equal(serial_trajectory[species], threaded_trajectory[species]))
+
+    def test_unsupported_arguments(self):
+        model = Example()
+        solver = TauHybridCSolver(model)
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, integrator_options={'rtol': 0})
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, record_every=1)
+
+    def test_events(self):
+        for mode in ('continuous', 'discrete'):
+            model = Example()
+            model.listOfSpecies['Sp'].mode = mode
+            trigger = gillespy2.EventTrigger(expression='Sp <= 90', initial_value=True)
+            event = gillespy2.Event(name='event1', trigger=trigger)
+            event.add_assignment([gillespy2.EventAssignment(variable='Sp', expression='1000'),
+                                  gillespy2.EventAssignment(variable='k1', expression='0')])
+            model.add_event(event)
+            results = model.run(solver=TauHybridCSolver(model), seed=1024)
+            self.assertEqual(results['Sp'][-1], 1000)
+
+    def test_rate_rule(self):
+        model = Example()
+        model.add_species([gillespy2.Species(name='R', initial_value=0)])
+        model.add_rate_rule(gillespy2.RateRule(name='rule1', variable='R', formula='1 + 0 * Sp'))
+        results = model.run(solver=TauHybridCSolver(model), seed=1024)
+        self.assertTrue(np.allclose(results[0]['R'], model.tspan, rtol=1e-5, atol=1e-6))
+
+
+if __name__ == '__main__':
+    unittest.main()
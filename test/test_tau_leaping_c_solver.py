@@ -0,0 +1,35 @@
+import unittest
+from gillespy2.core.gillespyError import SimulationError
+from example_models import Example, MichaelisMenten
+from gillespy2 import TauLeapingCSolver
+
+
+class TestTauLeapingCSolver(unittest.TestCase):
+    def test_create(self):
+        model = Example()
+        solver = TauLeapingCSolver(model)
+
+    def test_run_example(self):
+        model = Example()
+        results = model.run(solver=TauLeapingCSolver, number_of_trajectories=2, seed=1024)
+        for trajectory in results:
+            self.assertEqual(trajectory['Sp'][0], 100)
+            self.assertEqual(trajectory.solver_name, 'TauLeapingCSolver')
+
+    def test_conservation(self):
+        model = MichaelisMenten()
+        solver = TauLeapingCSolver(model)
+        results = model.run(solver=solver, number_of_trajectories=3, tau_tol=0.05)
+        for trajectory in results:
+            self.assertTrue((trajectory['A'] + trajectory['C'] + trajectory['D'] == 301).all())
+            self.assertTrue((trajectory['C'] + trajectory['B'] == 120).all())
+
+    def test_invalid_tau_tol(self):
+        model = Example()
+        solver = TauLeapingCSolver(model)
+        with self.assertRaises(SimulationError):
+            model.run(solver=solver, tau_tol=2)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -3,6 +3,7 @@ import tempfile
 from gillespy2.core.gillespyError import DirectoryError, SimulationError
 from example_models import Example
 from gillespy2 import VariableSSACSolver
+from gillespy2.solvers.utilities import solverutils as cutils
 
 
 class TestVariableSSACSolver(unittest.TestCase):
@@ -47,6 +48,75 @@ class TestVariableSSACSolver(unittest.TestCase):
         with self.assertRaises(SimulationError):
             results = model.run(solver=solver, variables={'foobar':0})
 
+    @unittest.skipUnless(cutils._SimulationServer.supported, 'simulation servers are not used on this platform')
+    def test_server_reused(self):
+        model = Example()
+        solver = VariableSSACSolver(model)
+        first = model.run(solver=solver, seed=5, variables={'k1': 0.5})
+        server = solver._VariableSSACSolver__server.process
+        second = model.run(solver=solver, seed=5, variables={'k1': 0.5})
+        changed = model.run(solver=solver, seed=5, variables={'k1': 0})
+        with self.subTest(msg='Test runs share one simulation process'):
+            self.assertIs(solver._VariableSSACSolver__server.process, server)
+            self.assertIsNone(server.poll())
+        with self.subTest(msg='Test repeated requests are reproducible'):
+            self.assertEqual(list(first['Sp']), list(second['Sp']))
+        with self.subTest(msg='Test each request sets its own parameters'):
+            self.assertEqual(changed['Sp'][-1], changed['Sp'][0])
+        solver.close()
+        self.assertIsNotNone(server.poll())
+
+    @unittest.skipUnless(cutils._SimulationServer.supported, 'simulation servers are not used on this platform')
+    def test_server_unseeded_requests_differ(self):
+        model = Example()
+        solver = VariableSSACSolver(model)
+        first = model.run(solver=solver, number_of_trajectories=4)
+        second = model.run(solver=solver, number_of_trajectories=4)
+        self.assertNotEqual([list(trajectory['Sp']) for trajectory in first],
+                            [list(trajectory['Sp']) for trajectory in second])
+        solver.close()
+
+    def test_run_sweep(self):
+        model = Example()
+        solver = VariableSSACSolver(model)
+        points = [{}, {'k1': 0}, {'Sp': 7}]
+        sweep = solver.run_sweep(points, t=model.tspan[-1], increment=model.tspan[1] - model.tspan[0],
+                                 number_of_trajectories=2, seed=3, number_of_threads=2)
+        single = model.run(solver=solver, number_of_trajectories=2, seed=3)
+        with self.subTest(msg='Test one result per point'):
+            self.assertEqual(len(sweep), len(points))
+            for results in sweep:
+                self.assertEqual(len(results), 2)
+        with self.subTest(msg='Test the first point matches a single run'):
+            self.assertEqual(list(sweep[0][1]['Sp']), list(single[1]['Sp']))
+        with self.subTest(msg='Test points use their own variables'):
+            self.assertEqual(sweep[1][0]['Sp'][-1], sweep[1][0]['Sp'][0])
+            self.assertEqual(sweep[2][0]['Sp'][0], 7)
+        with self.assertRaises(SimulationError):
+            solver.run_sweep([{'foobar': 0}])
+
+    def test_run_sensitivity(self):
+        model = Example()
+        solver = VariableSSACSolver(model)
+        t, increment = model.tspan[-1], model.tspan[1] - model.tspan[0]
+        unperturbed = solver.run_sensitivity({}, t=t, increment=increment, number_of_trajectories=4, seed=2)
+        stopped = solver.run_sensitivity({'k1': 0}, t=t, increment=increment, number_of_trajectories=4, seed=2,
+                                         number_of_threads=2)
+        fewer = solver.run_sensitivity({'Sp': 90}, t=t, increment=increment, number_of_trajectories=4, seed=2)
+        with self.subTest(msg='Test identical processes share every event'):
+            for trajectory in unperturbed:
+                self.assertEqual(list(trajectory['Sp']), [0] * len(model.tspan))
+        with self.subTest(msg='Test differences of a perturbed parameter'):
+            for trajectory in stopped:
+                self.assertEqual(trajectory['Sp'][0], 0)
+                self.assertEqual(trajectory['Sp'][-1], 100)
+        with self.subTest(msg='Test negative differences of a perturbed species'):
+            for trajectory in fewer:
+                self.assertEqual(trajectory['Sp'][0], -10)
+                self.assertEqual(trajectory['Sp'][-1], 0)
+        with self.assertRaises(SimulationError):
+            solver.run_sensitivity({'foobar': 0})
+
     def test_run_example(self):
         model = Example()
         results = model.run(solver=VariableSSACSolver)